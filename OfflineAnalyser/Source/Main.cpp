@@ -0,0 +1,392 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <JuceHeader.h>
+#include <charconv>
+#include <iostream>
+#include "../../Source/SpectrumAnalyser.h"
+
+//
+// Offline analyser
+//
+// Streams an audio file through the same SpectrumAnalyser the plugin uses, as fast as the CPU allows, and
+// writes every spectrum or band frame to a CSV or binary file. Reports the throughput as a realtime multiple
+// and in spectra per second, both for the whole run and for the analysis alone.
+//
+// The analysis and the output run on the same thread here, so after each spectrum
+// outputFIFO.getMostRecent() returns exactly that spectrum.
+//
+static char const* const usage =
+    "Usage: Direct2DDemoOfflineAnalyser --input <file> --output <file> [options]\n"
+    "\n"
+    "  --format csv|binary          Output format; defaults to CSV for .csv files and binary otherwise\n"
+    "  --data spectrum|bands        Magnitude spectra or log-frequency band energies (default spectrum)\n"
+    "  --bands octave|third|sixth   Band layout for --data bands (default third)\n"
+    "  --fft-size <n>               Power of two from 256 to 32768 (default 1024)\n"
+    "  --engine fft|sdft            FFT every hop, or sliding DFT (default fft)\n"
+    "  --overlap <percent>          FFT frame overlap from 0 to 93.75 (default 75)\n"
+    "  --hop <n>                    Sliding DFT hop size in samples (default 32)\n"
+    "  --max-frequency <Hz>         Decimate the input down to this bandwidth before the analysis\n"
+    "  --chunk <n>                  Samples read from disk at a time (default 65536)\n"
+    "  --threads <n>                Extra worker threads for the per-channel analysis (default 0)\n"
+    "\n"
+    "Binary output is little-endian: the header is the magic 'D2DA', then int32 version, numChannels,\n"
+    "numValues, fftSize, hopSize, float64 analysis sample rate, and numValues float32 frequencies. Each\n"
+    "frame is a float64 time in seconds followed by numChannels * numValues float32 values.\n";
+
+class OutputWriter
+{
+public:
+    enum class Format
+    {
+        csv,
+        binary
+    };
+
+    enum class Data
+    {
+        spectrum,
+        bands
+    };
+
+    OutputWriter(juce::File const& file, Format format_, Data data_) :
+        format(format_),
+        data(data_)
+    {
+        file.deleteFile();
+        stream = std::make_unique<juce::FileOutputStream>(file, 1 << 20);
+        if (stream->failedToOpen())
+        {
+            juce::ConsoleApplication::fail("Couldn't open " + file.getFullPathName() + " for writing");
+        }
+    }
+
+    void write(ProcessorOutput const& output, SpectrumAnalyser const& analyser, double timeSeconds)
+    {
+        int const numChannels = output.spectrum.getNumChannels();
+        int const numValues = data == Data::spectrum ? output.spectrum.getNumBins() : output.getNumBands();
+
+        if (numFramesWritten == 0)
+        {
+            writeHeader(output, analyser, numChannels, numValues);
+        }
+
+        if (format == Format::binary)
+        {
+            stream->writeDouble(timeSeconds);
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                stream->write(getValues(output, channel), (size_t)numValues * sizeof(float));
+            }
+        }
+        else
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                line.clear();
+                append(timeSeconds);
+                append(channel);
+
+                auto values = getValues(output, channel);
+                for (int index = 0; index < numValues; ++index)
+                {
+                    append(values[index]);
+                }
+
+                line.back() = '\n';
+                stream->write(line.data(), line.size());
+            }
+        }
+
+        ++numFramesWritten;
+    }
+
+    bool finish()
+    {
+        stream->flush();
+        return stream->getStatus().wasOk();
+    }
+
+private:
+    Format const format;
+    Data const data;
+    std::unique_ptr<juce::FileOutputStream> stream;
+    int64_t numFramesWritten = 0;
+    std::vector<char> line;
+
+    float const* getValues(ProcessorOutput const& output, int channel) const
+    {
+        return data == Data::spectrum ? output.spectrum.getReadPointer(channel) : output.bands.getReadPointer(channel);
+    }
+
+    float getFrequency(ProcessorOutput const& output, int index) const
+    {
+        return data == Data::spectrum ? (float)(index * output.hertzPerBin) : output.bandCentreFrequencies[(size_t)index];
+    }
+
+    void writeHeader(ProcessorOutput const& output, SpectrumAnalyser const& analyser, int numChannels, int numValues)
+    {
+        if (format == Format::binary)
+        {
+            stream->write("D2DA", 4);
+            stream->writeInt(1);
+            stream->writeInt(numChannels);
+            stream->writeInt(numValues);
+            stream->writeInt(analyser.getFFTSize());
+            stream->writeInt(analyser.getHopSize());
+            stream->writeDouble(analyser.getAnalysisSampleRate());
+            for (int index = 0; index < numValues; ++index)
+            {
+                stream->writeFloat(getFrequency(output, index));
+            }
+
+            return;
+        }
+
+        *stream << "time,channel";
+        for (int index = 0; index < numValues; ++index)
+        {
+            *stream << "," << juce::String(getFrequency(output, index), 2);
+        }
+        *stream << "\n";
+    }
+
+    //
+    // std::to_chars doesn't allocate or touch the locale; formatting dominates the run time for CSV output
+    //
+    template <typename Value> void append(Value value)
+    {
+        char text[32];
+        std::to_chars_result result;
+        if constexpr (std::is_floating_point_v<Value>)
+        {
+            result = std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 7);
+        }
+        else
+        {
+            result = std::to_chars(text, text + sizeof(text), value);
+        }
+
+        line.insert(line.end(), text, result.ptr);
+        line.push_back(',');
+    }
+};
+
+static int getIntegerOption(juce::ArgumentList const& args, juce::StringRef option, int defaultValue, int minValue, int maxValue)
+{
+    auto text = args.getValueForOption(option);
+    if (text.isEmpty())
+    {
+        return defaultValue;
+    }
+
+    int value = text.getIntValue();
+    if (!text.containsOnly("0123456789") || value < minValue || value > maxValue)
+    {
+        juce::ConsoleApplication::fail(juce::String{ option } + " must be a whole number from " + juce::String{ minValue } + " to " + juce::String{ maxValue });
+    }
+
+    return value;
+}
+
+static int analyseFile(juce::ArgumentList const& args)
+{
+    if (args.containsOption("--help|-h") || args.size() == 0)
+    {
+        std::cout << usage;
+        return 0;
+    }
+
+    auto inputFile = args.getExistingFileForOption("--input|-i");
+    auto outputFile = args.getFileForOption("--output|-o");
+
+    //
+    // Analysis settings
+    //
+    auto formatName = args.getValueForOption("--format");
+    if (formatName.isEmpty())
+    {
+        formatName = outputFile.hasFileExtension("csv") ? "csv" : "binary";
+    }
+
+    if (formatName != "csv" && formatName != "binary")
+    {
+        juce::ConsoleApplication::fail("Unknown output format " + formatName);
+    }
+
+    auto dataName = args.getValueForOption("--data");
+    if (dataName.isNotEmpty() && dataName != "spectrum" && dataName != "bands")
+    {
+        juce::ConsoleApplication::fail("Unknown output data " + dataName);
+    }
+
+    BandMap::Layout bandLayout;
+    auto bandsName = args.getValueForOption("--bands");
+    if (bandsName == "octave")
+    {
+        bandLayout.type = BandMap::Layout::Type::octave;
+    }
+    else if (bandsName == "sixth")
+    {
+        bandLayout.type = BandMap::Layout::Type::sixthOctave;
+    }
+    else if (bandsName.isNotEmpty() && bandsName != "third")
+    {
+        juce::ConsoleApplication::fail("Unknown band layout " + bandsName);
+    }
+
+    int const fftSize = getIntegerOption(args, "--fft-size", 1 << FFTPlans::defaultOrder, 1 << FFTPlans::minOrder, FFTPlans::maxSize);
+    if (!juce::isPowerOfTwo(fftSize))
+    {
+        juce::ConsoleApplication::fail("--fft-size must be a power of two");
+    }
+
+    auto engineName = args.getValueForOption("--engine");
+    if (engineName.isNotEmpty() && engineName != "fft" && engineName != "sdft")
+    {
+        juce::ConsoleApplication::fail("Unknown analysis engine " + engineName);
+    }
+
+    auto const engine = engineName == "sdft" ? AnalysisEngine::slidingDFT : AnalysisEngine::fft;
+    int const hopSize = getIntegerOption(args, "--hop", 32, 1, fftSize);
+
+    float overlapPercent = SpectrumAnalyser::defaultOverlapPercent;
+    auto overlapText = args.getValueForOption("--overlap");
+    if (overlapText.isNotEmpty())
+    {
+        overlapPercent = overlapText.getFloatValue();
+        if (!overlapText.containsOnly("0123456789.") || overlapPercent > SpectrumAnalyser::maxOverlapPercent)
+        {
+            juce::ConsoleApplication::fail("--overlap must be a percentage from 0 to " + juce::String{ SpectrumAnalyser::maxOverlapPercent });
+        }
+    }
+
+    int const maxFrequency = getIntegerOption(args, "--max-frequency", 0, 0, 1000000);
+    int const chunkSize = getIntegerOption(args, "--chunk", 65536, 1, 1 << 24);
+    int const numWorkers = getIntegerOption(args, "--threads", 0, 0, SpectrumAnalyser::maxNumChannels - 1);
+
+    //
+    // Open the input file
+    //
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader{ formatManager.createReaderFor(inputFile) };
+    if (reader == nullptr)
+    {
+        juce::ConsoleApplication::fail("Couldn't read " + inputFile.getFullPathName());
+    }
+
+    int const numChannels = juce::jlimit(1, SpectrumAnalyser::maxNumChannels, (int)reader->numChannels);
+    double const sampleRate = reader->sampleRate;
+    int64_t const lengthInSamples = reader->lengthInSamples;
+
+    //
+    // Set up the analysis the same way as the plugin
+    //
+    SpectrumAnalyser analyser;
+    analyser.setFFTOrder(juce::roundToInt(std::log2(fftSize)));
+    analyser.setAnalysisEngine(engine);
+    analyser.setSlidingDFTHopSize(hopSize);
+    analyser.setOverlapPercent(overlapPercent);
+    analyser.setMaximumDisplayFrequency((double)maxFrequency);
+    analyser.setBandLayout(bandLayout);
+    analyser.prepare(sampleRate, numChannels, numWorkers);
+    analyser.update();
+
+    AudioFIFO fifo;
+    fifo.setSize(numChannels, FFTPlans::maxSize * 2, AudioFIFO::Backend::mirroredMemory);
+    fifo.reset(0);
+
+    OutputWriter writer{ outputFile,
+        formatName == "csv" ? OutputWriter::Format::csv : OutputWriter::Format::binary,
+        dataName == "bands" ? OutputWriter::Data::bands : OutputWriter::Data::spectrum };
+
+    int64_t numSpectra = 0;
+    int64_t analysisTicks = 0;
+    auto const startTicks = juce::Time::getHighResolutionTicks();
+
+    juce::AudioBuffer<float> chunk{ numChannels, chunkSize };
+    for (int64_t position = 0; position < lengthInSamples;)
+    {
+        int const numSamples = (int)juce::jmin((int64_t)chunkSize, lengthInSamples - position);
+        reader->read(&chunk, 0, numSamples, position, true, true);
+        position += numSamples;
+
+        int sampleIndex = 0;
+        while (sampleIndex < numSamples)
+        {
+            sampleIndex += fifo.write(chunk, sampleIndex, juce::jmin(numSamples - sampleIndex, fifo.getNumSamplesFree()));
+
+            while (true)
+            {
+                auto const analysisStartTicks = juce::Time::getHighResolutionTicks();
+                int const numNewSpectra = analyser.analyse(fifo, 1);
+                analysisTicks += juce::Time::getHighResolutionTicks() - analysisStartTicks;
+
+                if (numNewSpectra == 0)
+                {
+                    break;
+                }
+
+                //
+                // Time of the end of the last sample in the spectrum
+                //
+                auto const& output = *analyser.outputFIFO.getMostRecent();
+                double const timeSeconds = (double)(output.lastSamplePosition + 1) / sampleRate;
+                writer.write(output, analyser, timeSeconds);
+                ++numSpectra;
+            }
+        }
+    }
+
+    if (!writer.finish())
+    {
+        juce::ConsoleApplication::fail("Couldn't write " + outputFile.getFullPathName());
+    }
+
+    //
+    // Report the throughput
+    //
+    auto const elapsedSeconds = juce::jmax(1.0e-9, juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks));
+    auto const analysisSeconds = juce::jmax(1.0e-9, juce::Time::highResolutionTicksToSeconds(analysisTicks));
+    auto const audioSeconds = (double)lengthInSamples / sampleRate;
+
+    std::cout << inputFile.getFileName() << ": " << numChannels << " channels, " << audioSeconds << " s at " << sampleRate << " Hz, "
+        << "FFT size " << analyser.getFFTSize() << ", hop " << analyser.getHopSize() << " at " << analyser.getAnalysisSampleRate() << " Hz\n"
+        << numSpectra << " spectra in " << elapsedSeconds << " s: "
+        << audioSeconds / elapsedSeconds << "x realtime, " << (double)numSpectra / elapsedSeconds << " spectra/s\n"
+        << "Analysis only: " << analysisSeconds << " s, "
+        << audioSeconds / analysisSeconds << "x realtime, " << (double)numSpectra / analysisSeconds << " spectra/s\n";
+
+    analyser.release();
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args{ argc, argv };
+
+    return juce::ConsoleApplication::invokeCatchingFailures([&] { return analyseFile(args); });
+}
@@ -0,0 +1,75 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "AnalysisThread.h"
+
+AnalysisThread::AnalysisThread(std::function<void()> analyse_) :
+    Thread("Spectrum analysis"),
+    analyse(std::move(analyse_))
+{
+}
+
+AnalysisThread::~AnalysisThread()
+{
+    stop();
+}
+
+void AnalysisThread::start()
+{
+    if (!isThreadRunning())
+    {
+        startThread(Priority::high);
+    }
+}
+
+void AnalysisThread::stop()
+{
+    signalThreadShouldExit();
+    signal();
+    stopThread(1000);
+}
+
+void AnalysisThread::signal()
+{
+    signalCount.fetch_add(1, std::memory_order_release);
+    signalCount.notify_one();
+}
+
+void AnalysisThread::run()
+{
+    auto lastSignalCount = signalCount.load(std::memory_order_acquire);
+
+    while (!threadShouldExit())
+    {
+        signalCount.wait(lastSignalCount, std::memory_order_acquire);
+        lastSignalCount = signalCount.load(std::memory_order_acquire);
+
+        if (threadShouldExit())
+        {
+            break;
+        }
+
+        analyse();
+    }
+}
@@ -0,0 +1,58 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Worker thread that runs the spectrum analysis so the audio thread doesn't have to
+//
+// The audio thread calls signal() after it writes to the input FIFO. signal() bumps an atomic counter
+// and wakes the worker with std::atomic::notify_one, so the audio thread never takes a lock. The worker
+// runs the analyse callback once for every wakeup; if the audio thread signals several times while the
+// worker is busy, the worker only runs once more, so the callback should drain all the available input.
+//
+class AnalysisThread : public juce::Thread
+{
+public:
+    AnalysisThread(std::function<void()> analyse_);
+    ~AnalysisThread() override;
+
+    void start();
+    void stop();
+
+    //
+    // Audio thread
+    //
+    void signal();
+
+private:
+    std::function<void()> const analyse;
+    std::atomic<uint32_t> signalCount = 0;
+
+    void run() override;
+
+    JUCE_DECLARE_NON_COPYABLE(AnalysisThread)
+};
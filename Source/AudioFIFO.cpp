@@ -24,66 +24,269 @@ SOFTWARE.
 
 #include "AudioFIFO.h"
 
-void AudioFIFO::setSize(int numChannels, int numSamples)
+#if JUCE_USE_SSE_INTRINSICS
+#include <emmintrin.h>
+#elif JUCE_USE_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+void AudioFIFO::setSize(int numChannels, int numSamples, Backend preferredBackend)
 {
+    //
+    // Stop referring to any mirrored memory before releasing it
+    //
+    buffer = juce::AudioBuffer<float>{};
+    mirroredChannels.clear();
+    backend = Backend::audioBuffer;
+
+    if (preferredBackend == Backend::mirroredMemory && allocateMirroredChannels(numChannels, numSamples))
+    {
+        backend = Backend::mirroredMemory;
+        buffer.clear();
+        return;
+    }
+
     int ringSize = ringController.setRingSize(numSamples);
     buffer.setSize(numChannels, ringSize, false, false, true);
     buffer.clear();
 }
 
+bool AudioFIFO::allocateMirroredChannels(int numChannels, int numSamples)
+{
+    //
+    // Each channel gets its own mirrored mapping, so the ring size has to be a multiple of the mapping granularity
+    //
+    auto granularitySamples = (int)(MirroredMemory::getGranularity() / sizeof(float));
+    int ringSize = ringController.setRingSize(juce::jmax(numSamples, granularitySamples));
+    if (ringSize % granularitySamples != 0)
+    {
+        return false;
+    }
+
+    mirroredChannelPointers.malloc(numChannels);
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto memory = mirroredChannels.add(new MirroredMemory);
+        if (!memory->allocate((size_t)ringSize * sizeof(float)))
+        {
+            mirroredChannels.clear();
+            return false;
+        }
+
+        mirroredChannelPointers[channel] = (float*)memory->getData();
+    }
+
+    buffer.setDataToReferTo(mirroredChannelPointers, numChannels, ringSize);
+    return true;
+}
+
+int AudioFIFO::getContiguousCount(int numSamplesWanted, int position) const
+{
+    if (backend == Backend::mirroredMemory)
+    {
+        return juce::jmin(numSamplesWanted, ringController.getRingSize());
+    }
+
+    return ringController.getSafeTransferCount(numSamplesWanted, position);
+}
+
 void AudioFIFO::reset(int numStoredSamples)
 {
     ringController.reset(numStoredSamples);
     buffer.clear();
 }
 
-void AudioFIFO::write(juce::AudioBuffer<float> const& source)
+int AudioFIFO::write(juce::AudioBuffer<float> const& source)
+{
+    return write(source, 0, source.getNumSamples());
+}
+
+int AudioFIFO::write(juce::AudioBuffer<float> const& source, int startSample, int numSamples)
+{
+    return writeSamples(source, startSample, numSamples);
+}
+
+int AudioFIFO::write(juce::AudioBuffer<double> const& source)
+{
+    return write(source, 0, source.getNumSamples());
+}
+
+int AudioFIFO::write(juce::AudioBuffer<double> const& source, int startSample, int numSamples)
+{
+    return writeSamples(source, startSample, numSamples);
+}
+
+void AudioFIFO::convertToFloat(float* destination, double const* source, int numSamples)
+{
+    int index = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+    for (; index + 4 <= numSamples; index += 4)
+    {
+        auto low = _mm_cvtpd_ps(_mm_loadu_pd(source + index));
+        auto high = _mm_cvtpd_ps(_mm_loadu_pd(source + index + 2));
+        _mm_storeu_ps(destination + index, _mm_movelh_ps(low, high));
+    }
+#elif JUCE_USE_ARM_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+    for (; index + 4 <= numSamples; index += 4)
+    {
+        auto low = vcvt_f32_f64(vld1q_f64(source + index));
+        auto high = vcvt_f32_f64(vld1q_f64(source + index + 2));
+        vst1q_f32(destination + index, vcombine_f32(low, high));
+    }
+#endif
+
+    for (; index < numSamples; ++index)
+    {
+        destination[index] = (float)source[index];
+    }
+}
+
+static void copySamples(float* destination, float const* source, int numSamples)
+{
+    juce::FloatVectorOperations::copy(destination, source, numSamples);
+}
+
+static void copySamples(float* destination, double const* source, int numSamples)
+{
+    AudioFIFO::convertToFloat(destination, source, numSamples);
+}
+
+template <typename SampleType> int AudioFIFO::writeSamples(juce::AudioBuffer<SampleType> const& source, int startSample, int numSamples)
 {
     int numChannels = juce::jmin(buffer.getNumChannels(), source.getNumChannels());
-    int samplesRemaining = source.getNumSamples();
-    int sourceIndex = 0;
+    int numSamplesToWrite = juce::jmin(numSamples, ringController.getNumItemsFree());
+    int samplesRemaining = numSamplesToWrite;
+    int sourceIndex = startSample;
+
+    //
+    // Don't overwrite samples the reader hasn't consumed yet; drop whatever doesn't fit and count it
+    //
+    if (numSamplesToWrite < numSamples)
+    {
+        ringController.recordOverrun((uint64_t)(numSamples - numSamplesToWrite));
+    }
 
     while (samplesRemaining > 0)
     {
-        auto block = ringController.getWriteBlock(samplesRemaining);
+        int position = ringController.getWritePosition();
+        int count = getContiguousCount(samplesRemaining, position);
         for (int channel = 0; channel < numChannels; ++channel)
         {
-            buffer.copyFrom(channel, block.position,
-                source,
-                channel, sourceIndex, block.count);
+            copySamples(buffer.getWritePointer(channel) + position,
+                source.getReadPointer(channel, sourceIndex),
+                count);
         }
 
-        samplesRemaining -= block.count;
-        sourceIndex += block.count;
-        ringController.advanceWritePosition(block.count);
+        samplesRemaining -= count;
+        sourceIndex += count;
+        ringController.advanceWritePosition(count);
     }
+
+    return numSamplesToWrite;
 }
 
 void AudioFIFO::read(juce::AudioBuffer<float>& destination, int numSamplesToCopy, int ringAdvanceCount)
 {
     int numChannels = juce::jmin(buffer.getNumChannels(), destination.getNumChannels());
-    int destinationIndex = 0;
     int numSamplesCopied = 0;
 
+    if (int numSamplesStored = ringController.getNumItemsStored(); numSamplesToCopy > numSamplesStored)
+    {
+        ringController.recordUnderrun((uint64_t)(numSamplesToCopy - numSamplesStored));
+    }
+
     while (numSamplesCopied < numSamplesToCopy)
     {
-        auto block = ringController.getReadBlock(numSamplesToCopy - numSamplesCopied, numSamplesCopied);
+        int position = ringController.getReadPosition(numSamplesCopied);
+        int count = getContiguousCount(numSamplesToCopy - numSamplesCopied, position);
 
         for (int channel = 0; channel < numChannels; ++channel)
         {
-            destination.copyFrom(channel, destinationIndex,
-                buffer,
-                channel, block.position, block.count);
+            juce::FloatVectorOperations::copy(destination.getWritePointer(channel, numSamplesCopied),
+                buffer.getReadPointer(channel) + position,
+                count);
         }
 
-        numSamplesToCopy -= block.count;
-        destinationIndex += block.count;
-        numSamplesCopied += block.count;
+        numSamplesCopied += count;
+    }
+
+    advanceReadPosition(ringAdvanceCount);
+}
+
+AudioFIFO::ChannelView AudioFIFO::getReadView(int channel, int numSamples) const
+{
+    jassert(numSamples <= ringController.getNumItemsStored());
+
+    int position = ringController.getReadPosition();
+    int firstCount = getContiguousCount(numSamples, position);
+    auto channelData = buffer.getReadPointer(channel);
+
+    return
+    {
+        channelData + position,
+        firstCount,
+        channelData,
+        numSamples - firstCount
+    };
+}
+
+void AudioFIFO::advanceReadPosition(int ringAdvanceCount)
+{
+    //
+    // Never let the read position pass the write position
+    //
+    int numSamplesStored = ringController.getNumItemsStored();
+    if (ringAdvanceCount > numSamplesStored)
+    {
+        ringController.recordUnderrun((uint64_t)(ringAdvanceCount - numSamplesStored));
+        ringAdvanceCount = numSamplesStored;
     }
 
     ringController.advanceReadPosition(ringAdvanceCount);
 }
 
+int AudioFIFO::copyIntoRing(int channel, int position, float const* source, int numSamples)
+{
+    while (numSamples > 0)
+    {
+        int count = getContiguousCount(numSamples, position);
+        juce::FloatVectorOperations::copy(buffer.getWritePointer(channel) + position, source, count);
+
+        source += count;
+        numSamples -= count;
+        position = (position + count) & (ringController.getRingSize() - 1);
+    }
+
+    return position;
+}
+
+void AudioFIFO::takeStoredSamplesFrom(AudioFIFO& other)
+{
+    moveStoredSamplesFrom(other);
+
+    ringController.recordOverrun(other.getNumOverrunSamples() + (uint64_t)other.getNumSamplesStored());
+    ringController.recordUnderrun(other.getNumUnderrunSamples());
+}
+
+int AudioFIFO::moveStoredSamplesFrom(AudioFIFO& other)
+{
+    int numChannels = juce::jmin(buffer.getNumChannels(), other.getNumChannels());
+    int numSamples = juce::jmin(other.getNumSamplesStored(), getNumSamplesFree());
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto view = other.getReadView(channel, numSamples);
+        int position = copyIntoRing(channel, ringController.getWritePosition(), view.firstData, view.firstCount);
+        copyIntoRing(channel, position, view.secondData, view.secondCount);
+    }
+
+    ringController.advanceWritePosition(numSamples);
+    other.ringController.advanceReadPosition(numSamples);
+
+    return numSamples;
+}
+
 #if RUN_UNIT_TESTS
 
 AudioRingBufferTest::AudioRingBufferTest() : UnitTest("RingBufferTest")
@@ -126,6 +329,33 @@ void AudioRingBufferTest::checkRead(juce::AudioBuffer<float> const& source)
     }
 }
 
+void AudioRingBufferTest::checkReadView(juce::AudioBuffer<float> const& source)
+{
+    int samplesRemaining = source.getNumSamples();
+    int sourceIndex = 0;
+    while (samplesRemaining > 0)
+    {
+        int viewCount = getRandomCount(samplesRemaining);
+        int advance = getRandomCount(viewCount);
+
+        for (int channel = 0; channel < source.getNumChannels(); ++channel)
+        {
+            auto view = ringBuffer.getReadView(channel, viewCount);
+            expect(view.firstCount + view.secondCount == viewCount);
+
+            for (int index = 0; index < viewCount; ++index)
+            {
+                expect(view[index] == source.getSample(channel, index + sourceIndex));
+            }
+        }
+
+        ringBuffer.advanceReadPosition(advance);
+
+        sourceIndex += advance;
+        samplesRemaining -= advance;
+    }
+}
+
 void AudioRingBufferTest::makeRamp(juce::AudioBuffer<float>& buffer, float startValue)
 {
     for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
@@ -139,12 +369,19 @@ void AudioRingBufferTest::makeRamp(juce::AudioBuffer<float>& buffer, float start
 
 void AudioRingBufferTest::runTest()
 {
-    beginTest("AudioRingBufferTest");
+    runTest(AudioFIFO::Backend::audioBuffer);
+    runTest(AudioFIFO::Backend::mirroredMemory);
+}
+
+void AudioRingBufferTest::runTest(AudioFIFO::Backend backend)
+{
+    beginTest(backend == AudioFIFO::Backend::mirroredMemory ? "AudioRingBufferTest mirrored" : "AudioRingBufferTest");
 
     int minimumRingSamples = 30;
-    ringBuffer.setSize(2, minimumRingSamples);
+    ringBuffer.setSize(2, minimumRingSamples, backend);
+    ringBuffer.reset(0);
 
-    expect(juce::isPowerOfTwo(ringBuffer.getNumSamplesStored()) && ringBuffer.getNumSamples() >= minimumRingSamples);
+    expect(juce::isPowerOfTwo(ringBuffer.getNumSamples()) && ringBuffer.getNumSamples() >= minimumRingSamples);
 
     juce::AudioBuffer<float> source1{ 2, minimumRingSamples / 2 };
     juce::AudioBuffer<float> source2{ 2, minimumRingSamples / 2 };
@@ -157,6 +394,210 @@ void AudioRingBufferTest::runTest()
 
     checkRead(source1);
     checkRead(source2);
+
+    beginTest("AudioRingBufferTest read view");
+
+    makeRamp(source1, 3000000.0f);
+    ringBuffer.write(source1);
+
+    makeRamp(source2, 4000000.0f);
+    ringBuffer.write(source2);
+
+    checkReadView(source1);
+    checkReadView(source2);
+
+    //
+    // Write and read across the end of the ring
+    //
+    beginTest("AudioRingBufferTest wrap");
+
+    juce::AudioBuffer<float> source3{ 2, ringBuffer.getNumSamples() };
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        makeRamp(source3, 5000000.0f + (float)pass * 100000.0f);
+        ringBuffer.write(source3);
+        expect(ringBuffer.getNumSamplesStored() == ringBuffer.getNumSamples());
+        checkRead(source3);
+    }
+
+    expect(ringBuffer.getNumOverrunSamples() == 0);
+    expect(ringBuffer.getNumUnderrunSamples() == 0);
+
+    //
+    // Overrun and underrun
+    //
+    beginTest("AudioRingBufferTest overrun/underrun");
+
+    juce::AudioBuffer<float> source4{ 2, ringBuffer.getNumSamples() + 10 };
+    makeRamp(source4, 6000000.0f);
+    expect(ringBuffer.write(source4) == ringBuffer.getNumSamples());
+    expect(ringBuffer.getNumOverrunSamples() == 10);
+    expect(ringBuffer.getNumSamplesStored() == ringBuffer.getNumSamples());
+
+    ringBuffer.advanceReadPosition(ringBuffer.getNumSamples() + 5);
+    expect(ringBuffer.getNumUnderrunSamples() == 5);
+    expect(ringBuffer.getNumSamplesStored() == 0);
+}
+
+AudioFIFOBackendBenchmark::AudioFIFOBackendBenchmark() : UnitTest("AudioFIFOBackendBenchmark")
+{
+}
+
+double AudioFIFOBackendBenchmark::runBenchmark(AudioFIFO& fifo)
+{
+    //
+    // Simulate processBlock: write host-sized blocks, then window overlapping FFT frames straight from the ring
+    //
+    int constexpr fftSize = 1024;
+    int constexpr hopSize = fftSize / 4;
+    int constexpr numBlocks = 20000;
+    juce::AudioBuffer<float> hostBlock{ fifo.getNumChannels(), 480 };
+    juce::AudioBuffer<float> fftWorkBuffer{ fifo.getNumChannels(), fftSize };
+    juce::HeapBlock<float> windowTable{ fftSize };
+    juce::dsp::WindowingFunction<float>::fillWindowingTables(windowTable, fftSize, juce::dsp::WindowingFunction<float>::hann, true);
+
+    for (int channel = 0; channel < hostBlock.getNumChannels(); ++channel)
+    {
+        juce::FloatVectorOperations::fill(hostBlock.getWritePointer(channel), 0.5f, hostBlock.getNumSamples());
+    }
+
+    fifo.reset(0);
+
+    auto startTicks = juce::Time::getHighResolutionTicks();
+
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        fifo.write(hostBlock);
+
+        while (fifo.getNumSamplesStored() >= fftSize)
+        {
+            for (int channel = 0; channel < fifo.getNumChannels(); ++channel)
+            {
+                auto view = fifo.getReadView(channel, fftSize);
+                auto fftData = fftWorkBuffer.getWritePointer(channel);
+                juce::FloatVectorOperations::multiply(fftData, view.firstData, windowTable, view.firstCount);
+                juce::FloatVectorOperations::multiply(fftData + view.firstCount, view.secondData, windowTable + view.firstCount, view.secondCount);
+            }
+
+            fifo.advanceReadPosition(hopSize);
+        }
+    }
+
+    return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+}
+
+void AudioFIFOBackendBenchmark::runTest()
+{
+    beginTest("AudioFIFOBackendBenchmark");
+
+    AudioFIFO audioBufferFIFO;
+    audioBufferFIFO.setSize(2, 4096, AudioFIFO::Backend::audioBuffer);
+    expect(audioBufferFIFO.getBackend() == AudioFIFO::Backend::audioBuffer);
+
+    AudioFIFO mirroredFIFO;
+    mirroredFIFO.setSize(2, 4096, AudioFIFO::Backend::mirroredMemory);
+
+    auto audioBufferSeconds = runBenchmark(audioBufferFIFO);
+    logMessage("AudioBuffer backend: " + juce::String{ audioBufferSeconds * 1000.0, 1 } + " ms");
+
+    if (mirroredFIFO.getBackend() != AudioFIFO::Backend::mirroredMemory)
+    {
+        logMessage("Mirrored memory not available on this system");
+        return;
+    }
+
+    auto mirroredSeconds = runBenchmark(mirroredFIFO);
+    logMessage("Mirrored memory backend: " + juce::String{ mirroredSeconds * 1000.0, 1 } + " ms");
+}
+
+AudioFIFOPrecisionBenchmark::AudioFIFOPrecisionBenchmark() : UnitTest("AudioFIFOPrecisionBenchmark")
+{
+}
+
+void AudioFIFOPrecisionBenchmark::runTest()
+{
+    int constexpr numChannels = 2;
+    int constexpr blockSize = 480;
+    int constexpr numBlocks = 20000;
+
+    juce::Random random;
+    juce::AudioBuffer<double> hostBlock{ numChannels, blockSize };
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        for (int index = 0; index < blockSize; ++index)
+        {
+            hostBlock.setSample(channel, index, random.nextDouble() * 2.0 - 1.0);
+        }
+    }
+
+    AudioFIFO convertedFIFO, fusedFIFO;
+    convertedFIFO.setSize(numChannels, 4096);
+    fusedFIFO.setSize(numChannels, 4096);
+    juce::AudioBuffer<float> floatBlock{ numChannels, blockSize };
+
+    {
+        beginTest("Fused conversion matches");
+
+        //
+        // Odd start and length so the conversion has leftover samples and wraps around the ring
+        //
+        for (int pass = 0; pass < 20; ++pass)
+        {
+            int const startSample = 1 + pass % 3;
+            int const numSamples = blockSize - 2 * startSample;
+
+            floatBlock.makeCopyOf(hostBlock);
+            convertedFIFO.write(floatBlock, startSample, numSamples);
+            fusedFIFO.write(hostBlock, startSample, numSamples);
+
+            expect(fusedFIFO.getNumSamplesStored() == convertedFIFO.getNumSamplesStored());
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto convertedView = convertedFIFO.getReadView(channel, numSamples);
+                auto fusedView = fusedFIFO.getReadView(channel, numSamples);
+                for (int index = 0; index < numSamples; ++index)
+                {
+                    if (convertedView[index] != fusedView[index])
+                    {
+                        expect(false, "Pass " + juce::String{ pass } + " channel " + juce::String{ channel } + " sample " + juce::String{ index });
+                        return;
+                    }
+                }
+            }
+
+            convertedFIFO.advanceReadPosition(numSamples);
+            fusedFIFO.advanceReadPosition(numSamples);
+        }
+    }
+
+    {
+        beginTest("AudioFIFOPrecisionBenchmark");
+
+        //
+        // What the host does for a float-only plugin: convert the whole block, then write it
+        //
+        convertedFIFO.reset(0);
+        auto startTicks = juce::Time::getHighResolutionTicks();
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            floatBlock.makeCopyOf(hostBlock, true /* avoidReallocating */);
+            convertedFIFO.write(floatBlock);
+            convertedFIFO.advanceReadPosition(blockSize);
+        }
+        auto convertedSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        fusedFIFO.reset(0);
+        startTicks = juce::Time::getHighResolutionTicks();
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            fusedFIFO.write(hostBlock);
+            fusedFIFO.advanceReadPosition(blockSize);
+        }
+        auto fusedSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        logMessage("Float block converted first: " + juce::String{ convertedSeconds * 1000.0, 1 } + " ms");
+        logMessage("Double block converted in the FIFO write: " + juce::String{ fusedSeconds * 1000.0, 1 } + " ms");
+    }
 }
 
 #endif
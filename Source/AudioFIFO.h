@@ -25,15 +25,94 @@ SOFTWARE.
 #pragma once
 
 #include "FIFOController.h"
+#include "MirroredMemory.h"
 
 class AudioFIFO
 {
 public:
-    void setSize(int numChannels, int numSamples);
+    //
+    // audioBuffer stores the ring in a juce::AudioBuffer
+    //
+    // mirroredMemory maps each channel of the ring twice back to back, so reads and writes never
+    // have to be split at the end of the ring. If the mapping fails, setSize falls back to audioBuffer.
+    //
+    enum class Backend
+    {
+        audioBuffer,
+        mirroredMemory
+    };
+
+    //
+    // Up to two contiguous runs of samples in the ring for a single channel; the second run is only
+    // used if the requested samples wrap around the end of the ring
+    //
+    struct ChannelView
+    {
+        float const* firstData = nullptr;
+        int firstCount = 0;
+        float const* secondData = nullptr;
+        int secondCount = 0;
+
+        float operator[](int index) const
+        {
+            return index < firstCount ? firstData[index] : secondData[index - firstCount];
+        }
+    };
+
+    void setSize(int numChannels, int numSamples, Backend preferredBackend = Backend::audioBuffer);
     void reset(int numStoredSamples);
-    void write(juce::AudioBuffer<float> const& source);
+    int write(juce::AudioBuffer<float> const& source);
+    int write(juce::AudioBuffer<float> const& source, int startSample, int numSamples);
+
+    //
+    // Double precision input is converted to float on the way into the ring, so there's no separate
+    // conversion pass
+    //
+    int write(juce::AudioBuffer<double> const& source);
+    int write(juce::AudioBuffer<double> const& source, int startSample, int numSamples);
     void read(juce::AudioBuffer<float>& destination, int numSamplesToCopy, int ringAdvanceCount);
 
+    //
+    // Zero-copy read; call getReadView for each channel, then advanceReadPosition when you're done
+    //
+    ChannelView getReadView(int channel, int numSamples) const;
+    void advanceReadPosition(int ringAdvanceCount);
+
+    //
+    // Move all the unread samples and the overrun/underrun totals from another FIFO into this one;
+    // this FIFO should be empty and at least as large as the other one
+    //
+    void takeStoredSamplesFrom(AudioFIFO& other);
+
+    //
+    // Move as many of the unread samples from another FIFO as fit into this one, oldest first; returns the
+    // number of samples moved
+    //
+    int moveStoredSamplesFrom(AudioFIFO& other);
+
+    //
+    // Count samples the caller had to drop before they reached this FIFO
+    //
+    void recordOverrun(int numSamples)
+    {
+        ringController.recordOverrun((uint64_t)numSamples);
+    }
+
+    int getNumChannels() const
+    {
+        return buffer.getNumChannels();
+    }
+
+    //
+    // Uses SSE2 or AArch64 NEON where available
+    //
+    static void convertToFloat(float* destination, double const* source, int numSamples);
+
+    Backend getBackend() const
+    {
+        return backend;
+    }
+
     int getNumSamples() const
     {
         return buffer.getNumSamples();
@@ -44,9 +123,33 @@ public:
         return ringController.getNumItemsStored();
     }
 
+    int getNumSamplesFree() const
+    {
+        return ringController.getNumItemsFree();
+    }
+
+    uint64_t getNumOverrunSamples() const
+    {
+        return ringController.getNumOverrunItems();
+    }
+
+    uint64_t getNumUnderrunSamples() const
+    {
+        return ringController.getNumUnderrunItems();
+    }
+
 private:
     FIFOController ringController;
     juce::AudioBuffer<float> buffer;
+    Backend backend = Backend::audioBuffer;
+    juce::OwnedArray<MirroredMemory> mirroredChannels;
+    juce::HeapBlock<float*> mirroredChannelPointers;
+
+    bool allocateMirroredChannels(int numChannels, int numSamples);
+    int getContiguousCount(int numSamplesWanted, int position) const;
+    int copyIntoRing(int channel, int position, float const* source, int numSamples);
+
+    template <typename SampleType> int writeSamples(juce::AudioBuffer<SampleType> const& source, int startSample, int numSamples);
 };
 
 #if RUN_UNIT_TESTS
@@ -58,12 +161,31 @@ public:
 
     int getRandomCount(int count);
     void checkRead(juce::AudioBuffer<float> const& source);
+    void checkReadView(juce::AudioBuffer<float> const& source);
     void makeRamp(juce::AudioBuffer<float>& buffer, float startValue);
 
     void runTest() override;
+    void runTest(AudioFIFO::Backend backend);
 
     AudioFIFO ringBuffer;
     juce::Random random;
 };
 
+class AudioFIFOBackendBenchmark : public juce::UnitTest
+{
+public:
+    AudioFIFOBackendBenchmark();
+
+    void runTest() override;
+    double runBenchmark(AudioFIFO& fifo);
+};
+
+class AudioFIFOPrecisionBenchmark : public juce::UnitTest
+{
+public:
+    AudioFIFOPrecisionBenchmark();
+
+    void runTest() override;
+};
+
 #endif
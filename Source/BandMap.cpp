@@ -0,0 +1,242 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "BandMap.h"
+
+void BandMap::build(Layout const& layout, double sampleRate, int fftSize)
+{
+    bands.clear();
+    weights.clear();
+
+    double const hertzPerBin = sampleRate / fftSize;
+    int const numBins = fftSize / 2 + 1;
+    double const minFrequency = juce::jmax(hertzPerBin * 0.5, layout.minFrequency);
+    double const maxFrequency = juce::jmin(sampleRate * 0.5, layout.maxFrequency);
+    if (maxFrequency <= minFrequency)
+    {
+        return;
+    }
+
+    if (layout.type == Layout::Type::logSpaced)
+    {
+        int const numBands = juce::jlimit(1, maxNumBands, layout.numLogSpacedBands);
+        double const ratio = maxFrequency / minFrequency;
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            double lowFrequency = minFrequency * std::pow(ratio, (double)band / numBands);
+            double highFrequency = minFrequency * std::pow(ratio, (double)(band + 1) / numBands);
+            addBand(lowFrequency, std::sqrt(lowFrequency * highFrequency), highFrequency, hertzPerBin, numBins);
+        }
+
+        return;
+    }
+
+    //
+    // Fractional octave band centres are spaced from 1 kHz
+    //
+    int bandsPerOctave = 1;
+    switch (layout.type)
+    {
+    case Layout::Type::octave:
+        bandsPerOctave = 1;
+        break;
+
+    case Layout::Type::thirdOctave:
+        bandsPerOctave = 3;
+        break;
+
+    case Layout::Type::sixthOctave:
+    case Layout::Type::logSpaced:
+        bandsPerOctave = 6;
+        break;
+    }
+
+    double const halfBandRatio = std::pow(2.0, 0.5 / bandsPerOctave);
+    int const firstIndex = (int)std::ceil(bandsPerOctave * std::log2(minFrequency / 1000.0));
+    int const lastIndex = (int)std::floor(bandsPerOctave * std::log2(maxFrequency / 1000.0));
+
+    for (int index = firstIndex; index <= lastIndex && getNumBands() < maxNumBands; ++index)
+    {
+        double centreFrequency = 1000.0 * std::pow(2.0, (double)index / bandsPerOctave);
+        addBand(centreFrequency / halfBandRatio, centreFrequency, centreFrequency * halfBandRatio, hertzPerBin, numBins);
+    }
+}
+
+void BandMap::addBand(double lowFrequency, double centreFrequency, double highFrequency, double hertzPerBin, int numBins)
+{
+    //
+    // Bin k covers (k - 0.5) * hertzPerBin to (k + 0.5) * hertzPerBin
+    //
+    int const firstBin = juce::jlimit(0, numBins - 1, (int)std::floor(lowFrequency / hertzPerBin + 0.5));
+    int const lastBin = juce::jlimit(firstBin, numBins - 1, (int)std::floor(highFrequency / hertzPerBin + 0.5));
+
+    Band band{ (float)centreFrequency, firstBin, lastBin - firstBin + 1, (int)weights.size() };
+
+    float totalWeight = 0.0f;
+    for (int bin = firstBin; bin <= lastBin; ++bin)
+    {
+        double overlap = juce::jmin(highFrequency, (bin + 0.5) * hertzPerBin) - juce::jmax(lowFrequency, (bin - 0.5) * hertzPerBin);
+        float weight = (float)juce::jmax(0.0, overlap / hertzPerBin);
+        weights.push_back(weight);
+        totalWeight += weight;
+    }
+
+    if (totalWeight > 0.0f && totalWeight < 1.0f)
+    {
+        for (int index = band.firstWeight; index < (int)weights.size(); ++index)
+        {
+            weights[(size_t)index] /= totalWeight;
+        }
+    }
+
+    bands.push_back(band);
+}
+
+void BandMap::apply(float const* magnitudes, float* bandLevels) const
+{
+    for (auto const& band : bands)
+    {
+        auto bandMagnitudes = magnitudes + band.firstBin;
+        auto bandWeights = weights.data() + band.firstWeight;
+
+        float sum = 0.0f;
+        for (int index = 0; index < band.numBins; ++index)
+        {
+            sum += bandWeights[index] * bandMagnitudes[index] * bandMagnitudes[index];
+        }
+
+        *bandLevels++ = std::sqrt(sum);
+    }
+}
+
+BandMaps::BandMaps(BandMap::Layout const& layout_, double sampleRate_) :
+    layout(layout_),
+    sampleRate(sampleRate_)
+{
+    for (int decimationFactor = 1; decimationFactor <= Decimator::maxFactor; decimationFactor *= 2)
+    {
+        //
+        // Leave out the bands above the decimator's passband
+        //
+        auto decimatedLayout = layout;
+        if (decimationFactor > 1)
+        {
+            decimatedLayout.maxFrequency = juce::jmin(layout.maxFrequency, Decimator::getPassbandFrequency(sampleRate, decimationFactor));
+        }
+
+        auto& mapsForFactor = maps[(size_t)getDecimationIndex(decimationFactor)];
+        for (int order = FFTPlans::minOrder; order <= FFTPlans::maxOrder; ++order)
+        {
+            mapsForFactor[(size_t)(order - FFTPlans::minOrder)].build(decimatedLayout, sampleRate / decimationFactor, 1 << order);
+        }
+    }
+}
+
+#if RUN_UNIT_TESTS
+
+BandMapTest::BandMapTest() : UnitTest("BandMapTest")
+{
+}
+
+void BandMapTest::runTest()
+{
+    double constexpr sampleRate = 48000.0;
+    int constexpr fftSize = 1024;
+    int constexpr numBins = fftSize / 2 + 1;
+    double constexpr hertzPerBin = sampleRate / fftSize;
+
+    std::vector<float> magnitudes((size_t)numBins);
+    std::vector<float> bandLevels((size_t)BandMap::maxNumBands);
+
+    {
+        beginTest("Third octave layout");
+
+        BandMap map;
+        map.build({}, sampleRate, fftSize);
+
+        expect(map.getNumBands() == 29);
+        expect(std::abs(map.getCentreFrequency(0) - 25.0f) < 0.5f);
+        for (int band = 1; band < map.getNumBands(); ++band)
+        {
+            expect(map.getCentreFrequency(band) > map.getCentreFrequency(band - 1));
+        }
+
+        //
+        // A flat spectrum reads the square root of the band width in bins, or 1 for bands narrower than a bin
+        //
+        std::fill(magnitudes.begin(), magnitudes.end(), 1.0f);
+        map.apply(magnitudes.data(), bandLevels.data());
+
+        double const halfBandRatio = std::pow(2.0, 1.0 / 6.0);
+        for (int band = 0; band < map.getNumBands(); ++band)
+        {
+            double centreFrequency = map.getCentreFrequency(band);
+            double widthInBins = (centreFrequency * halfBandRatio - centreFrequency / halfBandRatio) / hertzPerBin;
+            double expected = std::sqrt(juce::jmax(1.0, widthInBins));
+            expect(std::abs(bandLevels[(size_t)band] - expected) < 1.0e-3 * expected);
+        }
+    }
+
+    {
+        beginTest("Single bin");
+
+        BandMap map;
+        map.build({ BandMap::Layout::Type::octave }, sampleRate, fftSize);
+
+        int const bin = juce::roundToInt(1000.0 / hertzPerBin);
+        std::fill(magnitudes.begin(), magnitudes.end(), 0.0f);
+        magnitudes[(size_t)bin] = 1.0f;
+        map.apply(magnitudes.data(), bandLevels.data());
+
+        int numNonZeroBands = 0;
+        for (int band = 0; band < map.getNumBands(); ++band)
+        {
+            if (bandLevels[(size_t)band] > 0.0f)
+            {
+                ++numNonZeroBands;
+                expect(map.getCentreFrequency(band) == 1000.0f);
+                expect(std::abs(bandLevels[(size_t)band] - 1.0f) < 1.0e-6f);
+            }
+        }
+
+        expect(numNonZeroBands == 1);
+    }
+
+    {
+        beginTest("Log spaced layout for every FFT size");
+
+        BandMap::Layout layout{ BandMap::Layout::Type::logSpaced, 40 };
+        BandMaps maps{ layout, sampleRate };
+
+        for (int order = FFTPlans::minOrder; order <= FFTPlans::maxOrder; ++order)
+        {
+            auto const& map = maps.getMap(order);
+            expect(map.getNumBands() == 40);
+            expect(map.getCentreFrequency(map.getNumBands() - 1) < 20000.0f);
+        }
+    }
+}
+
+#endif
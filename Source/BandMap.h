@@ -0,0 +1,131 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FFTPlans.h"
+#include "Decimator.h"
+
+//
+// Sparse weight matrix that sums FFT bins into log-spaced frequency bands
+//
+// Each band covers a contiguous run of bins; a bin's weight is the fraction of the bin that overlaps the
+// band, so bins that straddle a band edge are shared between two bands. Bands narrower than a bin are
+// scaled up so they read the level of the bin they fall in. The band level is the square root of the
+// weighted sum of the squared bin magnitudes.
+//
+class BandMap
+{
+public:
+    struct Layout
+    {
+        enum class Type
+        {
+            octave,
+            thirdOctave,
+            sixthOctave,
+            logSpaced
+        };
+
+        Type type = Type::thirdOctave;
+        int numLogSpacedBands = 32;
+        double minFrequency = 20.0;
+        double maxFrequency = 20000.0;
+    };
+
+    static constexpr int maxNumBands = 128;
+
+    void build(Layout const& layout, double sampleRate, int fftSize);
+
+    int getNumBands() const
+    {
+        return (int)bands.size();
+    }
+
+    float getCentreFrequency(int band) const
+    {
+        return bands[(size_t)band].centreFrequency;
+    }
+
+    //
+    // magnitudes needs fftSize / 2 + 1 values; bandLevels needs getNumBands() values
+    //
+    void apply(float const* magnitudes, float* bandLevels) const;
+
+private:
+    struct Band
+    {
+        float centreFrequency;
+        int firstBin;
+        int numBins;
+        int firstWeight;
+    };
+
+    std::vector<Band> bands;
+    std::vector<float> weights;
+
+    void addBand(double lowFrequency, double centreFrequency, double highFrequency, double hertzPerBin, int numBins);
+};
+
+//
+// Band maps for every FFT size and decimation factor for one layout and sample rate
+//
+class BandMaps
+{
+public:
+    BandMaps(BandMap::Layout const& layout_, double sampleRate_);
+
+    BandMap const& getMap(int fftOrder, int decimationFactor = 1) const
+    {
+        auto const& mapsForFactor = maps[(size_t)getDecimationIndex(decimationFactor)];
+        return mapsForFactor[(size_t)(juce::jlimit(FFTPlans::minOrder, FFTPlans::maxOrder, fftOrder) - FFTPlans::minOrder)];
+    }
+
+    BandMap::Layout const layout;
+    double const sampleRate;
+
+private:
+    static constexpr int numDecimationFactors = 5;
+    static_assert(1 << (numDecimationFactors - 1) == Decimator::maxFactor);
+
+    std::array<std::array<BandMap, FFTPlans::numOrders>, numDecimationFactors> maps;
+
+    static int getDecimationIndex(int decimationFactor)
+    {
+        return juce::jlimit(0, numDecimationFactors - 1, juce::roundToInt(std::log2(decimationFactor)));
+    }
+};
+
+#if RUN_UNIT_TESTS
+
+class BandMapTest : public juce::UnitTest
+{
+public:
+    BandMapTest();
+
+    void runTest() override;
+};
+
+#endif
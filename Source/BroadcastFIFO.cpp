@@ -0,0 +1,172 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "BroadcastFIFO.h"
+
+#if RUN_UNIT_TESTS
+
+BroadcastFIFOTest::BroadcastFIFOTest() : UnitTest("BroadcastFIFOTest")
+{
+}
+
+void BroadcastFIFOTest::runTest()
+{
+    beginTest("BroadcastFIFOTest");
+
+    using Frame = std::array<uint64_t, 256>;
+    uint64_t constexpr numFrames = 100000;
+    int constexpr numReaders = 3;
+
+    //
+    // Each frame also carries (frame number % maxPayloadSize) + 1 copies of its frame number in the payload
+    //
+    size_t constexpr maxPayloadSize = 512;
+    auto getPayloadSize = [](uint64_t frameNumber)
+    {
+        return (size_t)(frameNumber % maxPayloadSize) + 1;
+    };
+
+    BroadcastFIFO<Frame> fifo;
+    fifo.setSize(16, maxPayloadSize * sizeof(uint64_t));
+    expect(!fifo.hasReaders());
+
+    struct ReaderResults
+    {
+        uint64_t numReceived = 0;
+        uint64_t numOverruns = 0;
+        int numTornFrames = 0;
+        int numOutOfOrderFrames = 0;
+    };
+
+    std::array<ReaderResults, numReaders> results;
+    std::vector<std::unique_ptr<BroadcastFIFO<Frame>::Reader>> readers;
+    for (int index = 0; index < numReaders; ++index)
+    {
+        readers.push_back(fifo.createReader());
+    }
+
+    expect(fifo.hasReaders());
+
+    std::atomic<bool> producerDone = false;
+    std::vector<std::thread> readerThreads;
+    for (int index = 0; index < numReaders; ++index)
+    {
+        readerThreads.emplace_back([&, index]()
+            {
+                auto& reader = *readers[(size_t)index];
+                auto& result = results[(size_t)index];
+                Frame frame;
+                std::array<uint64_t, maxPayloadSize> payload;
+                size_t payloadSize = 0;
+                uint64_t lastFrameNumber = 0;
+                bool first = true;
+
+                while (true)
+                {
+                    bool done = producerDone.load();
+
+                    auto copyPayload = [&](Frame const& copiedFrame, std::byte const* source)
+                    {
+                        //
+                        // copiedFrame may be torn here, so don't trust the size it implies
+                        //
+                        payloadSize = juce::jmin(getPayloadSize(copiedFrame[0]), maxPayloadSize);
+                        std::memcpy(payload.data(), source, payloadSize * sizeof(uint64_t));
+                    };
+
+                    while (reader.read(frame, copyPayload))
+                    {
+                        auto const isTorn = [&](uint64_t value) { return value != frame[0]; };
+                        if (std::any_of(frame.begin(), frame.end(), isTorn) || payloadSize != getPayloadSize(frame[0]) ||
+                            std::any_of(payload.begin(), payload.begin() + (std::ptrdiff_t)payloadSize, isTorn))
+                        {
+                            ++result.numTornFrames;
+                        }
+
+                        if (!first && frame[0] <= lastFrameNumber)
+                        {
+                            ++result.numOutOfOrderFrames;
+                        }
+
+                        first = false;
+                        lastFrameNumber = frame[0];
+                        ++result.numReceived;
+
+                        //
+                        // Make the last reader slow so it gets overruns
+                        //
+                        if (index == numReaders - 1)
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+
+                    if (done)
+                    {
+                        break;
+                    }
+                }
+
+                result.numOverruns = reader.getNumOverruns();
+            });
+    }
+
+    std::thread producer{ [&]()
+        {
+            for (uint64_t frameNumber = 0; frameNumber < numFrames; ++frameNumber)
+            {
+                fifo.getWriteItem().fill(frameNumber);
+                std::fill_n(reinterpret_cast<uint64_t*>(fifo.getWritePayload()), getPayloadSize(frameNumber), frameNumber);
+                fifo.publish();
+
+                if ((frameNumber & 7) == 0)
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            producerDone = true;
+        } };
+
+    producer.join();
+    for (auto& thread : readerThreads)
+    {
+        thread.join();
+    }
+
+    for (auto const& result : results)
+    {
+        expect(result.numTornFrames == 0, juce::String{ result.numTornFrames } + " torn frames");
+        expect(result.numOutOfOrderFrames == 0);
+        expect(result.numReceived + result.numOverruns == numFrames, "Frames unaccounted for");
+
+        logMessage("Reader received " + juce::String{ (juce::int64)result.numReceived } +
+            " frames, " + juce::String{ (juce::int64)result.numOverruns } + " overruns");
+    }
+
+    readers.clear();
+    expect(!fifo.hasReaders());
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include "FIFO.h"
+
+//
+// Single-producer, multiple-reader broadcast ring
+//
+// Every reader has its own read cursor and sees every item, as long as it keeps up. The producer never
+// waits for readers; if a reader falls more than a ring's worth of items behind, the oldest items are
+// overwritten and the reader counts them as overruns.
+//
+// Each slot carries a stamp with the index of the item it holds. The producer invalidates the stamp before
+// overwriting a slot and restores it afterwards; a reader copies the item out of the slot and then checks
+// that the stamp didn't change while it was copying (same idea as a seqlock). The reader's copy can race
+// with the producer, so items have to be trivially copyable; anything larger or variable-sized goes in the
+// slot's payload, a fixed-size block of bytes that the reader copies out with the item.
+//
+template <typename Type> class BroadcastFIFO
+{
+public:
+    static_assert(std::is_trivially_copyable_v<Type>, "Readers copy items while the producer may be overwriting them");
+
+    class Reader
+    {
+    public:
+        ~Reader()
+        {
+            owner.numReaders.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        //
+        // Copies the next item into destination; returns false if there's nothing new
+        //
+        bool read(Type& destination)
+        {
+            return read(destination, [](Type const&, std::byte const*) {});
+        }
+
+        //
+        // Copies the next item into destination, then calls copyPayload(destination, payload) to copy what it
+        // needs out of the slot's payload. If the producer overwrites the slot meanwhile, both copies are
+        // thrown away, but copyPayload still runs with whatever it got; it has to clamp any sizes it takes
+        // from the item to the payload size.
+        //
+        template <typename CopyPayload> bool read(Type& destination, CopyPayload&& copyPayload)
+        {
+            auto const ringSize = (uint64_t)owner.items.size();
+
+            while (true)
+            {
+                auto writeCount = owner.writeCount.load(std::memory_order_acquire);
+                if (readCount > writeCount)
+                {
+                    readCount = writeCount;
+                }
+
+                if (readCount == writeCount)
+                {
+                    return false;
+                }
+
+                if (writeCount - readCount > ringSize)
+                {
+                    numOverruns += writeCount - ringSize - readCount;
+                    readCount = writeCount - ringSize;
+                }
+
+                auto const slot = (size_t)(readCount & (ringSize - 1));
+                auto& stamp = owner.stamps[slot];
+
+                if (stamp.load(std::memory_order_acquire) == readCount)
+                {
+                    std::memcpy(&destination, &owner.items[slot], sizeof(Type));
+                    copyPayload(static_cast<Type const&>(destination), owner.getPayload(slot));
+
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (stamp.load(std::memory_order_relaxed) == readCount)
+                    {
+                        ++readCount;
+                        return true;
+                    }
+                }
+
+                //
+                // The producer lapped this reader while it was copying
+                //
+                ++numOverruns;
+                ++readCount;
+            }
+        }
+
+        uint64_t getNumItemsReady() const
+        {
+            auto writeCount = owner.writeCount.load(std::memory_order_acquire);
+            return writeCount > readCount ? writeCount - readCount : 0;
+        }
+
+        uint64_t getNumOverruns() const
+        {
+            return numOverruns;
+        }
+
+    private:
+        friend class BroadcastFIFO;
+
+        Reader(BroadcastFIFO& owner_) :
+            owner(owner_),
+            readCount(owner_.writeCount.load(std::memory_order_acquire))
+        {
+            owner.numReaders.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        BroadcastFIFO& owner;
+        uint64_t readCount = 0;
+        uint64_t numOverruns = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(Reader)
+    };
+
+    //
+    // setSize and reset must not be called while the producer or any reader is running. Each slot gets
+    // numPayloadBytes of payload, starting on its own cache line.
+    //
+    void setSize(int numItems, size_t numPayloadBytes = 0)
+    {
+        auto ringSize = juce::nextPowerOfTwo(numItems);
+        items.allocate(ringSize);
+        stamps = std::make_unique<std::atomic<uint64_t>[]>((size_t)ringSize);
+
+        auto const cacheLineSize = (size_t)FIFOController::cacheLineSize;
+        payloadStride = (numPayloadBytes + cacheLineSize - 1) / cacheLineSize * cacheLineSize;
+        payloads.allocate((int)(payloadStride * (size_t)ringSize));
+
+        reset();
+    }
+
+    void reset()
+    {
+        for (size_t index = 0; index < (size_t)items.size(); ++index)
+        {
+            stamps[index].store(invalidStamp, std::memory_order_relaxed);
+        }
+
+        writeCount.store(0, std::memory_order_release);
+    }
+
+    int getRingSize() const
+    {
+        return items.size();
+    }
+
+    std::unique_ptr<Reader> createReader()
+    {
+        return std::unique_ptr<Reader>{ new Reader{ *this } };
+    }
+
+    bool hasReaders() const
+    {
+        return numReaders.load(std::memory_order_relaxed) > 0;
+    }
+
+    //
+    // Producer thread; getWritePayload() is the payload of the slot getWriteItem() returned
+    //
+    Type& getWriteItem()
+    {
+        auto count = writeCount.load(std::memory_order_relaxed);
+        auto index = count & (uint64_t)(items.size() - 1);
+
+        stamps[index].store(invalidStamp, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        return items[index];
+    }
+
+    std::byte* getWritePayload()
+    {
+        auto count = writeCount.load(std::memory_order_relaxed);
+        return getPayload((size_t)(count & (uint64_t)(items.size() - 1)));
+    }
+
+    void publish()
+    {
+        auto count = writeCount.load(std::memory_order_relaxed);
+        stamps[count & (uint64_t)(items.size() - 1)].store(count, std::memory_order_release);
+        writeCount.store(count + 1, std::memory_order_release);
+    }
+
+private:
+    static constexpr uint64_t invalidStamp = std::numeric_limits<uint64_t>::max();
+
+    AlignedSlab<Type> items;
+    std::unique_ptr<std::atomic<uint64_t>[]> stamps;
+    AlignedSlab<std::byte> payloads;
+    size_t payloadStride = 0;
+    alignas(64) std::atomic<uint64_t> writeCount = 0;
+    alignas(64) std::atomic<int> numReaders = 0;
+
+    std::byte* getPayload(size_t slot)
+    {
+        return payloadStride > 0 ? &payloads[slot * payloadStride] : nullptr;
+    }
+};
+
+#if RUN_UNIT_TESTS
+
+class BroadcastFIFOTest : public juce::UnitTest
+{
+public:
+    BroadcastFIFOTest();
+
+    void runTest() override;
+};
+
+#endif
@@ -102,7 +102,12 @@ public:
     Direct2DDemoProcessor& processor;
     Mode const mode;
 
-    static void paintSpectrum(juce::Graphics& g, juce::Rectangle<float> area, juce::StringRef bigText, juce::StringRef smallText, RealSpectrum<float> const& spectrum)
+    //
+    // The band bars go up to the top of the default band layout
+    //
+    static constexpr double maxFrequency = 20000.0;
+
+    static void paintSpectrum(juce::Graphics& g, juce::Rectangle<float> area, juce::StringRef bigText, juce::StringRef smallText, ProcessorOutput const& output)
     {
         g.setColour(juce::Colours::white);
         g.setFont(20.0f);
@@ -112,8 +117,17 @@ public:
         g.setFont(area.getHeight() * 0.6f);
         g.drawText(bigText, area, juce::Justification::centredLeft);
 
-        int numBins = juce::roundToInt(spectrum.getNumBins() * 0.4);
-        float pixelsPerBin = area.getWidth() / numBins;
+        //
+        // One bar per log-frequency band
+        //
+        auto const& bands = output.averageBands;
+        int numBands = output.getNumBands();
+        if (bands.getNumChannels() <= 0 || numBands <= 0)
+        {
+            return;
+        }
+
+        float pixelsPerBand = area.getWidth() / numBands;
         float barBottom = area.getHeight() * 0.9f + area.getY();
         float maxBarHeight = area.getHeight() * 0.6f;
         float y = barBottom - maxBarHeight;
@@ -121,28 +135,21 @@ public:
         float yScale = maxBarHeight / decibelRange.getLength();
         juce::RectangleList<int> bars;
 
-        if (spectrum.getNumChannels() <= 0)
-        {
-            return;
-        }
-
-        float const numChannelsInverse = 1.0f / (float)spectrum.getNumChannels();
-        int bin = 0;
-        float x = 0.0f;
-        while (x < area.getWidth() && bin < numBins)
+        float const numChannelsInverse = 1.0f / (float)bands.getNumChannels();
+        float x = area.getX();
+        for (int band = 0; band < numBands; ++band)
         {
             float value = 0.0f;
-            for (int channel = 0; channel < spectrum.getNumChannels(); ++channel)
+            for (int channel = 0; channel < bands.getNumChannels(); ++channel)
             {
-                value += spectrum.getBinValue(channel, bin);
+                value += bands.getSample(channel, band);
             }
-            auto mag = juce::Decibels::gainToDecibels(std::abs(value) * numChannelsInverse);
+            auto mag = juce::jlimit(decibelRange.getStart(), decibelRange.getEnd(), juce::Decibels::gainToDecibels(value * numChannelsInverse));
 
             float h = (mag - decibelRange.getStart()) * yScale;
-            bars.add(juce::Rectangle<float>{ x, y + maxBarHeight - h, pixelsPerBin, h }.getSmallestIntegerContainer());
+            bars.add(juce::Rectangle<float>{ x, y + maxBarHeight - h, pixelsPerBand * 0.9f, h }.getSmallestIntegerContainer());
 
-            ++bin;
-            x += pixelsPerBin;
+            x += pixelsPerBand;
         }
 
         g.reduceClipRegion(bars);
@@ -188,9 +195,10 @@ public:
                     text = "OpenGL";
                 }
 #endif
-                if (auto output = owner.processor.outputFIFO.getMostRecent())
+                if (auto output = owner.processor.analyser.outputFIFO.getMostRecent())
                 {
-                    paintSpectrum(g, getLocalBounds().toFloat(), text, "Owned window", output->averageSpectrum);
+                    paintSpectrum(g, getLocalBounds().toFloat(), text, "Owned window", *output);
+                    owner.processor.analyser.outputFIFO.notePainted();
                 }
             }
         }
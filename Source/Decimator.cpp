@@ -0,0 +1,272 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "Decimator.h"
+
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int index = 1; index < 50 && term > sum * 1.0e-12; ++index)
+    {
+        double halfXOverIndex = x * 0.5 / index;
+        term *= halfXOverIndex * halfXOverIndex;
+        sum += term;
+    }
+
+    return sum;
+}
+
+int Decimator::chooseFactor(double sampleRate, double maxFrequency)
+{
+    if (maxFrequency <= 0.0)
+    {
+        return 1;
+    }
+
+    int factor = 1;
+    while (factor * 2 <= maxFactor && getPassbandFrequency(sampleRate, factor * 2) >= maxFrequency)
+    {
+        factor *= 2;
+    }
+
+    return factor;
+}
+
+int Decimator::getFilterIndex(int factor)
+{
+    return juce::jlimit(0, numFactors - 1, juce::roundToInt(std::log2(factor)) - 1);
+}
+
+void Decimator::setSize(int numChannels)
+{
+    //
+    // Cutoff halfway between the passband edge and the first frequency that aliases into the passband
+    //
+    double constexpr kaiserBeta = 8.0;
+    for (int filterFactor = 2; filterFactor <= maxFactor; filterFactor *= 2)
+    {
+        int const length = filterFactor * tapsPerPhase;
+        auto& filter = filters[(size_t)getFilterIndex(filterFactor)];
+        filter.allocate((size_t)length, true);
+
+        double const cutoff = 0.5 / filterFactor;
+        double const centre = (length - 1) * 0.5;
+        double sum = 0.0;
+        for (int tap = 0; tap < length; ++tap)
+        {
+            //
+            // The length is even, so the offset from the centre is never zero
+            //
+            double offset = tap - centre;
+            double sinc = std::sin(juce::MathConstants<double>::twoPi * cutoff * offset) / (juce::MathConstants<double>::twoPi * cutoff * offset);
+            double windowPosition = offset / centre;
+            double window = besselI0(kaiserBeta * std::sqrt(juce::jmax(0.0, 1.0 - windowPosition * windowPosition))) / besselI0(kaiserBeta);
+            filter[tap] = (float)(sinc * window);
+            sum += sinc * window;
+        }
+
+        //
+        // Unity gain at DC
+        //
+        juce::FloatVectorOperations::multiply(filter.getData(), (float)(1.0 / sum), length);
+    }
+
+    channels.clear();
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto state = std::make_unique<Channel>();
+        state->history.allocate((size_t)(maxFactor * tapsPerPhase * 2), true);
+        channels.add(std::move(state));
+    }
+
+    setFactor(factor);
+}
+
+void Decimator::setFactor(int factor_)
+{
+    jassert(juce::isPowerOfTwo(factor_) && factor_ <= maxFactor);
+
+    factor = juce::jlimit(1, maxFactor, factor_);
+    numTaps = factor * tapsPerPhase;
+    coefficients = factor > 1 ? filters[(size_t)getFilterIndex(factor)].getData() : nullptr;
+
+    reset();
+}
+
+void Decimator::reset()
+{
+    for (auto state : channels)
+    {
+        juce::FloatVectorOperations::clear(state->history, maxFactor * tapsPerPhase * 2);
+        state->position = 0;
+        state->phase = 0;
+    }
+}
+
+int Decimator::process(int channel, float const* input, int numInputSamples, float* output)
+{
+    if (factor <= 1)
+    {
+        juce::FloatVectorOperations::copy(output, input, numInputSamples);
+        return numInputSamples;
+    }
+
+    auto& state = *channels[channel];
+    int numOutputSamples = 0;
+
+    for (int index = 0; index < numInputSamples; ++index)
+    {
+        state.history[state.position] = input[index];
+        state.history[state.position + numTaps] = input[index];
+        state.position = state.position + 1 < numTaps ? state.position + 1 : 0;
+
+        if (++state.phase < factor)
+        {
+            continue;
+        }
+
+        //
+        // position is now the oldest sample; the filter is symmetric, so no need to reverse it
+        //
+        state.phase = 0;
+
+        auto const oldest = state.history + state.position;
+        float sum = 0.0f;
+        for (int tap = 0; tap < numTaps; ++tap)
+        {
+            sum += coefficients[tap] * oldest[tap];
+        }
+
+        output[numOutputSamples++] = sum;
+    }
+
+    return numOutputSamples;
+}
+
+#if RUN_UNIT_TESTS
+
+DecimatorTest::DecimatorTest() : UnitTest("DecimatorTest")
+{
+}
+
+void DecimatorTest::runTest()
+{
+    double constexpr sampleRate = 48000.0;
+
+    {
+        beginTest("Choose factor");
+
+        expect(Decimator::chooseFactor(sampleRate, 0.0) == 1);
+        expect(Decimator::chooseFactor(sampleRate, 20000.0) == 1);
+        expect(Decimator::chooseFactor(sampleRate, 9000.0) == 2);
+        expect(Decimator::chooseFactor(sampleRate, 2000.0) == 8);
+        expect(Decimator::chooseFactor(sampleRate, 200.0) == Decimator::maxFactor);
+        expect(Decimator::getPassbandFrequency(sampleRate, 8) >= 2000.0);
+    }
+
+    Decimator decimator;
+    decimator.setSize(1);
+    decimator.setFactor(8);
+    expect(decimator.getFactor() == 8);
+
+    int constexpr numInputSamples = 48000;
+    std::vector<float> input((size_t)numInputSamples);
+    std::vector<float> output((size_t)numInputSamples);
+
+    auto measureAmplitude = [&](double frequency)
+    {
+        for (int index = 0; index < numInputSamples; ++index)
+        {
+            input[(size_t)index] = (float)std::sin(juce::MathConstants<double>::twoPi * frequency * index / sampleRate);
+        }
+
+        decimator.reset();
+        int numOutputSamples = decimator.process(0, input.data(), numInputSamples, output.data());
+        expect(numOutputSamples == numInputSamples / decimator.getFactor());
+
+        //
+        // Skip the filter's startup transient; use the RMS level since there may only be a few samples per cycle
+        //
+        double sumOfSquares = 0.0;
+        int const firstSample = Decimator::tapsPerPhase;
+        for (int index = firstSample; index < numOutputSamples; ++index)
+        {
+            sumOfSquares += output[(size_t)index] * output[(size_t)index];
+        }
+        return (float)std::sqrt(2.0 * sumOfSquares / (numOutputSamples - firstSample));
+    };
+
+    {
+        beginTest("Passband");
+
+        for (double frequency : { 50.0, 500.0, 2000.0 })
+        {
+            auto amplitude = measureAmplitude(frequency);
+            expectWithinAbsoluteError(amplitude, 1.0f, 0.01f, juce::String{ frequency } + " Hz amplitude " + juce::String{ amplitude });
+        }
+    }
+
+    {
+        beginTest("Alias rejection");
+
+        //
+        // Above 3.6 kHz would alias into the 0 - 2.4 kHz passband of the 6 kHz decimated signal
+        //
+        for (double frequency : { 4000.0, 5000.0, 10000.0 })
+        {
+            auto amplitude = measureAmplitude(frequency);
+            expect(amplitude < 0.001f, juce::String{ frequency } + " Hz amplitude " + juce::String{ amplitude });
+        }
+    }
+
+    {
+        beginTest("Chunk size doesn't matter");
+
+        juce::Random random;
+        for (auto& sample : input)
+        {
+            sample = random.nextFloat() * 2.0f - 1.0f;
+        }
+
+        decimator.reset();
+        int numExpected = decimator.process(0, input.data(), numInputSamples, output.data());
+        std::vector<float> expected{ output.begin(), output.begin() + numExpected };
+
+        decimator.reset();
+        int inputIndex = 0;
+        int outputIndex = 0;
+        while (inputIndex < numInputSamples)
+        {
+            int chunkSize = juce::jmin(1 + random.nextInt(100), numInputSamples - inputIndex);
+            outputIndex += decimator.process(0, input.data() + inputIndex, chunkSize, output.data() + outputIndex);
+            inputIndex += chunkSize;
+        }
+
+        expect(outputIndex == numExpected);
+        expect(std::equal(expected.begin(), expected.end(), output.begin()));
+    }
+}
+
+#endif
@@ -0,0 +1,108 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Lowpass filters and downsamples by a power of two ahead of the FFT, so displays that only need the low
+// end of the spectrum get finer frequency resolution for the same FFT size
+//
+// The filter is a Kaiser-windowed sinc with tapsPerPhase taps for each of the factor polyphase branches.
+// Only every factor-th output is computed, so the cost is tapsPerPhase multiplies per input sample
+// whatever the factor. Everything below passbandFraction of the decimated sample rate is kept; aliases
+// only land between there and the decimated Nyquist frequency.
+//
+class Decimator
+{
+public:
+    static constexpr int maxFactor = 16;
+    static constexpr int tapsPerPhase = 32;
+    static constexpr double passbandFraction = 0.4;
+
+    //
+    // Largest factor that still keeps maxFrequency in the passband; 1 if maxFrequency is zero
+    //
+    static int chooseFactor(double sampleRate, double maxFrequency);
+
+    static double getPassbandFrequency(double sampleRate, int factor)
+    {
+        return sampleRate / factor * passbandFraction;
+    }
+
+    //
+    // Allocates the filters for every factor; call from prepareToPlay
+    //
+    void setSize(int numChannels);
+
+    //
+    // Doesn't allocate; clears the filter history
+    //
+    void setFactor(int factor);
+    void reset();
+
+    int getFactor() const
+    {
+        return factor;
+    }
+
+    //
+    // Returns the number of output samples; output needs room for numInputSamples / factor + 1 samples
+    //
+    int process(int channel, float const* input, int numInputSamples, float* output);
+
+private:
+    struct Channel
+    {
+        //
+        // Each sample is stored twice, numTaps apart, so the last numTaps samples are always contiguous
+        //
+        juce::HeapBlock<float> history;
+        int position = 0;
+        int phase = 0;
+    };
+
+    static constexpr int numFactors = 4;
+
+    juce::OwnedArray<Channel> channels;
+    std::array<juce::HeapBlock<float>, numFactors> filters;
+    float const* coefficients = nullptr;
+    int factor = 1;
+    int numTaps = 0;
+
+    static int getFilterIndex(int factor);
+};
+
+#if RUN_UNIT_TESTS
+
+class DecimatorTest : public juce::UnitTest
+{
+public:
+    DecimatorTest();
+
+    void runTest() override;
+};
+
+#endif
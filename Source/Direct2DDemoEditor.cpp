@@ -83,6 +83,7 @@ Direct2DDemoEditor::Direct2DDemoEditor(Direct2DDemoProcessor& p)
 
     updateFrameRate();
     updateRenderer();
+    updateMaximumDisplayFrequency();
 }
 
 Direct2DDemoEditor::~Direct2DDemoEditor()
@@ -90,6 +91,7 @@ Direct2DDemoEditor::~Direct2DDemoEditor()
     timingSource.stopAllTimers();
 
     audioProcessor.state.state.removeListener(this);
+    audioProcessor.setMaximumDisplayFrequency(0.0);
 }
 
 void Direct2DDemoEditor::paintTimerCallback()
@@ -100,14 +102,6 @@ void Direct2DDemoEditor::paintTimerCallback()
     {
         window->inner.repaint();
     }
-
-    //
-    // Throw away excess data from the processor output FIFO
-    //
-    if (audioProcessor.outputFIFO.getNumItemsStored() > 0)
-    {
-        audioProcessor.outputFIFO.advanceReadPosition();
-    }
 }
 
 void Direct2DDemoEditor::parentHierarchyChanged()
@@ -151,16 +145,18 @@ void Direct2DDemoEditor::paint(juce::Graphics& g)
 
     g.fillAll(juce::Colours::black);
 
-    //painter->paint(g, getLocalBounds().toFloat(), audioProcessor.outputFIFO.getMostRecent());
+    //painter->paint(g, getLocalBounds().toFloat(), audioProcessor.analyser.outputFIFO.getMostRecent());
 
     paintSpectrum(g);
     paintModeText(g);
     paintStats(g);
+    paintFIFOStats(g);
+    paintLatencyStats(g);
 }
 
 void Direct2DDemoEditor::paintSpectrum(juce::Graphics& g)
 {
-    if (auto output = audioProcessor.outputFIFO.getMostRecent())
+    if (auto output = audioProcessor.analyser.outputFIFO.getMostRecent())
     {
         auto area = getLocalBounds();
         if (auto firstOwnedWindow = childWindows.getFirst())
@@ -174,7 +170,9 @@ void Direct2DDemoEditor::paintSpectrum(juce::Graphics& g)
 
         juce::Graphics::ScopedSaveState saveState{ g };
 
-        ChildWindow::paintSpectrum(g, area.toFloat(), "Editor", "Editor paint()", output->averageSpectrum);
+        ChildWindow::paintSpectrum(g, area.toFloat(), "Editor", "Editor paint()", *output);
+
+        audioProcessor.analyser.outputFIFO.notePainted();
     }
 }
 
@@ -315,7 +313,7 @@ void Direct2DDemoEditor::paintStats(juce::Graphics& /*g*/)
     g.setFont(15.0f);
     g.setColour(juce::Colours::white);
 
-    juce::Rectangle<int> r{ 0, getHeight() - 100, getWidth(), 20 };
+    juce::Rectangle<int> r{ 0, getHeight() - 140, getWidth(), 20 };
 
     paintStat(g, r, "Timer interval (ms): ", timingSource.measuredTimerIntervalSeconds);
     r.translate(0, r.getHeight());
@@ -341,6 +339,50 @@ void Direct2DDemoEditor::paintStats(juce::Graphics& /*g*/)
 #endif
 }
 
+void Direct2DDemoEditor::paintFIFOStats(juce::Graphics& g)
+{
+    //
+    // Overruns mean the analysis fell behind and input audio was dropped; underruns mean the analysis
+    // tried to read audio that hadn't arrived yet. The totals come from inputFIFO rather than its active
+    // ring, since prepareToPlay can free the ring on another thread.
+    //
+    auto overruns = audioProcessor.inputFIFO.getNumOverrunSamples();
+    auto underruns = audioProcessor.inputFIFO.getNumUnderrunSamples();
+
+    g.setFont(15.0f);
+    g.setColour(overruns + underruns > 0 ? juce::Colours::red : juce::Colours::white);
+
+    juce::String text;
+    text << "Input FIFO overruns: " << (juce::int64)overruns << " samples / underruns: " << (juce::int64)underruns << " samples";
+    g.drawText(text, getLocalBounds().removeFromBottom(20).withTrimmedLeft(10), juce::Justification::centredLeft);
+}
+
+void Direct2DDemoEditor::paintLatencyStats(juce::Graphics& g)
+{
+    //
+    // Median and 99th percentile latency from the host block arriving to the spectrum being published, from
+    // publishing to the first paint, and end to end
+    //
+    auto const& latencies = audioProcessor.analyser.outputFIFO.latencies;
+
+    auto describe = [](juce::StringRef name, LatencyHistogram const& histogram)
+    {
+        juce::String text;
+        text << name << juce::String{ histogram.getPercentile(50.0) * 1000.0, 1 } << " / " << juce::String{ histogram.getPercentile(99.0) * 1000.0, 1 };
+        return text;
+    };
+
+    g.setFont(15.0f);
+    g.setColour(juce::Colours::white);
+
+    juce::String text;
+    text << "Latency p50 / p99 (ms): "
+        << describe("block to FFT ", latencies.arrivalToPublish) << ", "
+        << describe("FFT to paint ", latencies.publishToPaint) << ", "
+        << describe("total ", latencies.arrivalToPaint);
+    g.drawText(text, getLocalBounds().withTrimmedBottom(20).removeFromBottom(20).withTrimmedLeft(10), juce::Justification::centredLeft);
+}
+
 void Direct2DDemoEditor::resized()
 {
     settingsComponent.setBounds(getWidth() - 30, getHeight() - 30, 500, 200);
@@ -417,3 +459,22 @@ void Direct2DDemoEditor::updateRenderer()
 
     parentHierarchyChanged();
 }
+
+void Direct2DDemoEditor::updateMaximumDisplayFrequency()
+{
+    //
+    // Let the processor decimate down to the highest frequency the displays actually draw
+    //
+    double maxFrequency = 0.0;
+    if (painter)
+    {
+        maxFrequency = juce::jmax(maxFrequency, (double)SpectrumRingDisplay::maxFrequency);
+    }
+
+    if (childWindows.size() > 0)
+    {
+        maxFrequency = juce::jmax(maxFrequency, ChildWindow::maxFrequency);
+    }
+
+    audioProcessor.setMaximumDisplayFrequency(maxFrequency);
+}
@@ -60,6 +60,7 @@ private:
 
     void updateFrameRate();
     void updateRenderer();
+    void updateMaximumDisplayFrequency();
 
     void paintSpectrum(juce::Graphics& g);
     void paintModeText(juce::Graphics& g);
@@ -67,6 +68,8 @@ private:
     void paintFrameDurationStats(juce::Graphics& g, juce::Rectangle<int>& r, juce::StatisticsAccumulator<double> const& frameDurationSeconds);
     void paintWmPaintCount(juce::Graphics& g, juce::Rectangle<int>& r, int wmPaintCount);
     void paintStats(juce::Graphics& g);
+    void paintFIFOStats(juce::Graphics& g);
+    void paintLatencyStats(juce::Graphics& g);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Direct2DDemoEditor)
 };
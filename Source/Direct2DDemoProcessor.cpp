@@ -37,55 +37,101 @@ Direct2DDemoProcessor::Direct2DDemoProcessor() :
                 60.0f),
             std::make_unique<juce::AudioParameterChoice>(juce::ParameterID{ rendererID, 1 }, "Render mode",
                 juce::StringArray{ "Software renderer", "Direct2D from VBlankAttachment callback", "Direct2D from dedicated thread" },
-                RenderMode::software)
+                RenderMode::software),
+            std::make_unique<juce::AudioParameterChoice>(juce::ParameterID{ fftSizeID, 1 }, "FFT size",
+                FFTPlans::getSizeNames(),
+                FFTPlans::defaultOrder - FFTPlans::minOrder),
+            std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{ overlapID, 1 }, "FFT overlap",
+                juce::NormalisableRange{ 0.0f, SpectrumAnalyser::maxOverlapPercent },
+                SpectrumAnalyser::defaultOverlapPercent)
         }),
-    parameters(this, state.state),
-    fft(fftOrder),
-    fftWindow(fft.getSize(), juce::dsp::WindowingFunction<float>::blackmanHarris, true),
-    fftWorkBuffer(2, fft.getSize() * 2)
+    parameters(this, state.state)
 {
-    fftNormalizationScale = 2.0f / (float)fft.getSize();
+    fftSizeParameter = state.getRawParameterValue(fftSizeID);
+    overlapParameter = state.getRawParameterValue(overlapID);
 
 #if RUN_UNIT_TESTS
     UnitTests unitTests;
     juce::UnitTestRunner runner;
     runner.runAllTests();
 #endif
+
+    //
+    // Service input FIFO resize requests from the audio thread
+    //
+    startTimer(100);
 }
 
-void Direct2DDemoProcessor::prepareToPlay(double sampleRate_, int samplesPerBlock)
+Direct2DDemoProcessor::~Direct2DDemoProcessor()
 {
-    sampleRate = sampleRate_;
-    fftHertzPerBin = sampleRate_ / fft.getSize();
+    analysisThread.stop();
+    analyser.release();
+}
 
-    inputFIFO.setSize(2, fft.getSize() * 4);
-    inputFIFO.reset(0);
+void Direct2DDemoProcessor::prepareToPlay(double sampleRate_, int samplesPerBlock)
+{
+    //
+    // The analysis thread reads everything set up here, so stop it first
+    //
+    analysisThread.stop();
 
-    outputFIFO.setSize(2 /* numItems */, 2 /* numChannels */, fft.getSize());
-    outputFIFO.reset();
+    sampleRate = sampleRate_;
+    int const numChannels = juce::jlimit(1, maxNumChannels, getTotalNumInputChannels());
 
-    fftOverlapSkipSamples = fft.getSize() - juce::roundToInt(fftOverlapPercent * 0.01f * fft.getSize());
-    auto spectraPerSecond = (float)sampleRate_ / (float)fftOverlapSkipSamples;
-    float constexpr energyAveragingSeconds = 0.1f;
-    energyWeight = 1.0f - 1.0f / (spectraPerSecond * energyAveragingSeconds);
+    //
+    // Size the input FIFO to hold a full host block on top of a partially filled FFT frame at the
+    // largest FFT size, so the FFT size can change without resizing anything. If the host block size grows
+    // anyway, a second of overflow covers the blocks that arrive before the timer delivers a larger ring.
+    //
+    inputFIFO.setSize(numChannels, juce::jmax(FFTPlans::maxSize * 2, samplesPerBlock + FFTPlans::maxSize), AudioFIFO::Backend::mirroredMemory,
+        (int)std::ceil(sampleRate));
+    inputFIFO.reset();
 
-    averagingSpectrum = RealSpectrum<float>{}.withChannels(2).withFFTSize(fft.getSize());
-    averagingSpectrum.clear();
+    analyser.setFFTOrder(FFTPlans::minOrder + juce::roundToInt(fftSizeParameter->load()));
+    analyser.setOverlapPercent(overlapParameter->load());
 
     tone.setAmplitude(1.0f);
     tone.setFrequency(toneFrequency);
     tone.prepareToPlay(samplesPerBlock, sampleRate_);
+
+    //
+    // Spread the channels across cores for surround layouts; the analysis thread takes a share too.
+    // Never fan out from the audio thread, since it would have to wait for the workers.
+    //
+    preparedAnalysisMode = analysisMode;
+    int numWorkers = 0;
+    if (preparedAnalysisMode == AnalysisMode::workerThread)
+    {
+        int const numChannelTasks = (numChannels + 1) / 2;
+        int const numSpareCores = juce::SystemStats::getNumCpus() - 2;
+        numWorkers = juce::jlimit(0, juce::jmax(0, numSpareCores), numChannelTasks - 1);
+    }
+
+    analyser.prepare(sampleRate, numChannels, numWorkers);
+
+    if (preparedAnalysisMode == AnalysisMode::workerThread)
+    {
+        analysisThread.start();
+    }
 }
 
 void Direct2DDemoProcessor::releaseResources()
 {
+    analysisThread.stop();
+    analyser.release();
 }
 
 bool Direct2DDemoProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 {
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo() 
-        && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::disabled())
+    //
+    // Any layout up to maxNumChannels, as long as the input and output match
+    //
+    auto const input = layouts.getMainInputChannelSet();
+    auto const output = layouts.getMainOutputChannelSet();
+    if (output.size() > maxNumChannels || input.size() > maxNumChannels)
+        return false;
+
+    if (!input.isDisabled() && !output.isDisabled() && input != output)
         return false;
 
     return true;
@@ -94,6 +140,7 @@ bool Direct2DDemoProcessor::isBusesLayoutSupported(const BusesLayout& layouts) c
 void Direct2DDemoProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& /*midiMessages*/)
 {
     juce::ScopedNoDenormals noDenormals;
+    RealtimeSafetyMonitor::ScopedRealtimeSection realtimeSection{ "processBlock" };
 
 //     juce::AudioSourceChannelInfo asci{ buffer };
 //     tone.getNextAudioBlock(asci);
@@ -108,71 +155,103 @@ void Direct2DDemoProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce:
 //     }
 //     tone.setFrequency(toneFrequency);
 
-    //
-    // Store samples in the FIFO and run the FFT if there's enough data
-    //
-    inputFIFO.write(buffer);
-    while (inputFIFO.getNumSamplesStored() >= fft.getSize())
-    {
-        processFFT();
-    }
+    processSamples(buffer);
+}
+
+void Direct2DDemoProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& /*midiMessages*/)
+{
+    juce::ScopedNoDenormals noDenormals;
+    RealtimeSafetyMonitor::ScopedRealtimeSection realtimeSection{ "processBlock" };
+
+    processSamples(buffer);
 }
 
-void Direct2DDemoProcessor::processFFT()
+template <typename SampleType> void Direct2DDemoProcessor::processSamples(juce::AudioBuffer<SampleType> const& buffer)
 {
-    auto processorOutput = outputFIFO.getWritePointer();
-    auto& spectrum = processorOutput->spectrum;
-    auto& averageSpectrum = processorOutput->averageSpectrum;
+    auto const arrivalTicks = juce::Time::getHighResolutionTicks();
+
+    analyser.setFFTOrder(FFTPlans::minOrder + juce::roundToInt(fftSizeParameter->load(std::memory_order_relaxed)));
+    analyser.setOverlapPercent(overlapParameter->load(std::memory_order_relaxed));
 
     //
-    // Read enough samples from the ring to run the FFT
-    // -but-
-    // only partially advance the read count for the ring so the next FFT overlaps
+    // Pick up a larger input FIFO if the message thread has allocated one; if the host block size grew
+    // past what the FIFO can hold, ask the message thread for a larger FIFO
     //
-    fftWorkBuffer.clear();
-    inputFIFO.read(fftWorkBuffer, fft.getSize(), fftOverlapSkipSamples);
+    auto& fifo = inputFIFO.getFIFOForAudioThread();
+    if (buffer.getNumSamples() + FFTPlans::maxSize > fifo.getNumSamples())
+    {
+        inputFIFO.requestMinimumSize(buffer.getNumSamples() + FFTPlans::maxSize);
+    }
 
     //
-    // Run the FFT for each channel
+    // Worker thread analysis; just store the samples and wake the worker. Anything that doesn't fit in the
+    // ring waits in the input FIFO's overflow until the worker catches up or the larger ring arrives.
     //
-    for (int channel = 0; channel < fftWorkBuffer.getNumChannels(); ++channel)
+    if (preparedAnalysisMode == AnalysisMode::workerThread)
     {
-        //
-        // Apply windowing function to the input data
-        //
-        fftWindow.multiplyWithWindowingTable(fftWorkBuffer.getWritePointer(channel), fft.getSize());
-
-        //
-        // Run the FFT; performFrequencyOnlyForwardTransform takes the magnitude of the complex FFT output
-        //
-        fft.performFrequencyOnlyForwardTransform(fftWorkBuffer.getWritePointer(channel), true);
+        analyser.noteInputBlock(inputFIFO.write(buffer), arrivalTicks);
+        analysisThread.signal();
+        return;
     }
 
     //
-    // Store the normalized FFT results
-    // 
-    spectrum.copyFrom(fftWorkBuffer, fft.getSize() / 2 + 1, fftNormalizationScale);
-
+    // Store samples in the FIFO and run the FFT if there's enough data
     //
-    // Spectrum averaging
+    // Write in chunks that fit in the FIFO so a larger than expected block doesn't drop any input
     //
-    float newScale = 1.0f - energyWeight;
-    for (int channel = 0; channel < averagingSpectrum.getNumChannels(); ++channel)
+    analyser.update();
+
+    int sampleIndex = 0;
+    while (sampleIndex < buffer.getNumSamples())
     {
-        for (int bin = 0; bin < averagingSpectrum.getNumBins(); ++bin)
-        {
-            auto accumulator = averagingSpectrum.getBinMagnitude(channel, bin);
-            accumulator = accumulator * energyWeight + spectrum.getBinMagnitude(channel, bin) * newScale;
-            averagingSpectrum.setBinValue(channel, bin, accumulator);
-        }
+        int const numSamplesWritten = fifo.write(buffer, sampleIndex, juce::jmin(buffer.getNumSamples() - sampleIndex, fifo.getNumSamplesFree()));
+        analyser.noteInputBlock(numSamplesWritten, arrivalTicks);
+        sampleIndex += numSamplesWritten;
+
+        analyser.analyse(fifo);
     }
+}
+
+void Direct2DDemoProcessor::timerCallback()
+{
+    inputFIFO.service();
 
-    averageSpectrum.copyFrom(averagingSpectrum);
+    analyser.freeRetiredBandMaps();
 
+#if REALTIME_SAFETY_CHECKS
     //
-    // Bump the ring buffer
+    // Report any new allocations or locks on the audio or analysis threads
     //
-    outputFIFO.advanceWritePosition();
+    auto counts = RealtimeSafetyMonitor::getViolationCounts();
+    auto section = RealtimeSafetyMonitor::getLastViolationSection();
+    if (counts.getTotal() != numReportedRealtimeViolations)
+    {
+        numReportedRealtimeViolations = counts.getTotal();
+        juce::Logger::writeToLog("Real-time safety: " + juce::String{ (juce::int64)counts.allocations } + " allocations, "
+            + juce::String{ (juce::int64)counts.deallocations } + " deallocations, "
+            + juce::String{ (juce::int64)counts.locks } + " locks; most recently in "
+            + (section ? section : "unknown"));
+        jassertfalse;
+    }
+#endif
+}
+
+void Direct2DDemoProcessor::analyseOnWorkerThread()
+{
+    //
+    // If the audio thread is swapping in a larger input FIFO, skip this pass; the next signal will
+    // pick up the samples
+    //
+    auto fifo = inputFIFO.lockForConsumer();
+    if (fifo == nullptr)
+    {
+        return;
+    }
+
+    analyser.update();
+    analyser.analyse(*fifo);
+
+    inputFIFO.unlockForConsumer();
 }
 
 juce::AudioProcessorEditor* Direct2DDemoProcessor::createEditor()
@@ -25,9 +25,10 @@ SOFTWARE.
 #pragma once
 
 #include <JuceHeader.h>
-#include "AudioFIFO.h"
-#include "Spectrum.h"
-#include "ProcessorOutputFIFO.h"
+#include "ResizableAudioFIFO.h"
+#include "AnalysisThread.h"
+#include "SpectrumAnalyser.h"
+#include "RealtimeSafetyMonitor.h"
 
 enum RenderMode
 {
@@ -36,11 +37,23 @@ enum RenderMode
     openGL
 }; 
 
-class Direct2DDemoProcessor : public juce::AudioProcessor
+//
+// audioThread runs the FFTs inside processBlock
+//
+// workerThread has processBlock only write to the input FIFO and wake the analysis thread, which runs
+// the FFTs and publishes the results
+//
+enum class AnalysisMode
+{
+    audioThread,
+    workerThread
+};
+
+class Direct2DDemoProcessor : public juce::AudioProcessor, private juce::Timer
 {
 public:
     Direct2DDemoProcessor();
-    ~Direct2DDemoProcessor() override = default;
+    ~Direct2DDemoProcessor() override;
 
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
@@ -51,6 +64,13 @@ public:
 
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
 
+    //
+    // Double precision hosts pass their buffers straight through; the samples are converted to float as
+    // they're written to the input FIFO
+    //
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+
     juce::AudioProcessorEditor* createEditor() override;
 
     bool hasEditor() const override { return true; }
@@ -72,19 +92,74 @@ public:
 
     int getFFTLength() const
     {
-        return fft.getSize();
+        return analyser.getFFTSize();
+    }
+
+    //
+    // Takes effect on the next call to prepareToPlay
+    //
+    void setAnalysisMode(AnalysisMode mode)
+    {
+        analysisMode = mode;
     }
 
+    //
+    // Format for the spectra in analyser.outputFIFO; takes effect on the next call to prepareToPlay
+    //
+    void setTransportFormat(TransportFormat format)
+    {
+        analyser.setTransportFormat(format);
+    }
+
+    //
+    // Run the FFTs for each pair of channels as one complex FFT; can be changed at any time
+    //
+    void setRealPairFFT(bool shouldPairChannels)
+    {
+        analyser.setRealPairFFT(shouldPairChannels);
+    }
+
+    //
+    // Can be changed at any time; picked up by the analysis before the next spectrum
+    //
+    void setAnalysisEngine(AnalysisEngine engine)
+    {
+        analyser.setAnalysisEngine(engine);
+    }
+
+    void setSlidingDFTHopSize(int hopSize)
+    {
+        analyser.setSlidingDFTHopSize(hopSize);
+    }
+
+    //
+    // Highest frequency any open display needs; the analysis decimates the input as far as it can while
+    // keeping this frequency. Zero analyses the full band.
+    //
+    void setMaximumDisplayFrequency(double frequency)
+    {
+        analyser.setMaximumDisplayFrequency(frequency);
+    }
+
+    //
+    // Message thread; the band maps for the new layout are built here and picked up by the analysis
+    //
+    void setBandLayout(BandMap::Layout const& layout)
+    {
+        analyser.setBandLayout(layout);
+    }
+
+    static constexpr int maxNumChannels = SpectrumAnalyser::maxNumChannels;
+
     const juce::String frameRateID = "FrameRate";
     const juce::String rendererID = "Renderer";
+    const juce::String fftSizeID = "FFTSize";
+    const juce::String overlapID = "FFTOverlap";
 
     juce::AudioProcessorValueTreeState state;
     double sampleRate = 48000.0;
-    int const fftOrder = 10;
-    int fftOverlapSkipSamples = 0;
-    double fftHertzPerBin = 0.0;
-    AudioFIFO inputFIFO;
-    ProcessorOutputFIFO outputFIFO;
+    ResizableAudioFIFO inputFIFO;
+    SpectrumAnalyser analyser;
 
     struct Parameters
     {
@@ -95,18 +170,21 @@ public:
     } parameters;
 
 private:
-    juce::dsp::FFT fft;
-    float fftNormalizationScale = 1.0f;
+    std::atomic<float>* fftSizeParameter = nullptr;
+    std::atomic<float>* overlapParameter = nullptr;
     double toneFrequency = 20.0;
     double frequencyMultiplier = 1.02;
     juce::ToneGeneratorAudioSource tone;
-    juce::dsp::WindowingFunction<float> fftWindow;
-    juce::AudioBuffer<float> fftWorkBuffer;
-    RealSpectrum<float> averagingSpectrum;
-    float energyWeight = 1.0f;
-    float const fftOverlapPercent = 75.0f;
+    AnalysisMode analysisMode = AnalysisMode::workerThread;
+    AnalysisMode preparedAnalysisMode = AnalysisMode::workerThread;
+    AnalysisThread analysisThread{ [this] { analyseOnWorkerThread(); } };
+#if REALTIME_SAFETY_CHECKS
+    uint64_t numReportedRealtimeViolations = 0;
+#endif
 
-    void processFFT();
+    template <typename SampleType> void processSamples(juce::AudioBuffer<SampleType> const& buffer);
+    void analyseOnWorkerThread();
+    void timerCallback() override;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Direct2DDemoProcessor)
 };
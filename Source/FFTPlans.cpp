@@ -0,0 +1,199 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "FFTPlans.h"
+
+FFTPlans::Plan::Plan(int order_) :
+    order(order_),
+    fft(order_),
+    windowTable(1 << order_),
+    normalizationScale(2.0f / (float)(1 << order_))
+{
+    juce::dsp::WindowingFunction<float>::fillWindowingTables(windowTable, (size_t)getSize(), juce::dsp::WindowingFunction<float>::blackmanHarris, true);
+
+    //
+    // The window is normalised to a sum of getSize(), so the noise bandwidth is the mean of the squared window
+    //
+    double sumOfSquares = 0.0;
+    for (int index = 0; index < getSize(); ++index)
+    {
+        sumOfSquares += (double)windowTable[index] * windowTable[index];
+    }
+
+    noiseBandwidthBins = (float)(sumOfSquares / getSize());
+}
+
+void FFTPlans::Plan::performRealPairMagnitudeTransform(float* first, float* second, std::complex<float>* workspace, int slot) const
+{
+    int const size = getSize();
+    auto input = workspace;
+    auto output = workspace + size;
+
+    //
+    // First channel in the real part, second channel in the imaginary part
+    //
+    for (int index = 0; index < size; ++index)
+    {
+        input[index] = { first[index], second[index] };
+    }
+
+    getFFT(slot).perform(input, output, false);
+
+    //
+    // Split the two spectra with conjugate symmetry:
+    //
+    //      first[k] = (Z[k] + conj(Z[N - k])) / 2
+    //      second[k] = (Z[k] - conj(Z[N - k])) / 2i
+    //
+    for (int bin = 0; bin <= size / 2; ++bin)
+    {
+        auto const z = output[bin];
+        auto const mirrored = std::conj(output[(size - bin) & (size - 1)]);
+
+        first[bin] = std::abs(z + mirrored) * 0.5f;
+        second[bin] = std::abs(z - mirrored) * 0.5f;
+    }
+}
+
+void FFTPlans::Plan::performMagnitudeTransform(float* data, std::complex<float>* workspace, int slot) const
+{
+    int const size = getSize();
+    auto input = workspace;
+    auto output = workspace + size;
+
+    for (int index = 0; index < size; ++index)
+    {
+        input[index] = { data[index], 0.0f };
+    }
+
+    getFFT(slot).perform(input, output, false);
+
+    for (int bin = 0; bin <= size / 2; ++bin)
+    {
+        data[bin] = std::abs(output[bin]);
+    }
+}
+
+FFTPlans::FFTPlans()
+{
+    for (int order = minOrder; order <= maxOrder; ++order)
+    {
+        plans.add(std::make_unique<Plan>(order));
+    }
+}
+
+FFTPlans::Plan const& FFTPlans::getPlan(int order) const
+{
+    order = juce::jlimit(minOrder, maxOrder, order);
+    return *plans[order - minOrder];
+}
+
+void FFTPlans::setNumSlots(int numSlots)
+{
+    for (auto plan : plans)
+    {
+        while (plan->slotFFTs.size() < numSlots - 1)
+        {
+            plan->slotFFTs.add(std::make_unique<juce::dsp::FFT>(plan->order));
+        }
+
+        plan->slotFFTs.removeLast(plan->slotFFTs.size() - juce::jmax(0, numSlots - 1));
+    }
+}
+
+juce::StringArray FFTPlans::getSizeNames()
+{
+    juce::StringArray names;
+    for (int order = minOrder; order <= maxOrder; ++order)
+    {
+        names.add(juce::String{ 1 << order });
+    }
+
+    return names;
+}
+
+#if RUN_UNIT_TESTS
+
+FFTPlansTest::FFTPlansTest() : UnitTest("FFTPlansTest")
+{
+}
+
+void FFTPlansTest::runTest()
+{
+    beginTest("Real pair and single channel transforms");
+
+    FFTPlans plans;
+    juce::Random random;
+
+    //
+    // The largest size is the one where JUCE's fallback engine switches to heap scratch space for the
+    // real-only transform, so make sure it matches too
+    //
+    for (int order : { FFTPlans::minOrder, FFTPlans::minOrder + 1, FFTPlans::minOrder + 2, FFTPlans::maxOrder })
+    {
+        auto const& plan = plans.getPlan(order);
+        int const size = plan.getSize();
+        expect(plan.order == order);
+
+        juce::AudioBuffer<float> separate{ 2, size * 2 };
+        juce::AudioBuffer<float> paired{ 2, size };
+        juce::AudioBuffer<float> single{ 2, size };
+        juce::HeapBlock<std::complex<float>> workspace{ (size_t)size * 2 };
+
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            for (int index = 0; index < size; ++index)
+            {
+                auto sample = random.nextFloat() * 2.0f - 1.0f;
+                separate.setSample(channel, index, sample);
+                paired.setSample(channel, index, sample);
+                single.setSample(channel, index, sample);
+            }
+
+            plan.fft.performFrequencyOnlyForwardTransform(separate.getWritePointer(channel), true);
+            plan.performMagnitudeTransform(single.getWritePointer(channel), workspace);
+        }
+
+        plan.performRealPairMagnitudeTransform(paired.getWritePointer(0), paired.getWritePointer(1), workspace);
+
+        //
+        // Rounding errors grow with the size of the transform
+        //
+        float const tolerance = 1.0e-3f * (float)size / (float)(1 << FFTPlans::minOrder);
+        float maxPairError = 0.0f, maxSingleError = 0.0f;
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            for (int bin = 0; bin <= size / 2; ++bin)
+            {
+                maxPairError = juce::jmax(maxPairError, std::abs(paired.getSample(channel, bin) - separate.getSample(channel, bin)));
+                maxSingleError = juce::jmax(maxSingleError, std::abs(single.getSample(channel, bin) - separate.getSample(channel, bin)));
+            }
+        }
+
+        expect(maxPairError < tolerance, "Real pair magnitudes differ by " + juce::String{ maxPairError } + " at order " + juce::String{ order });
+        expect(maxSingleError < tolerance, "Single channel magnitudes differ by " + juce::String{ maxSingleError } + " at order " + juce::String{ order });
+    }
+}
+
+#endif
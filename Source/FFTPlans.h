@@ -0,0 +1,124 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// FFT objects and windowing tables for every supported FFT size, built up front so the analysis can
+// switch sizes without allocating
+//
+// JUCE's fallback FFT engine holds a spin lock inside each FFT object for every transform, so channel
+// workers sharing one FFT would take turns rather than run in parallel. setNumSlots() gives each
+// WorkerPool slot its own FFT objects for every size.
+//
+class FFTPlans
+{
+public:
+    static constexpr int minOrder = 8;
+    static constexpr int maxOrder = 15;
+    static constexpr int numOrders = maxOrder - minOrder + 1;
+    static constexpr int maxSize = 1 << maxOrder;
+    static constexpr int defaultOrder = 10;
+
+    struct Plan
+    {
+        Plan(int order_);
+
+        int getSize() const
+        {
+            return fft.getSize();
+        }
+
+        //
+        // Transform two real channels with one complex FFT
+        //
+        // first and second hold getSize() windowed samples each; on return, the first getSize() / 2 + 1
+        // values of each are the magnitudes, same as performFrequencyOnlyForwardTransform with
+        // ignoreNegativeFreqs set. workspace needs room for 2 * getSize() values.
+        //
+        void performRealPairMagnitudeTransform(float* first, float* second, std::complex<float>* workspace, int slot = 0) const;
+
+        //
+        // Transform one real channel through the complex FFT with the imaginary part zeroed
+        //
+        // Same result as performFrequencyOnlyForwardTransform with ignoreNegativeFreqs set, but that
+        // allocates scratch space on every call for the larger sizes with JUCE's fallback FFT engine.
+        // data holds getSize() windowed samples; workspace needs room for 2 * getSize() values.
+        //
+        void performMagnitudeTransform(float* data, std::complex<float>* workspace, int slot = 0) const;
+
+        //
+        // FFT for a WorkerPool slot; slot 0 is fft
+        //
+        juce::dsp::FFT const& getFFT(int slot) const
+        {
+            return slot <= 0 ? fft : *slotFFTs[slot - 1];
+        }
+
+        int const order;
+        juce::dsp::FFT const fft;
+        juce::OwnedArray<juce::dsp::FFT> slotFFTs;
+        juce::HeapBlock<float> windowTable;
+        float const normalizationScale;
+
+        //
+        // Equivalent noise bandwidth of the window in bins; after scaling by normalizationScale, the squared
+        // magnitudes of all the bins add up to 2 * noiseBandwidthBins * the mean square of the input
+        //
+        float noiseBandwidthBins = 1.0f;
+    };
+
+    FFTPlans();
+
+    Plan const& getPlan(int order) const;
+
+    //
+    // Allocates; SpectrumAnalyser::prepare() calls this with WorkerPool::getNumSlots()
+    //
+    void setNumSlots(int numSlots);
+
+    //
+    // Choices for the FFT size parameter; choice index 0 is minOrder
+    //
+    static juce::StringArray getSizeNames();
+
+private:
+    juce::OwnedArray<Plan> plans;
+
+    JUCE_DECLARE_NON_COPYABLE(FFTPlans)
+};
+
+#if RUN_UNIT_TESTS
+
+class FFTPlansTest : public juce::UnitTest
+{
+public:
+    FFTPlansTest();
+
+    void runTest() override;
+};
+
+#endif
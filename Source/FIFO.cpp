@@ -0,0 +1,159 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "FIFO.h"
+
+#if RUN_UNIT_TESTS
+
+namespace
+{
+    struct TestItem
+    {
+        TestItem() = default;
+        TestItem(int value_, float scale_) :
+            value(value_),
+            scale(scale_)
+        {
+        }
+
+        int value = -1;
+        float scale = 0.0f;
+    };
+}
+
+FIFOTest::FIFOTest() : UnitTest("FIFOTest")
+{
+}
+
+template <typename FIFOType> void FIFOTest::runFIFOTest(FIFOType& fifo)
+{
+    int const ringSize = fifo.getRingSize();
+    expect(juce::isPowerOfTwo(ringSize));
+    expect(fifo.getNumItemsStored() == 0);
+    expect(fifo.getReadPointer() == nullptr);
+
+    int nextWriteValue = 0;
+    int nextReadValue = 0;
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        //
+        // Fill the ring completely, alternating between emplace and in-place writes
+        //
+        for (int index = 0; index < ringSize; ++index)
+        {
+            if (index & 1)
+            {
+                expect(fifo.emplace(nextWriteValue, 0.5f));
+            }
+            else
+            {
+                auto item = fifo.getWritePointer();
+                expect(item != nullptr);
+                if (item == nullptr)
+                {
+                    return;
+                }
+
+                *item = TestItem{ nextWriteValue, 0.5f };
+                fifo.advanceWritePosition();
+            }
+
+            ++nextWriteValue;
+        }
+
+        expect(fifo.getNumItemsStored() == ringSize);
+        expect(fifo.getWritePointer() == nullptr);
+        expect(!fifo.emplace(-1, 0.0f));
+
+        //
+        // Drain part of it, alternating between in-place reads and pop
+        //
+        for (int index = 0; index < ringSize / 2 + pass; ++index)
+        {
+            TestItem item;
+            if (index & 1)
+            {
+                expect(fifo.pop(item));
+            }
+            else
+            {
+                auto pointer = fifo.getReadPointer();
+                expect(pointer != nullptr);
+                if (pointer == nullptr)
+                {
+                    return;
+                }
+
+                item = *pointer;
+                fifo.advanceReadPosition();
+            }
+
+            expect(item.value == nextReadValue++);
+            expect(item.scale == 0.5f);
+        }
+
+        //
+        // Drain the rest
+        //
+        TestItem item;
+        while (fifo.pop(item))
+        {
+            expect(item.value == nextReadValue++);
+        }
+
+        expect(nextReadValue == nextWriteValue);
+        expect(fifo.getController().getNumOverrunItems() == (uint64_t)(pass + 1));
+    }
+}
+
+void FIFOTest::runTest()
+{
+    {
+        beginTest("FIFOTest compile-time ring size");
+
+        FIFO<TestItem, 16> fifo;
+        runFIFOTest(fifo);
+    }
+
+    {
+        beginTest("FIFOTest runtime ring size");
+
+        FIFO<TestItem> fifo;
+        fifo.setSize(12);
+        expect(fifo.getRingSize() == 16);
+        runFIFOTest(fifo);
+    }
+
+    {
+        beginTest("AlignedSlab");
+
+        AlignedSlab<float> slab;
+        slab.allocate(100);
+        expect(slab.size() == 100);
+        expect(((uintptr_t)slab.begin() % AlignedSlab<float>::alignment) == 0);
+        expect(slab[0] == 0.0f && slab[99] == 0.0f);
+    }
+}
+
+#endif
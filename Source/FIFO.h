@@ -0,0 +1,263 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include "FIFOController.h"
+
+//
+// Fixed number of items constructed in place in one cache-line aligned allocation
+//
+template <typename Type> class AlignedSlab
+{
+public:
+    static constexpr size_t alignment = juce::jmax((size_t)FIFOController::cacheLineSize, alignof(Type));
+
+    AlignedSlab() = default;
+    ~AlignedSlab()
+    {
+        free();
+    }
+
+    void allocate(int numItems_)
+    {
+        free();
+
+        data = static_cast<Type*>(::operator new(sizeof(Type) * (size_t)numItems_, std::align_val_t{ alignment }));
+        for (int index = 0; index < numItems_; ++index)
+        {
+            new (data + index) Type{};
+        }
+
+        numItems = numItems_;
+    }
+
+    void free()
+    {
+        if (data == nullptr)
+        {
+            return;
+        }
+
+        for (int index = 0; index < numItems; ++index)
+        {
+            data[index].~Type();
+        }
+
+        ::operator delete(data, std::align_val_t{ alignment });
+        data = nullptr;
+        numItems = 0;
+    }
+
+    int size() const
+    {
+        return numItems;
+    }
+
+    Type& operator[](size_t index)
+    {
+        return data[index];
+    }
+
+    Type const& operator[](size_t index) const
+    {
+        return data[index];
+    }
+
+    Type* begin() { return data; }
+    Type* end() { return data + numItems; }
+    Type const* begin() const { return data; }
+    Type const* end() const { return data + numItems; }
+
+private:
+    Type* data = nullptr;
+    int numItems = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(AlignedSlab)
+};
+
+//
+// Generic single-producer/single-consumer FIFO built on FIFOController
+//
+// Items live in one aligned slab and stay constructed for the lifetime of the FIFO, so the producer can
+// either fill the item from getWritePointer() in place or replace it with emplace().
+//
+// If compileTimeRingSize is non-zero it must be a power of two; the ring is allocated by the constructor
+// and the index mask is a compile-time constant. Otherwise call setSize() before use.
+//
+template <typename Type, int compileTimeRingSize = 0> class FIFO
+{
+public:
+    static_assert(compileTimeRingSize == 0 || juce::isPowerOfTwo(compileTimeRingSize), "Ring size must be a power of two");
+
+    FIFO()
+    {
+        if constexpr (compileTimeRingSize > 0)
+        {
+            setSize(compileTimeRingSize);
+        }
+    }
+
+    //
+    // Only call setSize and reset while neither the producer nor the consumer is running
+    //
+    void setSize(int numItems)
+    {
+        jassert(compileTimeRingSize == 0 || numItems == compileTimeRingSize);
+
+        slab.allocate(controller.setRingSize(numItems));
+        controller.reset(0);
+    }
+
+    void reset()
+    {
+        controller.reset(0);
+    }
+
+    int getRingSize() const
+    {
+        if constexpr (compileTimeRingSize > 0)
+        {
+            return compileTimeRingSize;
+        }
+        else
+        {
+            return controller.getRingSize();
+        }
+    }
+
+    int getNumItemsStored() const
+    {
+        return controller.getNumItemsStored();
+    }
+
+    template <typename Function> void forEachItem(Function&& function)
+    {
+        for (auto& item : slab)
+        {
+            function(item);
+        }
+    }
+
+    //
+    // Producer thread
+    //
+    Type* getWritePointer()
+    {
+        if (controller.isFull())
+        {
+            return nullptr;
+        }
+
+        return &slab[getIndex(controller.getWriteCount())];
+    }
+
+    void advanceWritePosition()
+    {
+        controller.advanceWritePosition(1);
+    }
+
+    template <typename... Args> bool emplace(Args&&... args)
+    {
+        auto item = getWritePointer();
+        if (item == nullptr)
+        {
+            controller.recordOverrun(1);
+            return false;
+        }
+
+        item->~Type();
+        new (item) Type{ std::forward<Args>(args)... };
+
+        advanceWritePosition();
+        return true;
+    }
+
+    //
+    // Consumer thread
+    //
+    Type const* getReadPointer() const
+    {
+        if (controller.isEmpty())
+        {
+            return nullptr;
+        }
+
+        return &slab[getIndex(controller.getReadCount())];
+    }
+
+    void advanceReadPosition()
+    {
+        controller.advanceReadPosition(1);
+    }
+
+    bool pop(Type& destination)
+    {
+        auto item = getReadPointer();
+        if (item == nullptr)
+        {
+            return false;
+        }
+
+        destination = *item;
+        advanceReadPosition();
+        return true;
+    }
+
+    FIFOController const& getController() const
+    {
+        return controller;
+    }
+
+private:
+    FIFOController controller;
+    AlignedSlab<Type> slab;
+
+    size_t getIndex(uint64_t count) const
+    {
+        if constexpr (compileTimeRingSize > 0)
+        {
+            return (size_t)(count & (uint64_t)(compileTimeRingSize - 1));
+        }
+        else
+        {
+            return (size_t)(count & (uint64_t)(controller.getRingSize() - 1));
+        }
+    }
+};
+
+#if RUN_UNIT_TESTS
+
+class FIFOTest : public juce::UnitTest
+{
+public:
+    FIFOTest();
+
+    void runTest() override;
+
+private:
+    template <typename FIFOType> void runFIFOTest(FIFOType& fifo);
+};
+
+#endif
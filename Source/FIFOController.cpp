@@ -37,13 +37,35 @@ int FIFOController::setRingSize(int numItems)
 
 void FIFOController::reset(int numStoredItems)
 {
-    readCount = 0;
-    writeCount = numStoredItems;
+    readCount.store(0, std::memory_order_release);
+    writeCount.store((uint64_t)numStoredItems, std::memory_order_release);
+    numUnderrunItems.store(0, std::memory_order_relaxed);
+    numOverrunItems.store(0, std::memory_order_relaxed);
 }
 
 int FIFOController::getNumItemsStored() const
 {
-    return (writeCount - readCount) & (ringSize - 1);
+    //
+    // Load the read count first; the write count can only grow in the meantime, so the result is never negative
+    //
+    auto read = readCount.load(std::memory_order_acquire);
+    auto written = writeCount.load(std::memory_order_acquire);
+    return (int)juce::jmin(written - read, (uint64_t)ringSize);
+}
+
+int FIFOController::getNumItemsFree() const
+{
+    return ringSize - getNumItemsStored();
+}
+
+bool FIFOController::isEmpty() const
+{
+    return getNumItemsStored() == 0;
+}
+
+bool FIFOController::isFull() const
+{
+    return getNumItemsStored() == ringSize;
 }
 
 FIFOController::Block FIFOController::getWriteBlock(int numItemsWanted)
@@ -70,12 +92,12 @@ FIFOController::Block FIFOController::getReadBlock(int numItemsWanted, int numIt
 
 int FIFOController::getReadPosition(int offset) const
 {
-    return (readCount + offset) & (ringSize - 1);
+    return (int)((readCount.load(std::memory_order_acquire) + (uint64_t)offset) & (uint64_t)(ringSize - 1));
 }
 
 int FIFOController::getWritePosition(int offset) const
 {
-    return (writeCount - offset) & (ringSize - 1);
+    return (int)((writeCount.load(std::memory_order_acquire) - (uint64_t)offset) & (uint64_t)(ringSize - 1));
 }
 
 int FIFOController::getSafeTransferCount(int numItemsWanted, int position) const
@@ -85,15 +107,182 @@ int FIFOController::getSafeTransferCount(int numItemsWanted, int position) const
 
 void FIFOController::advanceReadPosition(int count)
 {
-    readCount += count;
+    //
+    // Only the consumer thread modifies readCount, so a plain load + release store is enough
+    //
+    readCount.store(readCount.load(std::memory_order_relaxed) + (uint64_t)count, std::memory_order_release);
 }
 
 void FIFOController::advanceWritePosition(int count)
 {
-    writeCount += count;
+    //
+    // Only the producer thread modifies writeCount
+    //
+    writeCount.store(writeCount.load(std::memory_order_relaxed) + (uint64_t)count, std::memory_order_release);
 }
 
 void FIFOController::flush()
 {
-    readCount = writeCount;
+    readCount.store(writeCount.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+uint64_t FIFOController::getReadCount() const
+{
+    return readCount.load(std::memory_order_acquire);
+}
+
+uint64_t FIFOController::getWriteCount() const
+{
+    return writeCount.load(std::memory_order_acquire);
+}
+
+void FIFOController::recordOverrun(uint64_t numItemsDropped)
+{
+    numOverrunItems.fetch_add(numItemsDropped, std::memory_order_relaxed);
 }
+
+void FIFOController::recordUnderrun(uint64_t numItemsMissing)
+{
+    numUnderrunItems.fetch_add(numItemsMissing, std::memory_order_relaxed);
+}
+
+uint64_t FIFOController::getNumOverrunItems() const
+{
+    return numOverrunItems.load(std::memory_order_relaxed);
+}
+
+uint64_t FIFOController::getNumUnderrunItems() const
+{
+    return numUnderrunItems.load(std::memory_order_relaxed);
+}
+
+#if RUN_UNIT_TESTS
+
+FIFOControllerStressTest::FIFOControllerStressTest() : UnitTest("FIFOControllerStressTest")
+{
+}
+
+void FIFOControllerStressTest::runProducer(int numItemsToWrite)
+{
+    juce::Random producerRandom;
+    int nextValue = 0;
+
+    while (nextValue < numItemsToWrite)
+    {
+        int numItemsFree = controller.getNumItemsFree();
+        if (numItemsFree <= 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        int count = juce::jmin(numItemsToWrite - nextValue, 1 + producerRandom.nextInt(numItemsFree));
+        while (count > 0)
+        {
+            auto block = controller.getWriteBlock(count);
+            for (int index = 0; index < block.count; ++index)
+            {
+                ring[block.position + index] = nextValue++;
+            }
+
+            controller.advanceWritePosition(block.count);
+            count -= block.count;
+        }
+    }
+}
+
+void FIFOControllerStressTest::runConsumer(int numItemsToRead)
+{
+    juce::Random consumerRandom;
+    int expectedValue = 0;
+
+    while (expectedValue < numItemsToRead)
+    {
+        int numItemsStored = controller.getNumItemsStored();
+        if (numItemsStored <= 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        int count = 1 + consumerRandom.nextInt(numItemsStored);
+        int numItemsRead = 0;
+        while (numItemsRead < count)
+        {
+            auto block = controller.getReadBlock(count - numItemsRead, numItemsRead);
+            for (int index = 0; index < block.count; ++index)
+            {
+                if (ring[block.position + index] != expectedValue++)
+                {
+                    ++numErrors;
+                }
+            }
+
+            numItemsRead += block.count;
+        }
+
+        controller.advanceReadPosition(count);
+    }
+}
+
+void FIFOControllerStressTest::runFullEmptyTest()
+{
+    beginTest("FIFOController full/empty");
+
+    FIFOController fifo;
+    int ringSize = fifo.setRingSize(8);
+    fifo.reset(0);
+
+    expect(fifo.isEmpty() && !fifo.isFull());
+    expect(fifo.getNumItemsFree() == ringSize);
+
+    fifo.advanceWritePosition(ringSize);
+    expect(fifo.isFull() && !fifo.isEmpty());
+    expect(fifo.getNumItemsStored() == ringSize);
+    expect(fifo.getNumItemsFree() == 0);
+    expect(fifo.getWritePosition() == fifo.getReadPosition());
+
+    fifo.advanceReadPosition(ringSize - 1);
+    expect(fifo.getNumItemsStored() == 1);
+
+    fifo.flush();
+    expect(fifo.isEmpty());
+
+    fifo.recordOverrun(3);
+    fifo.recordUnderrun(5);
+    expect(fifo.getNumOverrunItems() == 3);
+    expect(fifo.getNumUnderrunItems() == 5);
+
+    fifo.reset(0);
+    expect(fifo.getNumOverrunItems() == 0 && fifo.getNumUnderrunItems() == 0);
+}
+
+void FIFOControllerStressTest::runTest()
+{
+    runFullEmptyTest();
+
+    beginTest("FIFOControllerStressTest");
+
+    int constexpr numItems = 1 << 24;
+    int ringSize = controller.setRingSize(4096);
+    ring.calloc(ringSize);
+    controller.reset(0);
+    numErrors = 0;
+
+    auto startTicks = juce::Time::getHighResolutionTicks();
+
+    std::thread producer{ [this]() { runProducer(numItems); } };
+    std::thread consumer{ [this]() { runConsumer(numItems); } };
+    producer.join();
+    consumer.join();
+
+    auto elapsedSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+    expect(numErrors == 0, juce::String{ numErrors.load() } + " out-of-sequence items");
+    expect(controller.getNumItemsStored() == 0);
+
+    logMessage(juce::String{ numItems } + " items in " + juce::String{ elapsedSeconds * 1000.0, 1 } + " ms: " +
+        juce::String{ (double)numItems / elapsedSeconds / 1.0e6, 1 } + " million items per second");
+}
+
+#endif
@@ -26,11 +26,30 @@ SOFTWARE.
 
 #include <JuceHeader.h>
 
+//
+// Single-producer/single-consumer ring controller
+//
+// The write counter is only modified by the producer thread and the read counter is only modified by the
+// consumer thread. Each side publishes its counter with release semantics and picks up the other side's
+// counter with acquire semantics, so anything written into the ring before advanceWritePosition is visible
+// to the consumer once it sees the new write count (and vice versa for the read count).
+//
+// The counters are 64-bit and never wrap in practice, so the number of stored items is just the difference
+// between them; a completely full ring is distinguishable from an empty one.
+//
+// The producer and consumer can report items they had to drop (overruns) or items they asked for that
+// weren't there (underruns); the totals are kept so the editor can display them.
+//
+// The counters live on separate cache lines so the producer and consumer don't keep stealing the same
+// line from each other.
+//
 class FIFOController
 {
 public:
     FIFOController();
 
+    static constexpr size_t cacheLineSize = 64;
+
     struct Block
     {
         int position;
@@ -44,6 +63,9 @@ public:
     }
     void reset(int numStoredItems);
     int getNumItemsStored() const;
+    int getNumItemsFree() const;
+    bool isEmpty() const;
+    bool isFull() const;
 
     Block getWriteBlock(int numItemsWanted);
     Block getReadBlock(int numItemsWanted, int numItemsAlreadyRead);
@@ -55,8 +77,39 @@ public:
     void advanceWritePosition(int count);
     void flush();
 
+    uint64_t getReadCount() const;
+    uint64_t getWriteCount() const;
+
+    void recordOverrun(uint64_t numItemsDropped);
+    void recordUnderrun(uint64_t numItemsMissing);
+    uint64_t getNumOverrunItems() const;
+    uint64_t getNumUnderrunItems() const;
+
 private:
-    int readCount = 0;
-    int writeCount = 0;
-    int ringSize = 0;
+    alignas(cacheLineSize) std::atomic<uint64_t> readCount = 0;
+    std::atomic<uint64_t> numUnderrunItems = 0;
+    alignas(cacheLineSize) std::atomic<uint64_t> writeCount = 0;
+    std::atomic<uint64_t> numOverrunItems = 0;
+    alignas(cacheLineSize) int ringSize = 0;
 };
+
+#if RUN_UNIT_TESTS
+
+class FIFOControllerStressTest : public juce::UnitTest
+{
+public:
+    FIFOControllerStressTest();
+
+    void runTest() override;
+    void runFullEmptyTest();
+
+private:
+    void runProducer(int numItemsToWrite);
+    void runConsumer(int numItemsToRead);
+
+    FIFOController controller;
+    juce::HeapBlock<int> ring;
+    std::atomic<int> numErrors = 0;
+};
+
+#endif
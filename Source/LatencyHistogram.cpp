@@ -0,0 +1,220 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "LatencyHistogram.h"
+
+int LatencyHistogram::getBucketIndex(double seconds)
+{
+    if (!(seconds > minSeconds))
+    {
+        return 0;
+    }
+
+    //
+    // Bucket b holds (minSeconds * 2^((b - 1) / bucketsPerOctave), minSeconds * 2^(b / bucketsPerOctave)]
+    //
+    auto const index = std::ceil(std::log2(seconds / minSeconds) * bucketsPerOctave);
+    return (int)juce::jlimit(0.0, (double)(numBuckets - 1), index);
+}
+
+double LatencyHistogram::getBucketUpperEdge(int bucket)
+{
+    return minSeconds * std::exp2((double)bucket / bucketsPerOctave);
+}
+
+void LatencyHistogram::record(double seconds)
+{
+    seconds = juce::jmax(0.0, seconds);
+    buckets[(size_t)getBucketIndex(seconds)].fetch_add(1, std::memory_order_relaxed);
+
+    auto const nanoseconds = (uint64_t)(seconds * 1.0e9);
+    totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    auto max = maxNanoseconds.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !maxNanoseconds.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+
+    numSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& bucket : buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    numSamples = 0;
+    totalNanoseconds = 0;
+    maxNanoseconds = 0;
+}
+
+double LatencyHistogram::getPercentile(double percent) const
+{
+    //
+    // Sum the buckets rather than trusting numSamples, since another thread may be partway through record()
+    //
+    uint64_t total = 0;
+    for (auto const& bucket : buckets)
+    {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+
+    if (total == 0)
+    {
+        return 0.0;
+    }
+
+    auto const target = juce::jlimit((uint64_t)1, total, (uint64_t)std::ceil(juce::jlimit(0.0, 100.0, percent) * 0.01 * (double)total));
+    uint64_t count = 0;
+    for (int bucket = 0; bucket < numBuckets; ++bucket)
+    {
+        count += getBucketCount(bucket);
+        if (count >= target)
+        {
+            return bucket == numBuckets - 1 ? getMaxSeconds() : juce::jmin(getBucketUpperEdge(bucket), getMaxSeconds());
+        }
+    }
+
+    return getMaxSeconds();
+}
+
+double LatencyHistogram::getMeanSeconds() const
+{
+    auto const count = getNumSamples();
+    return count > 0 ? (double)totalNanoseconds.load(std::memory_order_relaxed) * 1.0e-9 / (double)count : 0.0;
+}
+
+double LatencyHistogram::getMaxSeconds() const
+{
+    return (double)maxNanoseconds.load(std::memory_order_relaxed) * 1.0e-9;
+}
+
+#if RUN_UNIT_TESTS
+
+LatencyHistogramTest::LatencyHistogramTest() :
+    UnitTest("LatencyHistogramTest")
+{
+}
+
+void LatencyHistogramTest::runTest()
+{
+    {
+        beginTest("Buckets");
+
+        expectEquals(LatencyHistogram::getBucketIndex(-1.0), 0);
+        expectEquals(LatencyHistogram::getBucketIndex(0.0), 0);
+        expectEquals(LatencyHistogram::getBucketIndex(LatencyHistogram::minSeconds), 0);
+        expectEquals(LatencyHistogram::getBucketIndex(LatencyHistogram::minSeconds * 2.0), LatencyHistogram::bucketsPerOctave);
+        expectEquals(LatencyHistogram::getBucketIndex(LatencyHistogram::minSeconds * 2.01), LatencyHistogram::bucketsPerOctave + 1);
+        expectEquals(LatencyHistogram::getBucketIndex(1.0e6), LatencyHistogram::numBuckets - 1);
+
+        for (int bucket = 1; bucket < LatencyHistogram::numBuckets; ++bucket)
+        {
+            auto const upperEdge = LatencyHistogram::getBucketUpperEdge(bucket);
+            expectEquals(LatencyHistogram::getBucketIndex(upperEdge * 0.999), bucket);
+            expectEquals(LatencyHistogram::getBucketIndex(upperEdge * 1.001), juce::jmin(bucket + 1, LatencyHistogram::numBuckets - 1));
+        }
+    }
+
+    {
+        beginTest("Percentiles");
+
+        LatencyHistogram histogram;
+        expectEquals(histogram.getPercentile(50.0), 0.0);
+        expectEquals(histogram.getMeanSeconds(), 0.0);
+
+        //
+        // 1 ms to 100 ms in 1 ms steps
+        //
+        for (int milliseconds = 1; milliseconds <= 100; ++milliseconds)
+        {
+            histogram.record(milliseconds * 0.001);
+        }
+
+        expectEquals(histogram.getNumSamples(), (uint64_t)100);
+        expectWithinAbsoluteError(histogram.getMeanSeconds(), 0.0505, 1.0e-6);
+        expectWithinAbsoluteError(histogram.getMaxSeconds(), 0.1, 1.0e-6);
+
+        auto const bucketWidth = std::exp2(1.0 / LatencyHistogram::bucketsPerOctave);
+        for (auto percent : { 10.0, 50.0, 90.0, 99.0 })
+        {
+            auto const exact = percent * 0.001;
+            auto const estimate = histogram.getPercentile(percent);
+            expect(estimate >= exact && estimate <= exact * bucketWidth, juce::String{ percent } + "th percentile " + juce::String{ estimate });
+        }
+
+        expectWithinAbsoluteError(histogram.getPercentile(100.0), 0.1, 1.0e-6);
+
+        //
+        // Anything past the last bucket still counts towards the maximum
+        //
+        histogram.record(1.0e3);
+        expectEquals(histogram.getBucketCount(LatencyHistogram::numBuckets - 1), (uint64_t)1);
+        expectWithinAbsoluteError(histogram.getPercentile(100.0), 1.0e3, 1.0e-3);
+
+        histogram.reset();
+        expectEquals(histogram.getNumSamples(), (uint64_t)0);
+        expectEquals(histogram.getPercentile(50.0), 0.0);
+        expectEquals(histogram.getMaxSeconds(), 0.0);
+    }
+
+    {
+        beginTest("Concurrent recording");
+
+        LatencyHistogram histogram;
+        int constexpr numThreads = 4;
+        int constexpr numSamplesPerThread = 100000;
+
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < numThreads; ++thread)
+        {
+            threads.emplace_back([&histogram, thread]
+                {
+                    for (int index = 0; index < numSamplesPerThread; ++index)
+                    {
+                        histogram.record(0.001 * (thread + 1));
+                    }
+                });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        uint64_t total = 0;
+        for (int bucket = 0; bucket < LatencyHistogram::numBuckets; ++bucket)
+        {
+            total += histogram.getBucketCount(bucket);
+        }
+
+        expectEquals(histogram.getNumSamples(), (uint64_t)(numThreads * numSamplesPerThread));
+        expectEquals(total, histogram.getNumSamples());
+        expectWithinAbsoluteError(histogram.getMaxSeconds(), 0.001 * numThreads, 1.0e-6);
+        expectWithinAbsoluteError(histogram.getMeanSeconds(), 0.0025, 1.0e-6);
+    }
+}
+
+#endif
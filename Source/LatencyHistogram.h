@@ -0,0 +1,87 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Lock-free histogram of latencies with log-spaced buckets
+//
+// record() can be called from any number of threads at once and never blocks or allocates. Bucket 0 holds
+// everything up to minSeconds; each bucket after that is a quarter of an octave wide, so the percentiles
+// are within 19% of the exact values. The last bucket also holds anything longer than it.
+//
+class LatencyHistogram
+{
+public:
+    static constexpr double minSeconds = 10.0e-6;
+    static constexpr int bucketsPerOctave = 4;
+    static constexpr int numBuckets = 20 * bucketsPerOctave + 1;
+
+    void record(double seconds);
+
+    //
+    // Don't call while another thread is recording, or the counts may not add up
+    //
+    void reset();
+
+    uint64_t getNumSamples() const
+    {
+        return numSamples.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getBucketCount(int bucket) const
+    {
+        return buckets[(size_t)bucket].load(std::memory_order_relaxed);
+    }
+
+    static int getBucketIndex(double seconds);
+    static double getBucketUpperEdge(int bucket);
+
+    //
+    // Upper edge of the bucket holding the given percentile, capped at the longest latency recorded; zero
+    // if nothing has been recorded
+    //
+    double getPercentile(double percent) const;
+    double getMeanSeconds() const;
+    double getMaxSeconds() const;
+
+private:
+    std::array<std::atomic<uint64_t>, numBuckets> buckets{};
+    std::atomic<uint64_t> numSamples = 0;
+    std::atomic<uint64_t> totalNanoseconds = 0;
+    std::atomic<uint64_t> maxNanoseconds = 0;
+};
+
+#if RUN_UNIT_TESTS
+
+class LatencyHistogramTest : public juce::UnitTest
+{
+public:
+    LatencyHistogramTest();
+
+    void runTest() override;
+};
+
+#endif
@@ -0,0 +1,162 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "MirroredMemory.h"
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#elif JUCE_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MirroredMemory::~MirroredMemory()
+{
+    free();
+}
+
+size_t MirroredMemory::getGranularity()
+{
+#if JUCE_WINDOWS
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return (size_t)systemInfo.dwAllocationGranularity;
+#elif JUCE_LINUX
+    return (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 4096;
+#endif
+}
+
+bool MirroredMemory::allocate(size_t numBytes)
+{
+    free();
+
+    if (numBytes == 0 || (numBytes % getGranularity()) != 0)
+    {
+        jassertfalse;
+        return false;
+    }
+
+#if JUCE_WINDOWS
+    auto mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)numBytes >> 32), (DWORD)(numBytes & 0xffffffff), nullptr);
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+
+    //
+    // Find a free address range big enough for both views, release it, and then map both views into it.
+    // Another thread could grab the address range in between, so retry a few times.
+    //
+    for (int attempt = 0; attempt < 8 && data == nullptr; ++attempt)
+    {
+        auto address = (uint8_t*)VirtualAlloc(nullptr, numBytes * 2, MEM_RESERVE, PAGE_NOACCESS);
+        if (address == nullptr)
+        {
+            break;
+        }
+
+        VirtualFree(address, 0, MEM_RELEASE);
+
+        auto firstView = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, numBytes, address);
+        if (firstView == nullptr)
+        {
+            continue;
+        }
+
+        auto secondView = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, numBytes, address + numBytes);
+        if (secondView == nullptr)
+        {
+            UnmapViewOfFile(firstView);
+            continue;
+        }
+
+        data = firstView;
+    }
+
+    //
+    // The views keep the mapping alive
+    //
+    CloseHandle(mapping);
+
+#elif JUCE_LINUX
+    int fd = memfd_create("MirroredMemory", MFD_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    if (ftruncate(fd, (off_t)numBytes) == 0)
+    {
+        auto address = (uint8_t*)mmap(nullptr, numBytes * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (address != MAP_FAILED)
+        {
+            auto firstView = mmap(address, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+            auto secondView = mmap(address + numBytes, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+
+            if (firstView == address && secondView == address + numBytes)
+            {
+                data = address;
+            }
+            else
+            {
+                munmap(address, numBytes * 2);
+            }
+        }
+    }
+
+    //
+    // The mappings keep the memory alive
+    //
+    close(fd);
+#endif
+
+    if (data == nullptr)
+    {
+        return false;
+    }
+
+    size = numBytes;
+    return true;
+}
+
+void MirroredMemory::free()
+{
+    if (data == nullptr)
+    {
+        return;
+    }
+
+#if JUCE_WINDOWS
+    UnmapViewOfFile((uint8_t*)data + size);
+    UnmapViewOfFile(data);
+#elif JUCE_LINUX
+    munmap(data, size * 2);
+#endif
+
+    data = nullptr;
+    size = 0;
+}
@@ -0,0 +1,63 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Maps the same physical memory twice, back to back, so that reading or writing past the end of the
+// first mapping wraps around to the start. Any span up to getSize() bytes starting anywhere in the
+// first mapping is contiguous, so ring buffers built on top never have to split transfers.
+//
+// The size must be a multiple of getGranularity(). Only implemented for Windows and Linux; allocate()
+// returns false on other platforms or if the mapping fails.
+//
+class MirroredMemory
+{
+public:
+    MirroredMemory() = default;
+    ~MirroredMemory();
+
+    static size_t getGranularity();
+
+    bool allocate(size_t numBytes);
+    void free();
+
+    void* getData() const
+    {
+        return data;
+    }
+
+    size_t getSize() const
+    {
+        return size;
+    }
+
+private:
+    void* data = nullptr;
+    size_t size = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(MirroredMemory)
+};
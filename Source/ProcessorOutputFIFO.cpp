@@ -23,54 +23,519 @@ SOFTWARE.
 */
 
 #include "ProcessorOutputFIFO.h"
+#include "SpectrumKernels.h"
 
-void ProcessorOutputFIFO::setSize(int numItems, int numChannels, int fftSize)
+void ProcessorOutput::readSpectrum(int spectrumIndex, int channel, float* destination) const
 {
-    ringController.setRingSize(numItems);
+    if (transportFormat == TransportFormat::logMagnitude16)
+    {
+        auto const& compactSpectrum = compactSpectra[(size_t)spectrumIndex];
+        SpectrumKernels::decodeLogMagnitude16(compactSpectrum.getReadPointer(channel), destination, compactSpectrum.getNumBins());
+        return;
+    }
+
+    auto const spectra = const_cast<ProcessorOutput*>(this)->getSpectra();
+    auto const& source = *spectra[(size_t)spectrumIndex];
+    std::copy_n(source.getReadPointer(channel), source.getNumBins(), destination);
+}
+
+static size_t roundUpToCacheLine(size_t numBytes)
+{
+    return (numBytes + FIFOController::cacheLineSize - 1) / FIFOController::cacheLineSize * FIFOController::cacheLineSize;
+}
 
-    while (array.size() < ringController.getRingSize())
+void ProcessorOutputFIFO::BroadcastLayout::setSize(int numChannels_, int maxFFTSize_, TransportFormat transportFormat_)
+{
+    transportFormat = transportFormat_;
+    numChannels = numChannels_;
+    maxFFTSize = maxFFTSize_;
+    spectrumChannelStride = roundUpToCacheLine((size_t)RealSpectrum<float>::getNumFloatsPerChannel(maxFFTSize) * getBytesPerBin());
+    bandChannelStride = roundUpToCacheLine(BandMap::maxNumBands * sizeof(float));
+    bandsOffset = getSpectrumOffset(ProcessorOutput::numSpectra, 0);
+    numPayloadBytes = getBandsOffset(numBandBuffers, 0);
+}
+
+void ProcessorOutputFIFO::setSize(int numChannels, int maxFFTSize, int numBroadcastItems, TransportFormat transportFormat)
+{
+    //
+    // All the spectra for the triple buffer share one aligned slab; each channel starts on its own cache line
+    // so the audio thread and the message thread never share a line. The broadcast ring keeps its own copies
+    // in the slot payloads.
+    //
+    broadcastLayout.setSize(numChannels, maxFFTSize, transportFormat);
+    broadcastFIFO.setSize(numBroadcastItems, broadcastLayout.numPayloadBytes);
+
+    int const numEntries = (int)tripleBuffer.getBuffers().size();
+    int const numSpectra = numEntries * ProcessorOutput::numSpectra;
+    int const numBins = maxFFTSize / 2 + 1;
+    int const codesPerCacheLine = (int)(FIFOController::cacheLineSize / sizeof(uint16_t));
+    int const compactChannelStride = ((numBins + codesPerCacheLine - 1) / codesPerCacheLine) * codesPerCacheLine;
+
+    if (transportFormat == TransportFormat::float32)
     {
-        array.add(new ProcessorOutput);
+        int const floatsPerCacheLine = (int)(FIFOController::cacheLineSize / sizeof(float));
+        int const channelStride = ((RealSpectrum<float>::getNumFloatsPerChannel(maxFFTSize) + floatsPerCacheLine - 1) / floatsPerCacheLine) * floatsPerCacheLine;
+
+        spectrumStorage.allocate(numSpectra * numChannels * channelStride);
+        channelPointers.allocate((size_t)(numSpectra * numChannels), false);
+        for (int index = 0; index < numSpectra * numChannels; ++index)
+        {
+            channelPointers[index] = &spectrumStorage[(size_t)(index * channelStride)];
+        }
+
+        compactStorage.free();
+    }
+    else
+    {
+        compactStorage.allocate(numSpectra * numChannels * compactChannelStride);
+
+        spectrumStorage.free();
+        channelPointers.free();
     }
 
-    for (auto entry : array)
+    int spectrumIndex = 0;
+    auto setEntryStorage = [&](ProcessorOutput& entry)
     {
-        entry->spectrum = RealSpectrum<float>{}.withChannels(numChannels).withFFTSize(fftSize);
-        entry->averageSpectrum = RealSpectrum<float>{}.withChannels(numChannels).withFFTSize(fftSize);
+        entry.transportFormat = transportFormat;
+        auto spectra = entry.getSpectra();
+
+        for (size_t index = 0; index < spectra.size(); ++index)
+        {
+            if (transportFormat == TransportFormat::float32)
+            {
+                spectra[index]->withStorage(channelPointers + spectrumIndex * numChannels, numChannels, maxFFTSize);
+                spectra[index]->clear();
+                entry.compactSpectra[index] = CompactSpectrum{};
+            }
+            else
+            {
+                *spectra[index] = RealSpectrum<float>{};
+                entry.compactSpectra[index].setStorage(&compactStorage[(size_t)(spectrumIndex * numChannels * compactChannelStride)], numChannels, compactChannelStride);
+                entry.compactSpectra[index].setFFTSize(maxFFTSize);
+                std::fill_n(entry.compactSpectra[index].getWritePointer(0), numChannels * compactChannelStride, (uint16_t)0);
+            }
+
+            ++spectrumIndex;
+        }
+
+        entry.fftSize = maxFFTSize;
+
+        for (auto* bands : { &entry.bands, &entry.averageBands })
+        {
+            bands->setSize(numChannels, BandMap::maxNumBands);
+            bands->clear();
+        }
+    };
+
+    for (auto& entry : tripleBuffer.getBuffers())
+    {
+        setEntryStorage(entry);
     }
 }
 
 void ProcessorOutputFIFO::reset()
 {
-    ringController.reset(0);
-    for (auto entry: array)
+    tripleBuffer.reset();
+    writeSequenceNumber = 0;
+    for (auto& entry : tripleBuffer.getBuffers())
+    {
+        for (auto* spectrum : entry.getSpectra())
+        {
+            spectrum->clear();
+        }
+
+        for (auto& compactSpectrum : entry.compactSpectra)
+        {
+            for (int channel = 0; channel < compactSpectrum.getNumChannels(); ++channel)
+            {
+                std::fill_n(compactSpectrum.getWritePointer(channel), compactSpectrum.getNumBins(), (uint16_t)0);
+            }
+        }
+
+        entry.bands.clear();
+        entry.averageBands.clear();
+        entry.features.fill({});
+        entry.sequenceNumber = 0;
+        entry.lastSamplePosition = -1;
+        entry.blockArrivalTicks = 0;
+        entry.publishTicks = 0;
+        entry.firstPaintTicks = 0;
+    }
+
+    broadcastFIFO.reset();
+    latencies.reset();
+}
+
+static void setOutputFFTSize(ProcessorOutput& output, int fftSize)
+{
+    if (output.fftSize != fftSize)
     {
-        entry->spectrum.clear();
-        entry->averageSpectrum.clear();
+        if (output.transportFormat == TransportFormat::float32)
+        {
+            for (auto* spectrum : output.getSpectra())
+            {
+                spectrum->withStorageFFTSize(fftSize);
+            }
+        }
+        else
+        {
+            for (auto& compactSpectrum : output.compactSpectra)
+            {
+                compactSpectrum.setFFTSize(fftSize);
+            }
+        }
+
+        output.fftSize = fftSize;
     }
 }
 
-ProcessorOutput* const ProcessorOutputFIFO::getWritePointer() const
+ProcessorOutput* ProcessorOutputFIFO::getWritePointer(int fftSize)
 {
-    return array[ringController.getWritePosition()];    
+    auto& output = tripleBuffer.getWriteBuffer();
+    setOutputFFTSize(output, fftSize);
+    return &output;
 }
 
-ProcessorOutput const* const ProcessorOutputFIFO::getMostRecent() const
+ProcessorOutput const* ProcessorOutputFIFO::getMostRecent()
 {
-    return array[ringController.getWritePosition(-1)];
+    auto const& output = tripleBuffer.read();
+    if (output.sequenceNumber == 0)
+    {
+        return nullptr;
+    }
+
+    return &output;
 }
 
 void ProcessorOutputFIFO::advanceWritePosition()
 {
-    ringController.advanceWritePosition(1);
+    auto& output = tripleBuffer.getWriteBuffer();
+    output.sequenceNumber = ++writeSequenceNumber;
+    output.publishTicks = juce::Time::getHighResolutionTicks();
+    output.firstPaintTicks = 0;
+
+    if (output.blockArrivalTicks != 0)
+    {
+        latencies.arrivalToPublish.record(juce::Time::highResolutionTicksToSeconds(output.publishTicks - output.blockArrivalTicks));
+    }
+
+    if (broadcastFIFO.hasReaders())
+    {
+        auto& header = broadcastFIFO.getWriteItem();
+        auto* payload = broadcastFIFO.getWritePayload();
+
+        header.sequenceNumber = output.sequenceNumber;
+        header.fftSize = output.fftSize;
+        header.hertzPerBin = output.hertzPerBin;
+        header.lastSamplePosition = output.lastSamplePosition;
+        header.blockArrivalTicks = output.blockArrivalTicks;
+        header.publishTicks = output.publishTicks;
+        header.numBands = juce::jmin(output.getNumBands(), BandMap::maxNumBands);
+        std::copy_n(output.bandCentreFrequencies.begin(), header.numBands, header.bandCentreFrequencies.begin());
+        header.numFeatureChannels = output.numFeatureChannels;
+        std::copy_n(output.features.begin(), output.numFeatureChannels, header.features.begin());
+
+        auto const numBytesPerChannel = (size_t)output.getNumBins() * broadcastLayout.getBytesPerBin();
+        auto const outputSpectra = output.getSpectra();
+        for (int spectrumIndex = 0; spectrumIndex < ProcessorOutput::numSpectra; ++spectrumIndex)
+        {
+            for (int channel = 0; channel < broadcastLayout.numChannels; ++channel)
+            {
+                void const* source = output.transportFormat == TransportFormat::float32 ?
+                    (void const*)outputSpectra[(size_t)spectrumIndex]->getReadPointer(channel) :
+                    (void const*)output.compactSpectra[(size_t)spectrumIndex].getReadPointer(channel);
+                std::memcpy(payload + broadcastLayout.getSpectrumOffset(spectrumIndex, channel), source, numBytesPerChannel);
+            }
+        }
+
+        int bandBufferIndex = 0;
+        for (auto const* bands : { &output.bands, &output.averageBands })
+        {
+            for (int channel = 0; channel < juce::jmin(bands->getNumChannels(), broadcastLayout.numChannels); ++channel)
+            {
+                std::memcpy(payload + broadcastLayout.getBandsOffset(bandBufferIndex, channel), bands->getReadPointer(channel), (size_t)header.numBands * sizeof(float));
+            }
+
+            ++bandBufferIndex;
+        }
+
+        broadcastFIFO.publish();
+    }
+
+    tripleBuffer.publish();
+}
+
+void ProcessorOutputFIFO::notePainted()
+{
+    //
+    // Only the first paint of each output counts; a display repainting the same output again isn't any
+    // later getting it to the screen
+    //
+    auto& output = tripleBuffer.getReadBuffer();
+    if (output.sequenceNumber == 0 || output.firstPaintTicks != 0)
+    {
+        return;
+    }
+
+    output.firstPaintTicks = juce::Time::getHighResolutionTicks();
+    latencies.publishToPaint.record(juce::Time::highResolutionTicksToSeconds(output.firstPaintTicks - output.publishTicks));
+
+    if (output.blockArrivalTicks != 0)
+    {
+        latencies.arrivalToPaint.record(juce::Time::highResolutionTicksToSeconds(output.firstPaintTicks - output.blockArrivalTicks));
+    }
+}
+
+std::unique_ptr<ProcessorOutputFIFO::Reader> ProcessorOutputFIFO::createReader()
+{
+    return std::unique_ptr<Reader>{ new Reader{ *this } };
+}
+
+ProcessorOutputFIFO::Reader::Reader(ProcessorOutputFIFO& owner) :
+    broadcastReader(owner.broadcastFIFO.createReader()),
+    layout(owner.broadcastLayout)
+{
+    payload.allocate((int)layout.numPayloadBytes);
+
+    if (layout.transportFormat == TransportFormat::float32)
+    {
+        spectrumChannelPointers.allocate((size_t)(ProcessorOutput::numSpectra * layout.numChannels), false);
+        for (int spectrumIndex = 0; spectrumIndex < ProcessorOutput::numSpectra; ++spectrumIndex)
+        {
+            for (int channel = 0; channel < layout.numChannels; ++channel)
+            {
+                spectrumChannelPointers[spectrumIndex * layout.numChannels + channel] = reinterpret_cast<float*>(&payload[layout.getSpectrumOffset(spectrumIndex, channel)]);
+            }
+        }
+    }
+
+    bandChannelPointers.allocate((size_t)(BroadcastLayout::numBandBuffers * layout.numChannels), false);
+    for (int bandBufferIndex = 0; bandBufferIndex < BroadcastLayout::numBandBuffers; ++bandBufferIndex)
+    {
+        for (int channel = 0; channel < layout.numChannels; ++channel)
+        {
+            bandChannelPointers[bandBufferIndex * layout.numChannels + channel] = reinterpret_cast<float*>(&payload[layout.getBandsOffset(bandBufferIndex, channel)]);
+        }
+    }
+}
+
+bool ProcessorOutputFIFO::Reader::read(ProcessorOutput& destination)
+{
+    //
+    // The header may be torn until the broadcast reader has checked the stamp, so the copy clamps the sizes
+    // it takes from it; nothing refers to the copy until the read succeeds
+    //
+    auto copyPayload = [this](BroadcastHeader const& copiedHeader, std::byte const* source)
+    {
+        int const maxNumBins = layout.maxFFTSize / 2 + 1;
+        auto const numBytesPerChannel = (size_t)juce::jlimit(0, maxNumBins, copiedHeader.fftSize / 2 + 1) * layout.getBytesPerBin();
+        for (int spectrumIndex = 0; spectrumIndex < ProcessorOutput::numSpectra; ++spectrumIndex)
+        {
+            for (int channel = 0; channel < layout.numChannels; ++channel)
+            {
+                auto const offset = layout.getSpectrumOffset(spectrumIndex, channel);
+                std::memcpy(&payload[offset], source + offset, numBytesPerChannel);
+            }
+        }
+
+        auto const numBandBytes = (size_t)juce::jlimit(0, BandMap::maxNumBands, copiedHeader.numBands) * sizeof(float);
+        for (int bandBufferIndex = 0; bandBufferIndex < BroadcastLayout::numBandBuffers; ++bandBufferIndex)
+        {
+            for (int channel = 0; channel < layout.numChannels; ++channel)
+            {
+                auto const offset = layout.getBandsOffset(bandBufferIndex, channel);
+                std::memcpy(&payload[offset], source + offset, numBandBytes);
+            }
+        }
+    };
+
+    if (!broadcastReader->read(header, copyPayload))
+    {
+        return false;
+    }
+
+    destination.transportFormat = layout.transportFormat;
+    auto spectra = destination.getSpectra();
+    for (int spectrumIndex = 0; spectrumIndex < ProcessorOutput::numSpectra; ++spectrumIndex)
+    {
+        auto& spectrum = *spectra[(size_t)spectrumIndex];
+        auto& compactSpectrum = destination.compactSpectra[(size_t)spectrumIndex];
+
+        if (layout.transportFormat == TransportFormat::float32)
+        {
+            spectrum.withStorage(spectrumChannelPointers + spectrumIndex * layout.numChannels, layout.numChannels, header.fftSize);
+            if (compactSpectrum.getNumChannels() != 0)
+            {
+                compactSpectrum = CompactSpectrum{};
+            }
+        }
+        else
+        {
+            if (spectrum.getNumChannels() != 0)
+            {
+                spectrum = RealSpectrum<float>{};
+            }
+
+            auto const channelStride = (int)(layout.spectrumChannelStride / sizeof(uint16_t));
+            compactSpectrum.setStorage(reinterpret_cast<uint16_t*>(&payload[layout.getSpectrumOffset(spectrumIndex, 0)]), layout.numChannels, channelStride);
+            compactSpectrum.setFFTSize(header.fftSize);
+        }
+    }
+
+    destination.bands.setDataToReferTo(bandChannelPointers, layout.numChannels, header.numBands);
+    destination.averageBands.setDataToReferTo(bandChannelPointers + layout.numChannels, layout.numChannels, header.numBands);
+    std::copy_n(header.bandCentreFrequencies.begin(), header.numBands, destination.bandCentreFrequencies.begin());
+    std::copy_n(header.features.begin(), header.numFeatureChannels, destination.features.begin());
+    destination.numFeatureChannels = header.numFeatureChannels;
+
+    destination.sequenceNumber = header.sequenceNumber;
+    destination.fftSize = header.fftSize;
+    destination.hertzPerBin = header.hertzPerBin;
+    destination.lastSamplePosition = header.lastSamplePosition;
+    destination.blockArrivalTicks = header.blockArrivalTicks;
+    destination.publishTicks = header.publishTicks;
+    destination.firstPaintTicks = 0;
+    return true;
 }
 
-void ProcessorOutputFIFO::advanceReadPosition()
+#if RUN_UNIT_TESTS
+
+ProcessorOutputFIFOTest::ProcessorOutputFIFOTest() : UnitTest("ProcessorOutputFIFOTest")
 {
-    ringController.flush();
 }
 
-int ProcessorOutputFIFO::getNumItemsStored() const
+void ProcessorOutputFIFOTest::runTest()
 {
-    return ringController.getNumItemsStored();
+    int constexpr numChannels = 2;
+    int constexpr maxFFTSize = 1024;
+    int constexpr numBands = 10;
+
+    auto getBinValue = [](int spectrumIndex, int channel, int bin, int fftSize)
+    {
+        return (float)(fftSize + spectrumIndex * 100 + channel * 10) + (float)bin * 0.5f;
+    };
+
+    auto getBandValue = [](int bandBufferIndex, int channel, int band)
+    {
+        return (float)(bandBufferIndex * 100 + channel * 10 + band);
+    };
+
+    for (auto transportFormat : { TransportFormat::float32, TransportFormat::logMagnitude16 })
+    {
+        beginTest(transportFormat == TransportFormat::float32 ? "Readers get float32 outputs" : "Readers get logMagnitude16 outputs");
+
+        ProcessorOutputFIFO fifo;
+        fifo.setSize(numChannels, maxFFTSize, 4, transportFormat);
+        auto reader = fifo.createReader();
+
+        ProcessorOutput readerOutput;
+        expect(!reader->read(readerOutput));
+
+        //
+        // Switch the FFT size between outputs; the reader has to follow without reallocating anything
+        //
+        for (int fftSize : { maxFFTSize, maxFFTSize / 4, maxFFTSize / 2 })
+        {
+            auto* output = fifo.getWritePointer(fftSize);
+            auto outputSpectra = output->getSpectra();
+            for (int spectrumIndex = 0; spectrumIndex < ProcessorOutput::numSpectra; ++spectrumIndex)
+            {
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    for (int bin = 0; bin < fftSize / 2 + 1; ++bin)
+                    {
+                        auto const value = getBinValue(spectrumIndex, channel, bin, fftSize);
+                        if (transportFormat == TransportFormat::float32)
+                        {
+                            outputSpectra[(size_t)spectrumIndex]->setBinValue(channel, bin, value);
+                        }
+                        else
+                        {
+                            output->compactSpectra[(size_t)spectrumIndex].getWritePointer(channel)[bin] = (uint16_t)value;
+                        }
+                    }
+                }
+            }
+
+            int bandBufferIndex = 0;
+            for (auto* bands : { &output->bands, &output->averageBands })
+            {
+                bands->setSize(numChannels, numBands, false, false, true /* avoidReallocating */);
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    for (int band = 0; band < numBands; ++band)
+                    {
+                        bands->setSample(channel, band, getBandValue(bandBufferIndex, channel, band));
+                    }
+                }
+
+                ++bandBufferIndex;
+            }
+
+            for (int band = 0; band < numBands; ++band)
+            {
+                output->bandCentreFrequencies[(size_t)band] = (float)(band + 1) * 1000.0f;
+            }
+
+            output->hertzPerBin = 48000.0 / fftSize;
+            output->numFeatureChannels = numChannels;
+            output->features[1].rms = (float)fftSize;
+            output->lastSamplePosition = fftSize;
+            fifo.advanceWritePosition();
+
+            expect(reader->read(readerOutput));
+            expect(!reader->read(readerOutput));
+
+            expectEquals(readerOutput.fftSize, fftSize);
+            expectEquals(readerOutput.getNumSpectrumChannels(), numChannels);
+            expectEquals(readerOutput.getNumBins(), fftSize / 2 + 1);
+            expectEquals(readerOutput.hertzPerBin, 48000.0 / fftSize);
+            expectEquals(readerOutput.numFeatureChannels, numChannels);
+            expectEquals(readerOutput.features[1].rms, (float)fftSize);
+            expectEquals(readerOutput.lastSamplePosition, (int64_t)fftSize);
+
+            int numWrongBins = 0;
+            auto readerSpectra = readerOutput.getSpectra();
+            for (int spectrumIndex = 0; spectrumIndex < ProcessorOutput::numSpectra; ++spectrumIndex)
+            {
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    for (int bin = 0; bin < fftSize / 2 + 1; ++bin)
+                    {
+                        auto const value = getBinValue(spectrumIndex, channel, bin, fftSize);
+                        bool const wrong = transportFormat == TransportFormat::float32 ?
+                            readerSpectra[(size_t)spectrumIndex]->getBinValue(channel, bin) != value :
+                            readerOutput.compactSpectra[(size_t)spectrumIndex].getReadPointer(channel)[bin] != (uint16_t)value;
+                        numWrongBins += wrong ? 1 : 0;
+                    }
+                }
+            }
+
+            expectEquals(numWrongBins, 0);
+
+            expectEquals(readerOutput.getNumBands(), numBands);
+            expectEquals(readerOutput.bands.getNumChannels(), numChannels);
+            int numWrongBands = 0;
+            bandBufferIndex = 0;
+            for (auto const* bands : { &readerOutput.bands, &readerOutput.averageBands })
+            {
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    for (int band = 0; band < numBands; ++band)
+                    {
+                        numWrongBands += bands->getSample(channel, band) != getBandValue(bandBufferIndex, channel, band) ? 1 : 0;
+                    }
+                }
+
+                ++bandBufferIndex;
+            }
+
+            expectEquals(numWrongBands, 0);
+            expectEquals(readerOutput.bandCentreFrequencies[(size_t)numBands - 1], (float)numBands * 1000.0f);
+        }
+
+        expectEquals((int)reader->getNumOverruns(), 0);
+    }
 }
+
+#endif
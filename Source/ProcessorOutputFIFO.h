@@ -24,28 +24,320 @@ SOFTWARE.
 
 #pragma once
 
-#include "FIFOController.h"
+#include "TripleBuffer.h"
+#include "BroadcastFIFO.h"
 #include "Spectrum.h"
+#include "BandMap.h"
+#include "LatencyHistogram.h"
+
+//
+// float32 publishes the spectra as floats
+//
+// logMagnitude16 publishes them as 16-bit log-magnitude codes, half the size of the floats and within
+// 0.0043 dB of them; see SpectrumKernels::encodeLogMagnitude16
+//
+enum class TransportFormat
+{
+    float32,
+    logMagnitude16
+};
+
+//
+// Scalars worked out for each channel once per hop, so displays don't need to scan the bins
+//
+struct SpectrumFeatures
+{
+    //
+    // Fixed bands for bandLevels; bass, low mids, high mids, and treble
+    //
+    static constexpr int numBands = 4;
+    static constexpr std::array<float, numBands + 1> bandEdges{ 50.0f, 200.0f, 2000.0f, 8000.0f, 20000.0f };
+
+    //
+    // Levels of the average spectrum in each band, on the same scale as the BandMap band levels
+    //
+    std::array<float, numBands> bandLevels{};
+
+    //
+    // RMS of the analysed input, from the energy of the spectrum
+    //
+    float rms = 0.0f;
+
+    //
+    // Magnitude-weighted mean frequency of the spectrum; zero for silence
+    //
+    float centroidHertz = 0.0f;
+
+    //
+    // Sum of the increases in bin magnitude since the previous spectrum
+    //
+    float flux = 0.0f;
+
+    //
+    // Set when the flux jumps well above its recent average
+    //
+    bool onset = false;
+};
 
 struct ProcessorOutput
 {
     RealSpectrum<float> spectrum;
     RealSpectrum<float> averageSpectrum;
+
+    //
+    // Fast and slow averages, peak hold with decay, minimum hold, and the attack/release envelope; all
+    // computed in the same pass as averageSpectrum (see SpectrumKernels::normaliseAndApplyBallistics)
+    //
+    RealSpectrum<float> fastSpectrum;
+    RealSpectrum<float> slowSpectrum;
+    RealSpectrum<float> peakSpectrum;
+    RealSpectrum<float> minimumSpectrum;
+    RealSpectrum<float> envelopeSpectrum;
+
+    uint64_t sequenceNumber = 0;
+    int fftSize = 0;
+    double hertzPerBin = 0.0;
+
+    //
+    // Position of the last input sample in this output, counting the samples written to the input FIFO
+    // since prepare at the input sample rate; -1 until the first output
+    //
+    int64_t lastSamplePosition = -1;
+
+    //
+    // juce::Time::getHighResolutionTicks() when the host block holding the last input sample arrived (zero if
+    // unknown), when this output was published, and when it was first painted (zero until then)
+    //
+    int64_t blockArrivalTicks = 0;
+    int64_t publishTicks = 0;
+    int64_t firstPaintTicks = 0;
+
+    //
+    // Log-frequency bands; one sample per band
+    //
+    juce::AudioBuffer<float> bands;
+    juce::AudioBuffer<float> averageBands;
+    std::array<float, BandMap::maxNumBands> bandCentreFrequencies{};
+
+    int getNumBands() const
+    {
+        return averageBands.getNumSamples();
+    }
+
+    //
+    // One SpectrumFeatures for each analysed channel
+    //
+    static constexpr int maxNumFeatureChannels = 16;
+    std::array<SpectrumFeatures, maxNumFeatureChannels> features{};
+    int numFeatureChannels = 0;
+
+    static constexpr int numSpectra = 7;
+
+    std::array<RealSpectrum<float>*, numSpectra> getSpectra()
+    {
+        return { &spectrum, &averageSpectrum, &fastSpectrum, &slowSpectrum, &peakSpectrum, &minimumSpectrum, &envelopeSpectrum };
+    }
+
+    //
+    // With TransportFormat::logMagnitude16, the spectra are published here instead, in the same order as
+    // getSpectra(), and the float spectra have no channels. The bands are always floats.
+    //
+    TransportFormat transportFormat = TransportFormat::float32;
+    std::array<CompactSpectrum, numSpectra> compactSpectra;
+
+    int getNumSpectrumChannels() const
+    {
+        return transportFormat == TransportFormat::float32 ? spectrum.getNumChannels() : compactSpectra[0].getNumChannels();
+    }
+
+    int getNumBins() const
+    {
+        return transportFormat == TransportFormat::float32 ? spectrum.getNumBins() : compactSpectra[0].getNumBins();
+    }
+
+    //
+    // Copies or decodes one channel of one of the spectra, numbered in getSpectra() order, whatever the
+    // transport format; destination needs room for getNumBins() floats
+    //
+    void readSpectrum(int spectrumIndex, int channel, float* destination) const;
 };
 
+//
+// Publishes the most recent ProcessorOutput from the analysis thread to the message thread
+//
+// The analysis fills getWritePointer() and calls advanceWritePosition(); that's the analysis thread in
+// AnalysisMode::workerThread and the audio thread in AnalysisMode::audioThread. setSize() allocates room
+// for the largest FFT size; getWritePointer() switches the output to a smaller FFT size without
+// allocating.
+//
+// The triple buffer has a single consumer, so getMostRecent() and notePainted() must only be called from
+// the message thread. The editor and every ChildWindow::Inner call it, and SpectrumRingDisplay paints the
+// output it returns; that's only safe because they all paint on the message thread. The returned output
+// can't be overwritten until the next call to getMostRecent(), from any of them. getMostRecent() returns
+// nullptr until the first output is published; compare ProcessorOutput::sequenceNumber with the last
+// value you saw to find out if the output is new.
+//
+// setSize() also picks the TransportFormat for the spectra; with logMagnitude16 the slab only holds the
+// 16-bit codes, so the outputs take half the memory and the broadcast copies move half as many bytes.
+//
+// Consumers that need to see every output (recorders, exporters, additional displays on other threads) can
+// call createReader() instead; each reader gets its own cursor and overrun count. Outputs are only copied
+// into the broadcast ring while at least one reader exists. Readers copy out of the ring while the analysis
+// may be overwriting it, so the ring doesn't hold ProcessorOutputs; each slot is a plain BroadcastHeader
+// with the scalars and features, plus a payload with the spectra and bands at fixed offsets (see
+// BroadcastLayout). The reader copies both out, checks the slot wasn't overwritten, and only then points
+// the ProcessorOutput it returns at its own copy.
+//
+// advanceWritePosition() stamps each output with its publish time; call notePainted() from the message
+// thread after painting the output from getMostRecent() to stamp the first paint. Both feed the latency
+// histograms.
+//
 class ProcessorOutputFIFO
 {
 public:
-    void setSize(int numItems, int numChannels, int fftSize);
+    class Reader;
+
+    void setSize(int numChannels, int maxFFTSize, int numBroadcastItems = 32, TransportFormat transportFormat = TransportFormat::float32);
     void reset();
-    ProcessorOutput* const getWritePointer() const;
-    ProcessorOutput const * const getMostRecent() const;
+    ProcessorOutput* getWritePointer(int fftSize);
+    ProcessorOutput const* getMostRecent();
     void advanceWritePosition();
-    void advanceReadPosition();
+    void notePainted();
+
+    //
+    // Readers are laid out for the current setSize(); create them after calling it
+    //
+    std::unique_ptr<Reader> createReader();
+
+    //
+    // Block arrival to published spectrum, published spectrum to first paint, and block arrival to first
+    // paint; outputs without a block arrival time are only counted in publishToPaint
+    //
+    struct Latencies
+    {
+        LatencyHistogram arrivalToPublish;
+        LatencyHistogram publishToPaint;
+        LatencyHistogram arrivalToPaint;
 
-    int getNumItemsStored() const;
+        void reset()
+        {
+            arrivalToPublish.reset();
+            publishToPaint.reset();
+            arrivalToPaint.reset();
+        }
+    } latencies;
 
 private:
-    FIFOController ringController;
-    juce::OwnedArray<ProcessorOutput> array;
+    //
+    // Everything in a ProcessorOutput apart from the spectra and bands; trivially copyable, so readers can
+    // copy it while the analysis is overwriting it
+    //
+    struct BroadcastHeader
+    {
+        uint64_t sequenceNumber = 0;
+        int fftSize = 0;
+        double hertzPerBin = 0.0;
+        int64_t lastSamplePosition = -1;
+        int64_t blockArrivalTicks = 0;
+        int64_t publishTicks = 0;
+        int numBands = 0;
+        std::array<float, BandMap::maxNumBands> bandCentreFrequencies{};
+        std::array<SpectrumFeatures, ProcessorOutput::maxNumFeatureChannels> features{};
+        int numFeatureChannels = 0;
+    };
+
+    //
+    // Where each channel of each spectrum and band buffer lives in a broadcast payload; every channel gets
+    // room for the largest FFT size or every band, starting on its own cache line
+    //
+    struct BroadcastLayout
+    {
+        static constexpr int numBandBuffers = 2;
+
+        TransportFormat transportFormat = TransportFormat::float32;
+        int numChannels = 0;
+        int maxFFTSize = 0;
+        size_t spectrumChannelStride = 0;
+        size_t bandChannelStride = 0;
+        size_t bandsOffset = 0;
+        size_t numPayloadBytes = 0;
+
+        void setSize(int numChannels_, int maxFFTSize_, TransportFormat transportFormat_);
+
+        size_t getBytesPerBin() const
+        {
+            return transportFormat == TransportFormat::float32 ? sizeof(float) : sizeof(uint16_t);
+        }
+
+        size_t getSpectrumOffset(int spectrumIndex, int channel) const
+        {
+            return (size_t)(spectrumIndex * numChannels + channel) * spectrumChannelStride;
+        }
+
+        size_t getBandsOffset(int bandBufferIndex, int channel) const
+        {
+            return bandsOffset + (size_t)(bandBufferIndex * numChannels + channel) * bandChannelStride;
+        }
+    };
+
+    TripleBuffer<ProcessorOutput> tripleBuffer;
+    BroadcastFIFO<BroadcastHeader> broadcastFIFO;
+    BroadcastLayout broadcastLayout;
+    uint64_t writeSequenceNumber = 0;
+
+    AlignedSlab<float> spectrumStorage;
+    juce::HeapBlock<float*> channelPointers;
+    AlignedSlab<uint16_t> compactStorage;
+};
+
+//
+// Receives every output from a ProcessorOutputFIFO (see ProcessorOutputFIFO::createReader)
+//
+// read() leaves the ProcessorOutput referring to this reader's copy of the spectra and bands, so it's only
+// valid until the next call to read(); use makeCopyOf or copyFrom to keep it longer. With
+// TransportFormat::logMagnitude16 the compact spectra refer to the copy and the float spectra are empty.
+//
+class ProcessorOutputFIFO::Reader
+{
+public:
+    //
+    // Returns false if there's nothing new
+    //
+    bool read(ProcessorOutput& destination);
+
+    uint64_t getNumItemsReady() const
+    {
+        return broadcastReader->getNumItemsReady();
+    }
+
+    uint64_t getNumOverruns() const
+    {
+        return broadcastReader->getNumOverruns();
+    }
+
+private:
+    friend class ProcessorOutputFIFO;
+
+    Reader(ProcessorOutputFIFO& owner);
+
+    std::unique_ptr<BroadcastFIFO<BroadcastHeader>::Reader> broadcastReader;
+    BroadcastLayout const layout;
+    BroadcastHeader header;
+    AlignedSlab<std::byte> payload;
+    juce::HeapBlock<float*> spectrumChannelPointers;
+    juce::HeapBlock<float*> bandChannelPointers;
+
+    JUCE_DECLARE_NON_COPYABLE(Reader)
 };
+
+#if RUN_UNIT_TESTS
+
+class ProcessorOutputFIFOTest : public juce::UnitTest
+{
+public:
+    ProcessorOutputFIFOTest();
+
+    void runTest() override;
+};
+
+#endif
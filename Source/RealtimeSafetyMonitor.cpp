@@ -0,0 +1,716 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "RealtimeSafetyMonitor.h"
+#include "SpectrumAnalyser.h"
+#include "ResizableAudioFIFO.h"
+#include "AnalysisThread.h"
+
+#if REALTIME_SAFETY_CHECKS
+
+#include <new>
+#include <cstdlib>
+
+#if JUCE_LINUX
+#include <dlfcn.h>
+#include <pthread.h>
+#elif JUCE_MAC
+#include <malloc/malloc.h>
+#include <mach/mach.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#elif JUCE_WINDOWS
+#include <crtdbg.h>
+#endif
+
+//
+// Plain globals with constant initialisers, so they're safe to use from operator new before any static
+// constructors have run
+//
+static std::atomic<uint64_t> allocationCount{ 0 };
+static std::atomic<uint64_t> deallocationCount{ 0 };
+static std::atomic<uint64_t> lockCount{ 0 };
+static std::atomic<char const*> lastViolationSection{ nullptr };
+
+#if JUCE_MAC
+
+//
+// The first time a thread touches a thread_local, macOS allocates its storage with malloc, which would
+// recurse through the malloc zone hooks below. pthread keys use fixed slots in the thread and never
+// allocate, so the per-thread state lives there instead. Until the keys exist, every thread reads as
+// being outside any section.
+//
+static std::atomic<bool> threadKeysCreated{ false };
+static pthread_key_t realtimeDepthKey, realtimeSectionNameKey, callingCAllocatorKey;
+
+static bool createThreadKeys()
+{
+    pthread_key_create(&realtimeDepthKey, nullptr);
+    pthread_key_create(&realtimeSectionNameKey, nullptr);
+    pthread_key_create(&callingCAllocatorKey, nullptr);
+    threadKeysCreated.store(true, std::memory_order_release);
+    return true;
+}
+
+static void* getThreadValue(pthread_key_t const& key)
+{
+    return threadKeysCreated.load(std::memory_order_acquire) ? pthread_getspecific(key) : nullptr;
+}
+
+static int getRealtimeDepth() { return (int)(intptr_t)getThreadValue(realtimeDepthKey); }
+static void setRealtimeDepth(int depth) { pthread_setspecific(realtimeDepthKey, (void*)(intptr_t)depth); }
+static char const* getRealtimeSectionName() { return static_cast<char const*>(getThreadValue(realtimeSectionNameKey)); }
+static void setRealtimeSectionName(char const* name) { pthread_setspecific(realtimeSectionNameKey, name); }
+static bool isCallingCAllocator() { return getThreadValue(callingCAllocatorKey) != nullptr; }
+static void setCallingCAllocator(bool calling) { pthread_setspecific(callingCAllocatorKey, calling ? &callingCAllocatorKey : nullptr); }
+
+#else
+
+static thread_local int realtimeDepth = 0;
+static thread_local char const* realtimeSectionName = nullptr;
+static thread_local bool callingCAllocator = false;
+
+static int getRealtimeDepth() { return realtimeDepth; }
+static void setRealtimeDepth(int depth) { realtimeDepth = depth; }
+static char const* getRealtimeSectionName() { return realtimeSectionName; }
+static void setRealtimeSectionName(char const* name) { realtimeSectionName = name; }
+static bool isCallingCAllocator() { return callingCAllocator; }
+static void setCallingCAllocator(bool calling) { callingCAllocator = calling; }
+
+#endif
+
+static void countViolation(std::atomic<uint64_t>& count)
+{
+    if (getRealtimeDepth() > 0)
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+        lastViolationSection.store(getRealtimeSectionName(), std::memory_order_relaxed);
+    }
+}
+
+//
+// For the C allocator hooks on macOS and Windows; operator new and delete have already counted the calls
+// they make to the C allocator
+//
+static void countCAllocatorViolation(std::atomic<uint64_t>& count)
+{
+    if (!isCallingCAllocator())
+    {
+        countViolation(count);
+    }
+}
+
+struct ScopedUncountedCAllocation
+{
+    ScopedUncountedCAllocation() { setCallingCAllocator(true); }
+    ~ScopedUncountedCAllocation() { setCallingCAllocator(wasCallingCAllocator); }
+
+    bool const wasCallingCAllocator = isCallingCAllocator();
+};
+
+#if JUCE_LINUX
+
+//
+// glibc's own entry points, so operator new and delete don't count twice through the interposed malloc
+// and free below
+//
+extern "C" void* __libc_malloc(std::size_t size);
+extern "C" void* __libc_calloc(std::size_t numElements, std::size_t elementSize);
+extern "C" void* __libc_realloc(void* pointer, std::size_t size);
+extern "C" void __libc_free(void* pointer);
+
+static void* mallocUncounted(std::size_t size) { return __libc_malloc(size); }
+static void freeUncounted(void* pointer) { __libc_free(pointer); }
+
+#else
+
+static void* mallocUncounted(std::size_t size)
+{
+    ScopedUncountedCAllocation uncounted;
+    return std::malloc(size);
+}
+
+static void freeUncounted(void* pointer)
+{
+    ScopedUncountedCAllocation uncounted;
+    std::free(pointer);
+}
+
+#endif
+
+static void* allocate(std::size_t size)
+{
+    countViolation(allocationCount);
+
+    if (auto pointer = mallocUncounted(size == 0 ? 1 : size))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc{};
+}
+
+static void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    countViolation(allocationCount);
+
+    auto const alignmentBytes = juce::jmax(sizeof(void*), (std::size_t)alignment);
+    size = size == 0 ? 1 : size;
+
+    ScopedUncountedCAllocation uncounted;
+
+#if JUCE_WINDOWS
+    auto pointer = _aligned_malloc(size, alignmentBytes);
+#else
+    void* pointer = nullptr;
+    if (posix_memalign(&pointer, alignmentBytes, size) != 0)
+    {
+        pointer = nullptr;
+    }
+#endif
+
+    if (pointer)
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc{};
+}
+
+static void deallocate(void* pointer)
+{
+    if (pointer)
+    {
+        countViolation(deallocationCount);
+        freeUncounted(pointer);
+    }
+}
+
+static void deallocateAligned(void* pointer)
+{
+    if (pointer)
+    {
+        countViolation(deallocationCount);
+
+#if JUCE_WINDOWS
+        ScopedUncountedCAllocation uncounted;
+        _aligned_free(pointer);
+#else
+        freeUncounted(pointer);
+#endif
+    }
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    try { return allocateAligned(size, alignment); } catch (...) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    try { return allocateAligned(size, alignment); } catch (...) { return nullptr; }
+}
+
+void operator delete(void* pointer) noexcept { deallocate(pointer); }
+void operator delete[](void* pointer) noexcept { deallocate(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { deallocate(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { deallocate(pointer); }
+void operator delete(void* pointer, std::nothrow_t const&) noexcept { deallocate(pointer); }
+void operator delete[](void* pointer, std::nothrow_t const&) noexcept { deallocate(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { deallocateAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { deallocateAligned(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { deallocateAligned(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { deallocateAligned(pointer); }
+void operator delete(void* pointer, std::align_val_t, std::nothrow_t const&) noexcept { deallocateAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t, std::nothrow_t const&) noexcept { deallocateAligned(pointer); }
+
+#if JUCE_LINUX
+
+//
+// Interpose the C allocation functions too, since juce::HeapBlock and so juce::AudioBuffer allocate with
+// std::malloc rather than operator new. These forward straight to glibc instead of going through dlsym,
+// which allocates itself.
+//
+extern "C" void* malloc(std::size_t size)
+{
+    countViolation(allocationCount);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(std::size_t numElements, std::size_t elementSize)
+{
+    countViolation(allocationCount);
+    return __libc_calloc(numElements, elementSize);
+}
+
+extern "C" void* realloc(void* pointer, std::size_t size)
+{
+    if (pointer != nullptr && size == 0)
+    {
+        countViolation(deallocationCount);
+    }
+    else
+    {
+        countViolation(allocationCount);
+    }
+
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer)
+{
+    if (pointer)
+    {
+        countViolation(deallocationCount);
+        __libc_free(pointer);
+    }
+}
+
+//
+// Interpose the pthread lock functions; std::mutex, juce::CriticalSection, and juce::WaitableEvent all end up
+// here. The real functions are looked up on first use without a function-local static, since the static's
+// guard could itself take a lock.
+//
+template <typename Function> static Function findNextSymbol(std::atomic<void*>& cache, char const* name)
+{
+    auto symbol = cache.load(std::memory_order_acquire);
+    if (symbol == nullptr)
+    {
+        symbol = dlsym(RTLD_NEXT, name);
+        cache.store(symbol, std::memory_order_release);
+    }
+
+    return reinterpret_cast<Function>(symbol);
+}
+
+static std::atomic<void*> nextMutexLock{ nullptr };
+static std::atomic<void*> nextMutexTryLock{ nullptr };
+static std::atomic<void*> nextReadLock{ nullptr };
+static std::atomic<void*> nextWriteLock{ nullptr };
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    countViolation(lockCount);
+    return findNextSymbol<int (*)(pthread_mutex_t*)>(nextMutexLock, "pthread_mutex_lock")(mutex);
+}
+
+extern "C" int pthread_mutex_trylock(pthread_mutex_t* mutex)
+{
+    countViolation(lockCount);
+    return findNextSymbol<int (*)(pthread_mutex_t*)>(nextMutexTryLock, "pthread_mutex_trylock")(mutex);
+}
+
+extern "C" int pthread_rwlock_rdlock(pthread_rwlock_t* lock)
+{
+    countViolation(lockCount);
+    return findNextSymbol<int (*)(pthread_rwlock_t*)>(nextReadLock, "pthread_rwlock_rdlock")(lock);
+}
+
+extern "C" int pthread_rwlock_wrlock(pthread_rwlock_t* lock)
+{
+    countViolation(lockCount);
+    return findNextSymbol<int (*)(pthread_rwlock_t*)>(nextWriteLock, "pthread_rwlock_wrlock")(lock);
+}
+
+#elif JUCE_MAC
+
+//
+// malloc and free go through the default malloc zone, so patch its function table. The zone is
+// read-only from version 8, so unprotect its page while patching. The original functions are copied
+// out first and the hooks forward to them.
+//
+static malloc_zone_t originalZone;
+
+static void* zoneMalloc(malloc_zone_t* zone, size_t size)
+{
+    countCAllocatorViolation(allocationCount);
+    return originalZone.malloc(zone, size);
+}
+
+static void* zoneCalloc(malloc_zone_t* zone, size_t numElements, size_t elementSize)
+{
+    countCAllocatorViolation(allocationCount);
+    return originalZone.calloc(zone, numElements, elementSize);
+}
+
+static void* zoneValloc(malloc_zone_t* zone, size_t size)
+{
+    countCAllocatorViolation(allocationCount);
+    return originalZone.valloc(zone, size);
+}
+
+static void* zoneRealloc(malloc_zone_t* zone, void* pointer, size_t size)
+{
+    countCAllocatorViolation(pointer != nullptr && size == 0 ? deallocationCount : allocationCount);
+    return originalZone.realloc(zone, pointer, size);
+}
+
+static void* zoneMemalign(malloc_zone_t* zone, size_t alignment, size_t size)
+{
+    countCAllocatorViolation(allocationCount);
+    return originalZone.memalign(zone, alignment, size);
+}
+
+static void zoneFree(malloc_zone_t* zone, void* pointer)
+{
+    if (pointer)
+    {
+        countCAllocatorViolation(deallocationCount);
+    }
+
+    originalZone.free(zone, pointer);
+}
+
+static void zoneFreeDefiniteSize(malloc_zone_t* zone, void* pointer, size_t size)
+{
+    if (pointer)
+    {
+        countCAllocatorViolation(deallocationCount);
+    }
+
+    originalZone.free_definite_size(zone, pointer, size);
+}
+
+static bool hookDefaultMallocZone()
+{
+    createThreadKeys();
+
+    //
+    // malloc_default_zone() can return a wrapper that forwards to the real default zone, which is the
+    // first registered zone
+    //
+    vm_address_t* zones = nullptr;
+    unsigned int numZones = 0;
+    if (malloc_get_all_zones(mach_task_self(), nullptr, &zones, &numZones) != KERN_SUCCESS || numZones == 0)
+    {
+        return false;
+    }
+
+    auto zone = reinterpret_cast<malloc_zone_t*>(zones[0]);
+    originalZone = *zone;
+
+    auto const pageSize = (uintptr_t)getpagesize();
+    auto const firstPage = reinterpret_cast<uintptr_t>(zone) & ~(pageSize - 1);
+    auto const length = reinterpret_cast<uintptr_t>(zone + 1) - firstPage;
+    bool const isReadOnly = zone->version >= 8;
+
+    if (isReadOnly)
+    {
+        mprotect(reinterpret_cast<void*>(firstPage), length, PROT_READ | PROT_WRITE);
+    }
+
+    zone->malloc = zoneMalloc;
+    zone->calloc = zoneCalloc;
+    zone->valloc = zoneValloc;
+    zone->realloc = zoneRealloc;
+    zone->free = zoneFree;
+
+    if (zone->version >= 5)
+    {
+        zone->memalign = zoneMemalign;
+    }
+
+    if (zone->version >= 6)
+    {
+        zone->free_definite_size = zoneFreeDefiniteSize;
+    }
+
+    if (isReadOnly)
+    {
+        mprotect(reinterpret_cast<void*>(firstPage), length, PROT_READ);
+    }
+
+    return true;
+}
+
+static bool const cAllocatorHooked = hookDefaultMallocZone();
+
+#elif JUCE_WINDOWS && defined(_DEBUG)
+
+//
+// The debug CRT calls this for every malloc, realloc and free; the release CRT has no equivalent. Blocks
+// the CRT allocates for itself aren't counted.
+//
+static int crtAllocHook(int allocType, void*, size_t, int blockType, long, unsigned char const*, int)
+{
+    if (blockType != _CRT_BLOCK)
+    {
+        countCAllocatorViolation(allocType == _HOOK_FREE ? deallocationCount : allocationCount);
+    }
+
+    return TRUE;
+}
+
+static bool const cAllocatorHooked = (_CrtSetAllocHook(crtAllocHook), true);
+
+#endif
+
+RealtimeSafetyMonitor::Counts RealtimeSafetyMonitor::getViolationCounts()
+{
+    return { allocationCount.load(std::memory_order_relaxed),
+        deallocationCount.load(std::memory_order_relaxed),
+        lockCount.load(std::memory_order_relaxed) };
+}
+
+void RealtimeSafetyMonitor::resetViolationCounts()
+{
+    allocationCount = 0;
+    deallocationCount = 0;
+    lockCount = 0;
+    lastViolationSection = nullptr;
+}
+
+char const* RealtimeSafetyMonitor::getLastViolationSection()
+{
+    return lastViolationSection.load(std::memory_order_relaxed);
+}
+
+RealtimeSafetyMonitor::ScopedRealtimeSection::ScopedRealtimeSection(char const* name) :
+    previousName(getRealtimeSectionName())
+{
+    setRealtimeSectionName(name);
+    setRealtimeDepth(getRealtimeDepth() + 1);
+}
+
+RealtimeSafetyMonitor::ScopedRealtimeSection::~ScopedRealtimeSection()
+{
+    setRealtimeDepth(getRealtimeDepth() - 1);
+    setRealtimeSectionName(previousName);
+}
+
+#else
+
+RealtimeSafetyMonitor::Counts RealtimeSafetyMonitor::getViolationCounts()
+{
+    return {};
+}
+
+void RealtimeSafetyMonitor::resetViolationCounts()
+{
+}
+
+char const* RealtimeSafetyMonitor::getLastViolationSection()
+{
+    return nullptr;
+}
+
+#endif
+
+#if RUN_UNIT_TESTS
+
+RealtimeSafetyMonitorTest::RealtimeSafetyMonitorTest() : UnitTest("RealtimeSafetyMonitorTest")
+{
+}
+
+void RealtimeSafetyMonitorTest::runTest()
+{
+    auto describe = [](RealtimeSafetyMonitor::Counts const& counts)
+    {
+        auto section = RealtimeSafetyMonitor::getLastViolationSection();
+        return juce::String{ (juce::int64)counts.allocations } + " allocations, "
+            + juce::String{ (juce::int64)counts.deallocations } + " deallocations, "
+            + juce::String{ (juce::int64)counts.locks } + " locks, last in " + (section ? section : "nothing");
+    };
+
+    if (RealtimeSafetyMonitor::isEnabled())
+    {
+        beginTest("Counts inside sections only");
+
+        RealtimeSafetyMonitor::resetViolationCounts();
+        auto outside = std::make_unique<int>(1);
+        outside.reset();
+        expectEquals((int)RealtimeSafetyMonitor::getViolationCounts().getTotal(), 0);
+
+        std::mutex mutex;
+        {
+            RealtimeSafetyMonitor::ScopedRealtimeSection outerSection{ "outer" };
+            RealtimeSafetyMonitor::ScopedRealtimeSection innerSection{ "inner" };
+            auto inside = std::make_unique<int>(2);
+            inside.reset();
+
+            std::lock_guard lock{ mutex };
+        }
+
+        auto counts = RealtimeSafetyMonitor::getViolationCounts();
+        expectEquals((int)counts.allocations, 1);
+        expectEquals((int)counts.deallocations, 1);
+#if JUCE_LINUX
+        expectEquals((int)counts.locks, 1);
+#endif
+        expect(juce::String{ RealtimeSafetyMonitor::getLastViolationSection() } == "inner");
+
+        if (RealtimeSafetyMonitor::countsCAllocations())
+        {
+            beginTest("Counts malloc and free");
+
+            RealtimeSafetyMonitor::resetViolationCounts();
+            {
+                RealtimeSafetyMonitor::ScopedRealtimeSection section{ "malloc" };
+                auto pointer = std::malloc(16);
+                pointer = std::realloc(pointer, 32);
+                std::free(pointer);
+                std::free(std::calloc(4, sizeof(float)));
+            }
+
+            counts = RealtimeSafetyMonitor::getViolationCounts();
+            expectEquals((int)counts.allocations, 3);
+            expectEquals((int)counts.deallocations, 2);
+
+            //
+            // Resizing an AudioBuffer on the audio thread is the classic mistake; it allocates through
+            // juce::HeapBlock
+            //
+            beginTest("Counts AudioBuffer resizing");
+
+            juce::AudioBuffer<float> buffer{ 2, 64 };
+            RealtimeSafetyMonitor::resetViolationCounts();
+            {
+                RealtimeSafetyMonitor::ScopedRealtimeSection section{ "setSize" };
+                buffer.setSize(2, 4096);
+            }
+
+            counts = RealtimeSafetyMonitor::getViolationCounts();
+            expect(counts.allocations > 0, describe(counts));
+            expect(juce::String{ RealtimeSafetyMonitor::getLastViolationSection() } == "setSize");
+        }
+        else
+        {
+            logMessage("malloc and free aren't counted in this build, so resizing an AudioBuffer goes unnoticed");
+        }
+    }
+    else
+    {
+        logMessage("Build with REALTIME_SAFETY_CHECKS=1 to check the audio and analysis paths for allocations and locks");
+    }
+
+    {
+        beginTest("Audio and analysis paths are real-time safe");
+
+        //
+        // Everything processBlock and the analysis thread do, with the settings changed on the "message
+        // thread" in between. Only the analysis calls and the audio thread side of the FIFOs are in the section.
+        //
+        double constexpr sampleRate = 48000.0;
+        int constexpr numChannels = 3;
+        int constexpr blockSize = 480;
+
+        ResizableAudioFIFO inputFIFO;
+        inputFIFO.setSize(numChannels, FFTPlans::maxSize * 2, AudioFIFO::Backend::mirroredMemory);
+        inputFIFO.reset();
+
+        AnalysisThread analysisThread{ [] {} };
+        analysisThread.start();
+
+        juce::AudioBuffer<float> floatBlock{ numChannels, blockSize };
+        juce::AudioBuffer<double> doubleBlock{ numChannels, blockSize };
+        juce::Random random;
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            for (int index = 0; index < blockSize; ++index)
+            {
+                floatBlock.setSample(channel, index, random.nextFloat() - 0.5f);
+                doubleBlock.setSample(channel, index, random.nextDouble() - 0.5);
+            }
+        }
+
+        for (auto format : { TransportFormat::float32, TransportFormat::logMagnitude16 })
+        {
+            SpectrumAnalyser analyser;
+            analyser.setTransportFormat(format);
+            analyser.prepare(sampleRate, numChannels, 1);
+            auto reader = analyser.outputFIFO.createReader();
+
+            ProcessorOutput readerOutput;
+            RealtimeSafetyMonitor::resetViolationCounts();
+
+            auto runBlocks = [&](int numBlocks)
+            {
+                for (int block = 0; block < numBlocks; ++block)
+                {
+                    {
+                        RealtimeSafetyMonitor::ScopedRealtimeSection section{ "processBlock" };
+
+                        auto const arrivalTicks = juce::Time::getHighResolutionTicks();
+                        int const numSamplesWritten = block % 2 ? inputFIFO.write(floatBlock) : inputFIFO.write(doubleBlock);
+                        analyser.noteInputBlock(numSamplesWritten, arrivalTicks);
+                        auto& fifo = inputFIFO.getFIFOForAudioThread();
+
+                        inputFIFO.requestMinimumSize(blockSize + FFTPlans::maxSize);
+                        analysisThread.signal();
+
+                        analyser.update();
+                        analyser.analyse(fifo);
+                    }
+
+                    while (reader->read(readerOutput))
+                    {
+                    }
+                }
+            };
+
+            runBlocks(20);
+
+            std::array<std::function<void()>, 7> const changes
+            {
+                [&] { analyser.setFFTOrder(FFTPlans::maxOrder); },
+                [&] { analyser.setFFTOrder(FFTPlans::minOrder); },
+                [&] { analyser.setOverlapPercent(SpectrumAnalyser::maxOverlapPercent); },
+                [&] { analyser.setAnalysisEngine(AnalysisEngine::slidingDFT); analyser.setSlidingDFTHopSize(64); },
+                [&] { analyser.setAnalysisEngine(AnalysisEngine::fft); analyser.setRealPairFFT(false); },
+                [&] { analyser.setMaximumDisplayFrequency(2000.0); },
+                [&] { analyser.setBandLayout({ BandMap::Layout::Type::sixthOctave }); }
+            };
+
+            for (auto const& change : changes)
+            {
+                change();
+                runBlocks(120);
+                analyser.freeRetiredBandMaps();
+            }
+
+            auto counts = RealtimeSafetyMonitor::getViolationCounts();
+            expect(counts.getTotal() == 0, describe(counts));
+        }
+
+        analysisThread.stop();
+    }
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Counts heap allocations and lock acquisitions made on threads that are inside a ScopedRealtimeSection
+//
+// Build with REALTIME_SAFETY_CHECKS=1 to replace the global operator new and delete with versions that
+// count any call made inside a section. The C allocator is counted too, which covers juce::HeapBlock and
+// so juce::AudioBuffer: Linux interposes malloc, calloc, realloc and free, macOS patches the default
+// malloc zone, and Windows uses the debug CRT's allocation hook. The release CRT has no hook, so Windows
+// release builds only count operator new and delete and miss an AudioBuffer being resized;
+// countsCAllocations() says which applies. Threads outside a section aren't affected, apart from the
+// cost of reading the thread's state.
+//
+// On Linux, pthread_mutex_lock, pthread_mutex_trylock and the pthread_rwlock lock functions are
+// interposed as well, which covers std::mutex, juce::CriticalSection, and juce::WaitableEvent. Other
+// platforms don't count locks.
+//
+// Spin locks never call into the system, so juce::SpinLock and other atomic-based locks aren't
+// detected.
+//
+// With REALTIME_SAFETY_CHECKS=0, ScopedRealtimeSection compiles to nothing and the counts stay at zero.
+//
+class RealtimeSafetyMonitor
+{
+public:
+    struct Counts
+    {
+        uint64_t allocations = 0;
+        uint64_t deallocations = 0;
+        uint64_t locks = 0;
+
+        uint64_t getTotal() const
+        {
+            return allocations + deallocations + locks;
+        }
+    };
+
+    static constexpr bool isEnabled()
+    {
+#if REALTIME_SAFETY_CHECKS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    //
+    // True if malloc and free are counted along with operator new and delete
+    //
+    static constexpr bool countsCAllocations()
+    {
+#if REALTIME_SAFETY_CHECKS && (JUCE_LINUX || JUCE_MAC || (JUCE_WINDOWS && defined(_DEBUG)))
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static Counts getViolationCounts();
+    static void resetViolationCounts();
+
+    //
+    // Name of the innermost section where the most recent violation happened, or nullptr if there haven't
+    // been any
+    //
+    static char const* getLastViolationSection();
+
+    //
+    // Marks the calling thread as real-time for the lifetime of the object; sections can nest. name
+    // needs to be a string literal.
+    //
+    class ScopedRealtimeSection
+    {
+    public:
+#if REALTIME_SAFETY_CHECKS
+        explicit ScopedRealtimeSection(char const* name);
+        ~ScopedRealtimeSection();
+
+    private:
+        char const* const previousName;
+#else
+        explicit ScopedRealtimeSection(char const*) {}
+#endif
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSection)
+    };
+};
+
+#if RUN_UNIT_TESTS
+
+class RealtimeSafetyMonitorTest : public juce::UnitTest
+{
+public:
+    RealtimeSafetyMonitorTest();
+
+    void runTest() override;
+};
+
+#endif
@@ -0,0 +1,384 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "ResizableAudioFIFO.h"
+
+ResizableAudioFIFO::~ResizableAudioFIFO()
+{
+    deleteAll();
+}
+
+void ResizableAudioFIFO::deleteAll()
+{
+    delete active.exchange(nullptr);
+    delete pending.exchange(nullptr);
+    delete retired.exchange(nullptr);
+}
+
+void ResizableAudioFIFO::setSize(int numChannels_, int numSamples, AudioFIFO::Backend preferredBackend, int numOverflowSamples)
+{
+    deleteAll();
+
+    numChannels = numChannels_;
+    backend = preferredBackend;
+    requestedSize = numSamples;
+
+    auto fifo = std::make_unique<AudioFIFO>();
+    fifo->setSize(numChannels, numSamples, backend);
+    active.store(fifo.release(), std::memory_order_release);
+
+    overflow.setSize(numChannels, juce::jmax(numSamples, numOverflowSamples));
+    overflow.reset(0);
+
+    numOverrunSamples = 0;
+    numUnderrunSamples = 0;
+}
+
+void ResizableAudioFIFO::reset()
+{
+    if (auto fifo = active.load(std::memory_order_acquire))
+    {
+        fifo->reset(0);
+    }
+
+    overflow.reset(0);
+}
+
+void ResizableAudioFIFO::service()
+{
+    //
+    // Free the ring that the audio thread swapped out
+    //
+    delete retired.exchange(nullptr, std::memory_order_acq_rel);
+
+    //
+    // Allocate a bigger ring if the audio thread asked for one
+    //
+    auto current = active.load(std::memory_order_acquire);
+    int wantedSize = requestedSize.load(std::memory_order_relaxed);
+    if (current == nullptr || pending.load(std::memory_order_acquire) != nullptr || wantedSize <= current->getNumSamples())
+    {
+        return;
+    }
+
+    auto fifo = std::make_unique<AudioFIFO>();
+    fifo->setSize(numChannels, wantedSize, backend);
+    fifo->reset(0);
+    pending.store(fifo.release(), std::memory_order_release);
+}
+
+AudioFIFO& ResizableAudioFIFO::getFIFOForAudioThread()
+{
+    auto current = active.load(std::memory_order_relaxed);
+
+    //
+    // Swap in the new ring if there is one, as long as the message thread has freed the last retired ring
+    // and no other thread is reading from the current ring
+    //
+    if (pending.load(std::memory_order_acquire) != nullptr
+        && retired.load(std::memory_order_acquire) == nullptr
+        && !consumerLocked.exchange(true, std::memory_order_acquire))
+    {
+        auto next = pending.exchange(nullptr, std::memory_order_acq_rel);
+        next->takeStoredSamplesFrom(*current);
+        next->moveStoredSamplesFrom(overflow);
+
+        active.store(next, std::memory_order_release);
+        retired.store(current, std::memory_order_release);
+        current = next;
+
+        consumerLocked.store(false, std::memory_order_release);
+    }
+
+    publishCounts(*current);
+    return *current;
+}
+
+void ResizableAudioFIFO::publishCounts(AudioFIFO const& fifo)
+{
+    //
+    // The ring's own counters carry over when a bigger ring is swapped in, so these only ever go up
+    //
+    numOverrunSamples.store(fifo.getNumOverrunSamples(), std::memory_order_relaxed);
+    numUnderrunSamples.store(fifo.getNumUnderrunSamples(), std::memory_order_relaxed);
+}
+
+void ResizableAudioFIFO::requestMinimumSize(int numSamples)
+{
+    if (numSamples > requestedSize.load(std::memory_order_relaxed))
+    {
+        requestedSize.store(numSamples, std::memory_order_relaxed);
+    }
+}
+
+int ResizableAudioFIFO::write(juce::AudioBuffer<float> const& source)
+{
+    return writeSamples(source);
+}
+
+int ResizableAudioFIFO::write(juce::AudioBuffer<double> const& source)
+{
+    return writeSamples(source);
+}
+
+template <typename SampleType> int ResizableAudioFIFO::writeSamples(juce::AudioBuffer<SampleType> const& source)
+{
+    auto& fifo = getFIFOForAudioThread();
+    int const numSamples = source.getNumSamples();
+
+    //
+    // Anything already in the overflow goes into the ring before the new samples
+    //
+    int numSamplesWritten = 0;
+    if (overflow.getNumSamplesStored() > 0)
+    {
+        fifo.moveStoredSamplesFrom(overflow);
+    }
+
+    if (overflow.getNumSamplesStored() == 0)
+    {
+        numSamplesWritten = fifo.write(source, 0, juce::jmin(numSamples, fifo.getNumSamplesFree()));
+    }
+
+    if (numSamplesWritten == numSamples)
+    {
+        return numSamples;
+    }
+
+    //
+    // Spill the rest and ask for a ring that can hold everything that's waiting
+    //
+    int const numSamplesSpilled = juce::jmin(numSamples - numSamplesWritten, overflow.getNumSamplesFree());
+    overflow.write(source, numSamplesWritten, numSamplesSpilled);
+    numSamplesWritten += numSamplesSpilled;
+
+    if (numSamplesWritten < numSamples)
+    {
+        fifo.recordOverrun(numSamples - numSamplesWritten);
+        publishCounts(fifo);
+    }
+
+    requestMinimumSize(fifo.getNumSamples() + overflow.getNumSamplesStored());
+
+    return numSamplesWritten;
+}
+
+AudioFIFO* ResizableAudioFIFO::lockForConsumer()
+{
+    if (consumerLocked.exchange(true, std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+
+    return active.load(std::memory_order_acquire);
+}
+
+void ResizableAudioFIFO::unlockForConsumer()
+{
+    consumerLocked.store(false, std::memory_order_release);
+}
+
+#if RUN_UNIT_TESTS
+
+ResizableAudioFIFOTest::ResizableAudioFIFOTest() : UnitTest("ResizableAudioFIFOTest")
+{
+}
+
+void ResizableAudioFIFOTest::runTest()
+{
+    beginTest("ResizableAudioFIFOTest");
+
+    ResizableAudioFIFO resizableFIFO;
+    resizableFIFO.setSize(2, 64);
+    resizableFIFO.reset();
+
+    auto& smallFIFO = resizableFIFO.getFIFOForAudioThread();
+    expect(smallFIFO.getNumSamples() == 64);
+
+    juce::AudioBuffer<float> source{ 2, 48 };
+    for (int channel = 0; channel < source.getNumChannels(); ++channel)
+    {
+        for (int index = 0; index < source.getNumSamples(); ++index)
+        {
+            source.setSample(channel, index, (float)(channel * 1000 + index));
+        }
+    }
+
+    //
+    // Leave some unread samples that wrap around the end of the small ring
+    //
+    smallFIFO.write(source);
+    smallFIFO.advanceReadPosition(40);
+    smallFIFO.write(source);
+    expect(smallFIFO.getNumSamplesStored() == 56);
+
+    //
+    // Nothing changes until the message thread services the request
+    //
+    resizableFIFO.requestMinimumSize(1000);
+    expect(&resizableFIFO.getFIFOForAudioThread() == &smallFIFO);
+
+    resizableFIFO.service();
+    auto& largeFIFO = resizableFIFO.getFIFOForAudioThread();
+    expect(&largeFIFO != &smallFIFO);
+    expect(largeFIFO.getNumSamples() >= 1000);
+    expect(resizableFIFO.getActiveFIFO() == &largeFIFO);
+    expect(largeFIFO.getNumSamplesStored() == 56);
+    expect(largeFIFO.getNumOverrunSamples() == 0);
+
+    for (int channel = 0; channel < source.getNumChannels(); ++channel)
+    {
+        auto view = largeFIFO.getReadView(channel, 56);
+        for (int index = 0; index < 8; ++index)
+        {
+            expect(view[index] == source.getSample(channel, 40 + index));
+        }
+
+        for (int index = 0; index < 48; ++index)
+        {
+            expect(view[8 + index] == source.getSample(channel, index));
+        }
+    }
+
+    //
+    // Smaller requests don't shrink the ring
+    //
+    resizableFIFO.requestMinimumSize(100);
+    resizableFIFO.service();
+    expect(&resizableFIFO.getFIFOForAudioThread() == &largeFIFO);
+
+    //
+    // The audio thread puts off the swap while another thread is consuming
+    //
+    auto consumerFIFO = resizableFIFO.lockForConsumer();
+    expect(consumerFIFO == &largeFIFO);
+    expect(resizableFIFO.lockForConsumer() == nullptr);
+
+    resizableFIFO.requestMinimumSize(4000);
+    resizableFIFO.service();
+    expect(&resizableFIFO.getFIFOForAudioThread() == &largeFIFO);
+
+    resizableFIFO.unlockForConsumer();
+    auto& largestFIFO = resizableFIFO.getFIFOForAudioThread();
+    expect(&largestFIFO != &largeFIFO);
+    expect(largestFIFO.getNumSamples() >= 4000);
+    expect(largestFIFO.getNumSamplesStored() == 56);
+    expect(resizableFIFO.lockForConsumer() == &largestFIFO);
+    resizableFIFO.unlockForConsumer();
+
+    {
+        beginTest("Block size jump with a worker consumer");
+
+        //
+        // Like AnalysisMode::workerThread; the audio thread only writes, and the worker reads whatever it
+        // finds on its next pass. The host block size jumps past the ring size, and the worker doesn't run
+        // for a couple of callbacks.
+        //
+        ResizableAudioFIFO workerFIFO;
+        workerFIFO.setSize(1, 1024, AudioFIFO::Backend::audioBuffer, 4096);
+        workerFIFO.reset();
+
+        float nextValue = 0.0f, expectedValue = 0.0f;
+        int numMismatches = 0;
+        auto writeBlock = [&](int blockSize)
+        {
+            juce::AudioBuffer<float> block{ 1, blockSize };
+            for (int index = 0; index < blockSize; ++index)
+            {
+                block.setSample(0, index, nextValue++);
+            }
+
+            expectEquals(workerFIFO.write(block), blockSize);
+        };
+
+        auto runWorker = [&]()
+        {
+            auto fifo = workerFIFO.lockForConsumer();
+            expect(fifo != nullptr);
+
+            int const numSamples = fifo->getNumSamplesStored();
+            auto view = fifo->getReadView(0, numSamples);
+            for (int index = 0; index < numSamples; ++index)
+            {
+                numMismatches += view[index] != expectedValue++ ? 1 : 0;
+            }
+
+            fifo->advanceReadPosition(numSamples);
+            workerFIFO.unlockForConsumer();
+        };
+
+        writeBlock(256);
+        runWorker();
+
+        //
+        // Each pass the worker can only take a ring's worth, so the overflow builds up until the message
+        // thread allocates the larger ring
+        //
+        for (int block = 1; block <= 3; ++block)
+        {
+            writeBlock(1536);
+            expectEquals(workerFIFO.getNumOverflowSamplesStored(), block * 512);
+            runWorker();
+        }
+
+        //
+        // The overflow moves across with the swap, and then drains as the worker keeps up
+        //
+        workerFIFO.service();
+        writeBlock(1536);
+        expect(workerFIFO.getActiveFIFO()->getNumSamples() >= 2560);
+        runWorker();
+
+        for (int block = 0; block < 8; ++block)
+        {
+            workerFIFO.service();
+            writeBlock(1536);
+            runWorker();
+        }
+
+        expectEquals(workerFIFO.getNumOverflowSamplesStored(), 0);
+        expectEquals(workerFIFO.getNumOverrunSamples(), (uint64_t)0);
+        expectEquals(numMismatches, 0);
+        expectEquals(expectedValue, nextValue);
+
+        //
+        // With no room left in the ring or the overflow, the rest of the block is dropped and counted, and
+        // the count survives the ring being swapped out
+        //
+        int const numSamplesFree = workerFIFO.getFIFOForAudioThread().getNumSamplesFree() + 4096;
+        juce::AudioBuffer<float> hugeBlock{ 1, numSamplesFree + 100 };
+        hugeBlock.clear();
+        expectEquals(workerFIFO.write(hugeBlock), hugeBlock.getNumSamples() - 100);
+        expectEquals(workerFIFO.getNumOverrunSamples(), (uint64_t)100);
+
+        workerFIFO.service();
+        workerFIFO.getFIFOForAudioThread();
+        expectEquals(workerFIFO.getNumOverrunSamples(), (uint64_t)100);
+
+        workerFIFO.setSize(1, 1024);
+        expectEquals(workerFIFO.getNumOverrunSamples(), (uint64_t)0);
+    }
+}
+
+#endif
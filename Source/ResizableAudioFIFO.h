@@ -0,0 +1,146 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include "AudioFIFO.h"
+
+//
+// AudioFIFO that can grow without the audio thread ever allocating
+//
+// The audio thread asks for a bigger ring with requestMinimumSize(). The message thread calls service()
+// periodically; it allocates the new ring and posts it to the audio thread. The next call to
+// getFIFOForAudioThread() moves any unread samples into the new ring, swaps it in, and hands the old
+// ring back to the message thread to be freed on a later service() call.
+//
+// When the consumer runs on another thread, the audio thread can't wait for it to make room, so write()
+// spills whatever doesn't fit in the ring into a preallocated overflow ring and asks for a bigger ring.
+// The overflow is moved into the ring, ahead of any new samples, as the consumer frees up space or as
+// soon as the bigger ring is swapped in. Input is only dropped if the overflow fills up as well, so size
+// the overflow to cover the blocks that arrive before service() runs.
+//
+// The audio thread is always the producer. The consumer can either be the audio thread itself, or
+// another thread that brackets its reads with lockForConsumer() and unlockForConsumer(). Neither side
+// ever waits; if the consumer is busy, the audio thread puts off the swap until a later callback, and
+// if the audio thread is swapping, lockForConsumer() returns nullptr and the consumer tries again later.
+//
+class ResizableAudioFIFO
+{
+public:
+    ResizableAudioFIFO() = default;
+    ~ResizableAudioFIFO();
+
+    //
+    // Only call setSize and reset while the audio thread isn't running (from prepareToPlay, for example).
+    // The overflow holds numOverflowSamples, or numSamples if that's larger.
+    //
+    void setSize(int numChannels, int numSamples, AudioFIFO::Backend preferredBackend = AudioFIFO::Backend::audioBuffer, int numOverflowSamples = 0);
+    void reset();
+
+    //
+    // Message thread
+    //
+    void service();
+
+    //
+    // The ring the audio thread is using; setSize() frees it, so only the thread that calls setSize() may
+    // hold on to it
+    //
+    AudioFIFO const* getActiveFIFO() const
+    {
+        return active.load(std::memory_order_acquire);
+    }
+
+    //
+    // Any thread; the totals since setSize() across all the rings, as of the last audio thread call.
+    // Underruns on a consumer thread show up after the next audio callback.
+    //
+    uint64_t getNumOverrunSamples() const
+    {
+        return numOverrunSamples.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getNumUnderrunSamples() const
+    {
+        return numUnderrunSamples.load(std::memory_order_relaxed);
+    }
+
+    //
+    // Audio thread
+    //
+    AudioFIFO& getFIFOForAudioThread();
+    void requestMinimumSize(int numSamples);
+
+    //
+    // Writes the whole block to the ring, spilling into the overflow; returns the number of samples taken,
+    // which is only short of the block size if the overflow is full
+    //
+    int write(juce::AudioBuffer<float> const& source);
+    int write(juce::AudioBuffer<double> const& source);
+
+    int getNumOverflowSamplesStored() const
+    {
+        return overflow.getNumSamplesStored();
+    }
+
+    //
+    // Consumer thread, if the consumer isn't the audio thread
+    //
+    AudioFIFO* lockForConsumer();
+    void unlockForConsumer();
+
+private:
+    std::atomic<AudioFIFO*> active = nullptr;
+    std::atomic<AudioFIFO*> pending = nullptr;
+    std::atomic<AudioFIFO*> retired = nullptr;
+    std::atomic<int> requestedSize = 0;
+    std::atomic<bool> consumerLocked = false;
+    std::atomic<uint64_t> numOverrunSamples = 0;
+    std::atomic<uint64_t> numUnderrunSamples = 0;
+    int numChannels = 0;
+    AudioFIFO::Backend backend = AudioFIFO::Backend::audioBuffer;
+
+    //
+    // Audio thread only
+    //
+    AudioFIFO overflow;
+
+    void deleteAll();
+    void publishCounts(AudioFIFO const& fifo);
+    template <typename SampleType> int writeSamples(juce::AudioBuffer<SampleType> const& source);
+
+    JUCE_DECLARE_NON_COPYABLE(ResizableAudioFIFO)
+};
+
+#if RUN_UNIT_TESTS
+
+class ResizableAudioFIFOTest : public juce::UnitTest
+{
+public:
+    ResizableAudioFIFOTest();
+
+    void runTest() override;
+};
+
+#endif
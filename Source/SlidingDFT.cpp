@@ -0,0 +1,409 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "SlidingDFT.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+#include <emmintrin.h>
+#elif JUCE_USE_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+//
+// Four term Blackman-Harris window as a convolution across the bins, scaled by 1 / a0 so the window
+// averages to 1 like the normalized window tables used by the FFT path
+//
+static constexpr float blackmanHarrisA0 = 0.35875f;
+static constexpr float windowKernel1 = -0.48829f * 0.5f / blackmanHarrisA0;
+static constexpr float windowKernel2 = 0.14128f * 0.5f / blackmanHarrisA0;
+static constexpr float windowKernel3 = -0.01168f * 0.5f / blackmanHarrisA0;
+
+void SlidingDFT::setSize(int numChannels, int maxFFTSize_)
+{
+    jassert(juce::isPowerOfTwo(maxFFTSize_));
+
+    maxFFTSize = maxFFTSize_;
+    int const maxNumBins = maxFFTSize / 2 + 1;
+
+    channels.clear();
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto state = std::make_unique<Channel>();
+        state->history.allocate((size_t)maxFFTSize, true);
+        state->real.allocate((size_t)maxNumBins, true);
+        state->imaginary.allocate((size_t)maxNumBins, true);
+        channels.add(std::move(state));
+    }
+
+    twiddleCos.allocate((size_t)maxNumBins, true);
+    twiddleSin.allocate((size_t)maxNumBins, true);
+
+    setFFTSize(maxFFTSize);
+}
+
+void SlidingDFT::setFFTSize(int fftSize_)
+{
+    jassert(juce::isPowerOfTwo(fftSize_) && fftSize_ <= maxFFTSize);
+
+    fftSize = fftSize_;
+    for (int bin = 0; bin <= fftSize / 2; ++bin)
+    {
+        double angle = juce::MathConstants<double>::twoPi * bin / fftSize;
+        twiddleCos[bin] = (float)std::cos(angle);
+        twiddleSin[bin] = (float)std::sin(angle);
+    }
+
+    reset();
+}
+
+void SlidingDFT::reset()
+{
+    for (auto state : channels)
+    {
+        juce::FloatVectorOperations::clear(state->history, fftSize);
+        juce::FloatVectorOperations::clear(state->real, fftSize / 2 + 1);
+        juce::FloatVectorOperations::clear(state->imaginary, fftSize / 2 + 1);
+        state->historyPosition = 0;
+    }
+}
+
+void SlidingDFT::pushSamples(int channel, float const* samples, int numSamples)
+{
+    auto& state = *channels[channel];
+    int const positionMask = fftSize - 1;
+
+    while (numSamples > 0)
+    {
+        //
+        // Swap the new samples into the history and keep the difference between each new sample and the
+        // sample it replaces; that's all the recursion needs
+        //
+        int chunkSize = juce::jmin(numSamples, maxChunkSize);
+        for (int index = 0; index < chunkSize; ++index)
+        {
+            auto& oldest = state.history[state.historyPosition];
+            state.differences[(size_t)index] = samples[index] - oldest;
+            oldest = samples[index];
+            state.historyPosition = (state.historyPosition + 1) & positionMask;
+        }
+
+        rotateBins(state, chunkSize);
+
+        samples += chunkSize;
+        numSamples -= chunkSize;
+    }
+}
+
+void SlidingDFT::rotateBins(Channel& state, int numDifferences)
+{
+    //
+    // Load each group of bins once and run all the new samples through it
+    //
+    int const numBins = fftSize / 2 + 1;
+    int bin = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+    for (; bin + 4 <= numBins; bin += 4)
+    {
+        auto real = _mm_loadu_ps(state.real + bin);
+        auto imaginary = _mm_loadu_ps(state.imaginary + bin);
+        auto const c = _mm_loadu_ps(twiddleCos + bin);
+        auto const s = _mm_loadu_ps(twiddleSin + bin);
+
+        for (int index = 0; index < numDifferences; ++index)
+        {
+            real = _mm_add_ps(real, _mm_set1_ps(state.differences[(size_t)index]));
+            auto rotatedReal = _mm_sub_ps(_mm_mul_ps(real, c), _mm_mul_ps(imaginary, s));
+            imaginary = _mm_add_ps(_mm_mul_ps(real, s), _mm_mul_ps(imaginary, c));
+            real = rotatedReal;
+        }
+
+        _mm_storeu_ps(state.real + bin, real);
+        _mm_storeu_ps(state.imaginary + bin, imaginary);
+    }
+#elif JUCE_USE_ARM_NEON
+    for (; bin + 4 <= numBins; bin += 4)
+    {
+        auto real = vld1q_f32(state.real + bin);
+        auto imaginary = vld1q_f32(state.imaginary + bin);
+        auto const c = vld1q_f32(twiddleCos + bin);
+        auto const s = vld1q_f32(twiddleSin + bin);
+
+        for (int index = 0; index < numDifferences; ++index)
+        {
+            real = vaddq_f32(real, vdupq_n_f32(state.differences[(size_t)index]));
+            auto rotatedReal = vmlsq_f32(vmulq_f32(real, c), imaginary, s);
+            imaginary = vmlaq_f32(vmulq_f32(real, s), imaginary, c);
+            real = rotatedReal;
+        }
+
+        vst1q_f32(state.real + bin, real);
+        vst1q_f32(state.imaginary + bin, imaginary);
+    }
+#endif
+
+    for (; bin < numBins; ++bin)
+    {
+        auto real = state.real[bin];
+        auto imaginary = state.imaginary[bin];
+        auto const c = twiddleCos[bin];
+        auto const s = twiddleSin[bin];
+
+        for (int index = 0; index < numDifferences; ++index)
+        {
+            real += state.differences[(size_t)index];
+            auto rotatedReal = real * c - imaginary * s;
+            imaginary = real * s + imaginary * c;
+            real = rotatedReal;
+        }
+
+        state.real[bin] = real;
+        state.imaginary[bin] = imaginary;
+    }
+}
+
+void SlidingDFT::resync(int channel, juce::dsp::FFT const& fft, std::complex<float>* workspace)
+{
+    jassert(fft.getSize() == fftSize);
+
+    auto& state = *channels[channel];
+    auto input = workspace;
+    auto output = workspace + fftSize;
+
+    //
+    // The history position is the oldest sample
+    //
+    for (int index = 0; index < fftSize; ++index)
+    {
+        input[index] = { state.history[(state.historyPosition + index) & (fftSize - 1)], 0.0f };
+    }
+
+    fft.perform(input, output, false);
+
+    for (int bin = 0; bin <= fftSize / 2; ++bin)
+    {
+        state.real[bin] = output[bin].real();
+        state.imaginary[bin] = output[bin].imag();
+    }
+}
+
+std::complex<float> SlidingDFT::getBin(Channel const& state, int bin) const
+{
+    //
+    // Negative bins and bins above Nyquist are the complex conjugates of the stored bins
+    //
+    if (bin < 0)
+    {
+        return std::conj(getBin(state, -bin));
+    }
+
+    if (bin > fftSize / 2)
+    {
+        return std::conj(getBin(state, fftSize - bin));
+    }
+
+    return { state.real[bin], state.imaginary[bin] };
+}
+
+void SlidingDFT::getMagnitudes(int channel, float* magnitudes) const
+{
+    auto const& state = *channels[channel];
+    int const lastBin = fftSize / 2;
+
+    auto windowedMagnitude = [](float real, float imaginary)
+    {
+        return std::sqrt(real * real + imaginary * imaginary);
+    };
+
+    auto windowEdgeBin = [&](int bin)
+    {
+        auto windowed = getBin(state, bin)
+            + windowKernel1 * (getBin(state, bin - 1) + getBin(state, bin + 1))
+            + windowKernel2 * (getBin(state, bin - 2) + getBin(state, bin + 2))
+            + windowKernel3 * (getBin(state, bin - 3) + getBin(state, bin + 3));
+        magnitudes[bin] = std::abs(windowed);
+    };
+
+    for (int bin = 0; bin < juce::jmin(3, lastBin + 1); ++bin)
+    {
+        windowEdgeBin(bin);
+    }
+
+    auto const real = state.real.getData();
+    auto const imaginary = state.imaginary.getData();
+    for (int bin = 3; bin <= lastBin - 3; ++bin)
+    {
+        auto windowedReal = real[bin]
+            + windowKernel1 * (real[bin - 1] + real[bin + 1])
+            + windowKernel2 * (real[bin - 2] + real[bin + 2])
+            + windowKernel3 * (real[bin - 3] + real[bin + 3]);
+        auto windowedImaginary = imaginary[bin]
+            + windowKernel1 * (imaginary[bin - 1] + imaginary[bin + 1])
+            + windowKernel2 * (imaginary[bin - 2] + imaginary[bin + 2])
+            + windowKernel3 * (imaginary[bin - 3] + imaginary[bin + 3]);
+        magnitudes[bin] = windowedMagnitude(windowedReal, windowedImaginary);
+    }
+
+    for (int bin = juce::jmax(3, lastBin - 2); bin <= lastBin; ++bin)
+    {
+        windowEdgeBin(bin);
+    }
+}
+
+#if RUN_UNIT_TESTS
+
+SlidingDFTTest::SlidingDFTTest() : UnitTest("SlidingDFTTest")
+{
+}
+
+void SlidingDFTTest::runTest()
+{
+    juce::Random random;
+
+    auto makeSamples = [&](int numSamples)
+    {
+        std::vector<float> samples((size_t)numSamples);
+        for (auto& sample : samples)
+        {
+            sample = random.nextFloat() * 2.0f - 1.0f;
+        }
+        return samples;
+    };
+
+    //
+    // Reference: window the last N samples with a periodic Blackman-Harris window and run a regular FFT
+    //
+    auto getReferenceMagnitudes = [](std::vector<float> const& samples, int fftSize)
+    {
+        std::vector<float> fftData((size_t)fftSize * 2);
+        auto const first = samples.end() - fftSize;
+        for (int index = 0; index < fftSize; ++index)
+        {
+            double phase = juce::MathConstants<double>::twoPi * index / fftSize;
+            double window = 0.35875 - 0.48829 * std::cos(phase) + 0.14128 * std::cos(2.0 * phase) - 0.01168 * std::cos(3.0 * phase);
+            fftData[(size_t)index] = first[index] * (float)(window / 0.35875);
+        }
+
+        juce::dsp::FFT fft{ juce::roundToInt(std::log2(fftSize)) };
+        fft.performFrequencyOnlyForwardTransform(fftData.data(), true);
+        return fftData;
+    };
+
+    auto getMaxError = [](std::vector<float> const& reference, std::vector<float> const& magnitudes, int numBins)
+    {
+        float maxError = 0.0f;
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            maxError = juce::jmax(maxError, std::abs(reference[(size_t)bin] - magnitudes[(size_t)bin]));
+        }
+        return maxError;
+    };
+
+    int constexpr fftOrder = 8;
+    int constexpr fftSize = 1 << fftOrder;
+    int constexpr numBins = fftSize / 2 + 1;
+    juce::dsp::FFT fft{ fftOrder };
+    juce::HeapBlock<std::complex<float>> workspace{ (size_t)fftSize * 2 };
+    std::vector<float> magnitudes((size_t)numBins);
+
+    SlidingDFT slidingDFT;
+    slidingDFT.setSize(1, fftSize * 4);
+    slidingDFT.setFFTSize(fftSize);
+    expect(slidingDFT.getFFTSize() == fftSize);
+
+    {
+        beginTest("Matches windowed FFT");
+
+        auto samples = makeSamples(fftSize);
+        slidingDFT.pushSamples(0, samples.data(), fftSize);
+        slidingDFT.getMagnitudes(0, magnitudes.data());
+
+        auto maxError = getMaxError(getReferenceMagnitudes(samples, fftSize), magnitudes, numBins);
+        expect(maxError < 1.0e-3f, "Max error " + juce::String{ maxError });
+    }
+
+    {
+        beginTest("Drift and resync");
+
+        //
+        // Odd sized hops so the chunks don't line up with the history
+        //
+        auto samples = makeSamples(fftSize * 40);
+        int pushed = 0;
+        while (pushed < (int)samples.size())
+        {
+            int hopSize = juce::jmin(37, (int)samples.size() - pushed);
+            slidingDFT.pushSamples(0, samples.data() + pushed, hopSize);
+            pushed += hopSize;
+        }
+
+        auto reference = getReferenceMagnitudes(samples, fftSize);
+
+        slidingDFT.getMagnitudes(0, magnitudes.data());
+        auto driftError = getMaxError(reference, magnitudes, numBins);
+        expect(driftError < 1.0e-2f, "Drift error " + juce::String{ driftError });
+
+        slidingDFT.resync(0, fft, workspace);
+        slidingDFT.getMagnitudes(0, magnitudes.data());
+        auto resyncError = getMaxError(reference, magnitudes, numBins);
+        expect(resyncError < 1.0e-3f, "Resync error " + juce::String{ resyncError });
+        expect(resyncError <= driftError);
+    }
+
+    {
+        beginTest("Cost per spectrum");
+
+        int constexpr benchmarkOrder = 10;
+        int constexpr benchmarkSize = 1 << benchmarkOrder;
+        int constexpr numSpectra = 200;
+        juce::dsp::FFT benchmarkFFT{ benchmarkOrder };
+        std::vector<float> fftData((size_t)benchmarkSize * 2);
+        std::vector<float> benchmarkMagnitudes((size_t)benchmarkSize / 2 + 1);
+        auto samples = makeSamples(benchmarkSize);
+
+        auto startTicks = juce::Time::getHighResolutionTicks();
+        for (int spectrum = 0; spectrum < numSpectra; ++spectrum)
+        {
+            std::copy(samples.begin(), samples.end(), fftData.begin());
+            benchmarkFFT.performFrequencyOnlyForwardTransform(fftData.data(), true);
+        }
+        auto fftSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        logMessage("FFT: " + juce::String{ fftSeconds * 1.0e6 / numSpectra, 2 } + " microseconds per spectrum");
+
+        slidingDFT.setFFTSize(benchmarkSize);
+        for (int hopSize : { 32, 64, 256 })
+        {
+            startTicks = juce::Time::getHighResolutionTicks();
+            for (int spectrum = 0; spectrum < numSpectra; ++spectrum)
+            {
+                slidingDFT.pushSamples(0, samples.data(), hopSize);
+                slidingDFT.getMagnitudes(0, benchmarkMagnitudes.data());
+            }
+            auto slidingSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+            logMessage("Sliding DFT, hop " + juce::String{ hopSize } + ": " + juce::String{ slidingSeconds * 1.0e6 / numSpectra, 2 } + " microseconds per spectrum");
+        }
+    }
+}
+
+#endif
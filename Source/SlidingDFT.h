@@ -0,0 +1,117 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Sliding DFT; updates every bin of an N-point DFT for each new sample instead of recomputing the
+// whole transform every hop
+//
+// Each new sample x[n] updates bin k with
+//
+//      X[k] = (X[k] + x[n] - x[n - N]) * exp(j * 2 * pi * k / N)
+//
+// so the cost per hop is proportional to the hop size rather than N * log(N). The bins are stored as
+// separate real and imaginary arrays and updated four at a time with SSE or NEON.
+//
+// Rounding errors in the recursion slowly accumulate, so call resync() every so often to recompute the
+// bins exactly from the last N samples with a full FFT.
+//
+// getMagnitudes() applies a Blackman-Harris window in the frequency domain as a 7-tap convolution across
+// the bins and scales the result to match a windowed FFT of the same size.
+//
+class SlidingDFT
+{
+public:
+    //
+    // Allocates; call from prepareToPlay
+    //
+    void setSize(int numChannels, int maxFFTSize);
+
+    //
+    // Doesn't allocate; clears the history and the bins
+    //
+    void setFFTSize(int fftSize);
+    void reset();
+
+    int getFFTSize() const
+    {
+        return fftSize;
+    }
+
+    int getNumChannels() const
+    {
+        return channels.size();
+    }
+
+    void pushSamples(int channel, float const* samples, int numSamples);
+
+    //
+    // workspace needs room for fftSize * 2 values
+    //
+    void resync(int channel, juce::dsp::FFT const& fft, std::complex<float>* workspace);
+
+    //
+    // magnitudes needs room for fftSize / 2 + 1 values
+    //
+    void getMagnitudes(int channel, float* magnitudes) const;
+
+private:
+    static constexpr int maxChunkSize = 256;
+
+    //
+    // Each channel has its own scratch space so different channels can be updated on different threads
+    //
+    struct Channel
+    {
+        juce::HeapBlock<float> history;
+        juce::HeapBlock<float> real;
+        juce::HeapBlock<float> imaginary;
+        std::array<float, maxChunkSize> differences{};
+        int historyPosition = 0;
+    };
+
+    juce::OwnedArray<Channel> channels;
+    juce::HeapBlock<float> twiddleCos;
+    juce::HeapBlock<float> twiddleSin;
+    int fftSize = 0;
+    int maxFFTSize = 0;
+
+    void rotateBins(Channel& state, int numDifferences);
+    std::complex<float> getBin(Channel const& state, int bin) const;
+};
+
+#if RUN_UNIT_TESTS
+
+class SlidingDFTTest : public juce::UnitTest
+{
+public:
+    SlidingDFTTest();
+
+    void runTest() override;
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "SpectrogramHistory.h"
+
+#if RUN_UNIT_TESTS
+
+SpectrogramHistoryTest::SpectrogramHistoryTest() : UnitTest("SpectrogramHistoryTest")
+{
+}
+
+void SpectrogramHistoryTest::runTest()
+{
+    runQuantisationTest<uint8_t>();
+    runQuantisationTest<uint16_t>();
+
+    beginTest("SpectrogramHistory memory");
+    {
+        //
+        // A minute of 513-bin stereo spectra at 187 spectra per second
+        //
+        int constexpr numBins = 513;
+        size_t constexpr numSpectra = 60 * 187;
+
+        SpectrogramHistory<uint8_t> history;
+        history.setSize(2, numSpectra * numBins * 2);
+        history.setNumBins(numBins);
+
+        expectEquals(history.getNumColumns(), (int)numSpectra);
+        expectEquals(history.getNumBytes(), (size_t)history.getNumColumns() * numBins * 2 * sizeof(uint8_t));
+        logMessage("One minute of 8-bit history: " + juce::String{ (double)history.getNumBytes() / (1024.0 * 1024.0), 1 } + " MB");
+    }
+
+    runConcurrencyTest();
+}
+
+template <typename CodeType> void SpectrogramHistoryTest::runQuantisationTest()
+{
+    beginTest("SpectrogramHistory quantisation " + juce::String{ (int)sizeof(CodeType) * 8 } + "-bit");
+
+    int constexpr numChannels = 2;
+    int constexpr numBins = 64;
+    int constexpr numColumns = 16;
+
+    SpectrogramHistory<CodeType> history;
+    history.setSize(numChannels, numChannels * numBins * numColumns);
+    history.setNumBins(numBins);
+    expectEquals(history.getNumColumns(), numColumns);
+    expectEquals(history.getNumBytes(), (size_t)(numChannels * numBins * numColumns) * sizeof(CodeType));
+    expectEquals((int)history.getNumColumnsWritten(), 0);
+
+    //
+    // Levels from well above the range to well below it, plus silence
+    //
+    std::array<float, numBins> magnitudes;
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        magnitudes[(size_t)bin] = juce::Decibels::decibelsToGain(12.0f - (float)bin * 2.5f, -1000.0f);
+    }
+    magnitudes.back() = 0.0f;
+
+    std::array<CodeType, numBins> codes;
+    for (int column = 0; column < numColumns * 3; ++column)
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            history.write(channel, magnitudes.data());
+        }
+        history.advanceWritePosition();
+
+        //
+        // Only numColumns - 1 columns can be read back; the writer owns the slot of the oldest
+        //
+        auto const count = history.getNumColumnsWritten();
+        expectEquals((int)count, column + 1);
+        expectEquals((int)history.getFirstReadableColumn(), juce::jmax(0, column + 1 - (numColumns - 1)));
+        if (count > (uint64_t)(numColumns - 1))
+        {
+            expect(!history.readColumn(history.getFirstReadableColumn() - 1, 0, codes.data(), numBins));
+        }
+        expect(!history.readColumn(count, 0, codes.data(), numBins));
+    }
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        expect(history.readColumn(history.getNumColumnsWritten() - 1, channel, codes.data(), numBins));
+
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            float const decibels = juce::Decibels::gainToDecibels(magnitudes[(size_t)bin], -1000.0f);
+            float const expected = juce::jlimit(-120.0f, 0.0f, decibels);
+            expect(std::abs(history.getDecibels(codes[(size_t)bin]) - expected) <= history.getDecibelsPerStep() * 0.5f + 0.001f,
+                juce::String{ decibels } + " dB read back as " + juce::String{ history.getDecibels(codes[(size_t)bin]) });
+        }
+    }
+
+    expect(codes.front() == SpectrogramHistory<CodeType>::maxCode);
+    expect(codes.back() == 0);
+
+    //
+    // Wrong size or channel
+    //
+    expect(!history.readColumn(history.getNumColumnsWritten() - 1, 0, codes.data(), numBins - 1));
+    expect(!history.readColumn(history.getNumColumnsWritten() - 1, numChannels, codes.data(), numBins));
+
+    //
+    // Changing the number of bins drops the history
+    //
+    auto const lastColumn = history.getNumColumnsWritten() - 1;
+    history.setNumBins(numBins / 2);
+    expectEquals(history.getNumColumns(), numColumns * 2);
+    expect(!history.readColumn(lastColumn, 0, codes.data(), numBins / 2));
+    expect(history.getFirstReadableColumn() == history.getNumColumnsWritten());
+
+    history.write(0, magnitudes.data());
+    history.write(1, magnitudes.data());
+    history.advanceWritePosition();
+    expect(history.readColumn(lastColumn + 1, 1, codes.data(), numBins / 2));
+}
+
+void SpectrogramHistoryTest::runConcurrencyTest()
+{
+    beginTest("SpectrogramHistory concurrent readers");
+
+    int constexpr numChannels = 2;
+    int constexpr numBins = 257;
+    int constexpr numColumns = 8;
+    uint64_t constexpr numWrites = 50000;
+    int constexpr numReaders = 2;
+
+    SpectrogramHistory<uint8_t> history;
+    history.setSize(numChannels, numChannels * numBins * numColumns);
+    history.setNumBins(numBins);
+
+    //
+    // Every bin in a column gets the same code, taken from the column number, so a torn read shows up as a
+    // column with mixed codes
+    //
+    std::vector<std::vector<float>> magnitudesForCode;
+    for (int code = 0; code <= SpectrogramHistory<uint8_t>::maxCode; ++code)
+    {
+        magnitudesForCode.emplace_back((size_t)numBins, juce::Decibels::decibelsToGain(history.getDecibels((uint8_t)code), -1000.0f));
+    }
+
+    std::atomic<bool> writerDone = false;
+    std::array<int, numReaders> numTornColumns{};
+    std::array<int, numReaders> numWrongColumns{};
+    std::array<int, numReaders> numColumnsRead{};
+    std::vector<std::thread> readers;
+    for (int index = 0; index < numReaders; ++index)
+    {
+        readers.emplace_back([&, index]()
+            {
+                std::vector<uint8_t> codes((size_t)numBins);
+
+                while (!writerDone.load())
+                {
+                    auto const column = history.getFirstReadableColumn();
+                    for (int channel = 0; channel < numChannels; ++channel)
+                    {
+                        if (history.readColumn(column, channel, codes.data(), numBins))
+                        {
+                            if (std::any_of(codes.begin(), codes.end(), [&](uint8_t code) { return code != codes.front(); }))
+                            {
+                                ++numTornColumns[(size_t)index];
+                            }
+
+                            if (codes.front() != (uint8_t)(column & 0xff))
+                            {
+                                ++numWrongColumns[(size_t)index];
+                            }
+
+                            ++numColumnsRead[(size_t)index];
+                        }
+                    }
+                }
+            });
+    }
+
+    std::thread writer{ [&]()
+        {
+            for (uint64_t column = 0; column < numWrites; ++column)
+            {
+                auto const& magnitudes = magnitudesForCode[(size_t)(column & 0xff)];
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    history.write(channel, magnitudes.data());
+                }
+                history.advanceWritePosition();
+            }
+
+            writerDone = true;
+        } };
+
+    writer.join();
+    for (auto& thread : readers)
+    {
+        thread.join();
+    }
+
+    for (int index = 0; index < numReaders; ++index)
+    {
+        expectEquals(numTornColumns[(size_t)index], 0);
+        expectEquals(numWrongColumns[(size_t)index], 0);
+        expect(numColumnsRead[(size_t)index] > 0);
+    }
+}
+
+#endif
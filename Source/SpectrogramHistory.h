@@ -0,0 +1,238 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Spectrogram history for waterfall and history views
+//
+// Keeps the most recent spectra quantised to 8 or 16-bit decibels in one contiguous ring; each column holds
+// one spectrum, with the channels one after another. The analysis quantises each channel straight into the
+// column being written and calls advanceWritePosition() once the column is complete, so appending is O(1)
+// and never allocates.
+//
+// Any number of threads can read columns by index while the analysis runs. Like BroadcastFIFO, readers copy a
+// column out and then check that the writer didn't lap them while they were copying; readColumn() returns
+// false if the column was overwritten or the layout changed.
+//
+// With 8-bit codes over a 120 dB range each step is just under 0.5 dB; a minute of 513-bin stereo spectra at
+// 187 spectra per second takes 11.5 MB instead of 46 MB of floats.
+//
+template <typename CodeType> class SpectrogramHistory
+{
+public:
+    static_assert(std::is_same_v<CodeType, uint8_t> || std::is_same_v<CodeType, uint16_t>);
+
+    static constexpr int maxCode = std::numeric_limits<CodeType>::max();
+
+    //
+    // Allocates; call from prepareToPlay with nothing reading or writing. The number of columns depends on
+    // the number of bins per column, so capacityInValues is shared between the columns when setNumBins() is called.
+    //
+    void setSize(int numChannels_, size_t capacityInValues, juce::Range<float> decibelRange = { -120.0f, 0.0f })
+    {
+        numChannels = juce::jmax(1, numChannels_);
+        capacity = juce::jmax((size_t)numChannels * 2, capacityInValues);
+        codes.allocate(capacity, true);
+
+        minDecibels = decibelRange.getStart();
+        decibelsPerStep = decibelRange.getLength() / (float)maxCode;
+
+        //
+        // code = 20 * log10(magnitude) / decibelsPerStep - minDecibels / decibelsPerStep, with log10 done as log2
+        //
+        log2Scale = 20.0f * std::log10(2.0f) / decibelsPerStep;
+        codeOffset = -minDecibels / decibelsPerStep;
+
+        setNumBins(1);
+    }
+
+    //
+    // Writer thread; drops the history if the number of bins changes. Doesn't allocate.
+    //
+    void setNumBins(int numBins_)
+    {
+        auto sequence = layoutSequence.load(std::memory_order_relaxed);
+        layoutSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        numBins.store(juce::jmax(1, numBins_), std::memory_order_relaxed);
+        numColumns.store(juce::jmax(2, (int)juce::jmin((size_t)std::numeric_limits<int>::max(), capacity / (size_t)(numChannels * numBins))), std::memory_order_relaxed);
+        firstColumn.store(writeCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+        layoutSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    //
+    // Writer thread; quantises one channel into the column being written. Different channels can be written
+    // from different threads.
+    //
+    void write(int channel, float const* magnitudes)
+    {
+        quantise(magnitudes, getColumn(writeCount.load(std::memory_order_relaxed)) + channel * numBins.load(std::memory_order_relaxed), numBins.load(std::memory_order_relaxed));
+    }
+
+    void advanceWritePosition()
+    {
+        writeCount.store(writeCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+        //
+        // Order the store above before the writes to the next column, so a reader that sees any of them also
+        // sees the new write count
+        //
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    //
+    // Any thread
+    //
+    int getNumChannels() const
+    {
+        return numChannels;
+    }
+
+    int getNumBins() const
+    {
+        return numBins.load(std::memory_order_acquire);
+    }
+
+    int getNumColumns() const
+    {
+        return numColumns.load(std::memory_order_acquire);
+    }
+
+    //
+    // Columns are numbered from when the history was created; columns from getFirstReadableColumn() up to
+    // getNumColumnsWritten() - 1 can be read
+    //
+    uint64_t getNumColumnsWritten() const
+    {
+        return writeCount.load(std::memory_order_acquire);
+    }
+
+    uint64_t getFirstReadableColumn() const
+    {
+        auto const count = writeCount.load(std::memory_order_acquire);
+        auto const oldest = count - juce::jmin(count, (uint64_t)(getNumColumns() - 1));
+        return juce::jmax(oldest, firstColumn.load(std::memory_order_acquire));
+    }
+
+    bool readColumn(uint64_t column, int channel, CodeType* destination, int numDestinationBins) const
+    {
+        auto sequence = layoutSequence.load(std::memory_order_acquire);
+        if ((sequence & 1) != 0 || !juce::isPositiveAndBelow(channel, numChannels))
+        {
+            return false;
+        }
+
+        int const bins = numBins.load(std::memory_order_relaxed);
+        if (numDestinationBins != bins || !isReadable(column))
+        {
+            return false;
+        }
+
+        std::memcpy(destination, getColumn(column) + channel * bins, (size_t)bins * sizeof(CodeType));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return layoutSequence.load(std::memory_order_relaxed) == sequence && isReadable(column);
+    }
+
+    float getDecibels(CodeType code) const
+    {
+        return minDecibels + (float)code * decibelsPerStep;
+    }
+
+    float getDecibelsPerStep() const
+    {
+        return decibelsPerStep;
+    }
+
+    size_t getNumBytes() const
+    {
+        return capacity * sizeof(CodeType);
+    }
+
+private:
+    juce::HeapBlock<CodeType> codes;
+    size_t capacity = 0;
+    int numChannels = 1;
+    float minDecibels = -120.0f;
+    float decibelsPerStep = 0.5f;
+    float log2Scale = 0.0f;
+    float codeOffset = 0.0f;
+
+    alignas(64) std::atomic<uint64_t> writeCount = 0;
+    alignas(64) std::atomic<uint64_t> layoutSequence = 0;
+    std::atomic<int> numBins = 1;
+    std::atomic<int> numColumns = 2;
+    std::atomic<uint64_t> firstColumn = 0;
+
+    CodeType* getColumn(uint64_t column) const
+    {
+        auto const columnSize = (size_t)(numChannels * numBins.load(std::memory_order_relaxed));
+        return codes.getData() + (size_t)(column % (uint64_t)numColumns.load(std::memory_order_relaxed)) * columnSize;
+    }
+
+    //
+    // The writer is always filling the column at writeCount, which shares its slot with the column
+    // numColumns behind it
+    //
+    bool isReadable(uint64_t column) const
+    {
+        auto const count = writeCount.load(std::memory_order_relaxed);
+        return column >= firstColumn.load(std::memory_order_relaxed)
+            && column < count
+            && count - column < (uint64_t)numColumns.load(std::memory_order_relaxed);
+    }
+
+    void quantise(float const* magnitudes, CodeType* destination, int count) const
+    {
+        for (int bin = 0; bin < count; ++bin)
+        {
+            //
+            // Silence gives log2 of -inf, which clamps to code 0 along with everything under the range
+            //
+            auto const code = std::log2(magnitudes[bin]) * log2Scale + codeOffset;
+            destination[bin] = (CodeType)(juce::jlimit(0.0f, (float)maxCode, code) + 0.5f);
+        }
+    }
+};
+
+#if RUN_UNIT_TESTS
+
+class SpectrogramHistoryTest : public juce::UnitTest
+{
+public:
+    SpectrogramHistoryTest();
+
+    void runTest() override;
+
+private:
+    template <typename CodeType> void runQuantisationTest();
+    void runConcurrencyTest();
+};
+
+#endif
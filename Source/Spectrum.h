@@ -47,15 +47,43 @@ public:
         return *this;
     }
 
-    Spectrum& withFFTSize(int fftSize)
+    //
+    // Set avoidReallocating to switch to a smaller FFT size without freeing the memory for the larger size
+    //
+    Spectrum& withFFTSize(int fftSize, bool avoidReallocating = false)
     {
         jassert(juce::isPowerOfTwo(fftSize));
 
         numNonNegativeFrequencyBins = fftSize / 2 + 1;
-        spectrumBuffer.setSize(spectrumBuffer.getNumChannels(), numNonNegativeFrequencyBins * numBinDimensions);
+        spectrumBuffer.setSize(spectrumBuffer.getNumChannels(), numNonNegativeFrequencyBins * numBinDimensions, false, false, avoidReallocating);
         return *this;
     }
 
+    //
+    // Use external storage instead of allocating; each channel needs getNumFloatsPerChannel(fftSize) floats
+    //
+    Spectrum& withStorage(floatType* const* channelData, int numChannels, int fftSize)
+    {
+        jassert(juce::isPowerOfTwo(fftSize));
+
+        numNonNegativeFrequencyBins = fftSize / 2 + 1;
+        spectrumBuffer.setDataToReferTo(channelData, numChannels, numNonNegativeFrequencyBins * numBinDimensions);
+        return *this;
+    }
+
+    //
+    // Change the FFT size of a spectrum set up with withStorage; the storage must be large enough for the new size
+    //
+    Spectrum& withStorageFFTSize(int fftSize)
+    {
+        return withStorage(spectrumBuffer.getArrayOfWritePointers(), spectrumBuffer.getNumChannels(), fftSize);
+    }
+
+    static int getNumFloatsPerChannel(int fftSize)
+    {
+        return (fftSize / 2 + 1) * numBinDimensions;
+    }
+
     void clear()
     {   
         spectrumBuffer.clear();
@@ -73,7 +101,7 @@ public:
 
     void copyFrom(juce::AudioBuffer<floatType> const& source, int numSamples)
     {
-        int numChannels = juce::jmin(source.getNumChannels(), spectrumBuffer.getNumSamples());
+        int numChannels = juce::jmin(source.getNumChannels(), spectrumBuffer.getNumChannels());
         numSamples = juce::jmin(numSamples, spectrumBuffer.getNumSamples());
         for (int channel = 0; channel < numChannels; ++channel)
         {
@@ -83,7 +111,7 @@ public:
 
     void copyFrom(juce::AudioBuffer<floatType> const& source, int numSamples, float gain)
     {
-        int numChannels = juce::jmin(source.getNumChannels(), spectrumBuffer.getNumSamples());
+        int numChannels = juce::jmin(source.getNumChannels(), spectrumBuffer.getNumChannels());
         numSamples = juce::jmin(numSamples, spectrumBuffer.getNumSamples());
         for (int channel = 0; channel < numChannels; ++channel)
         {
@@ -93,7 +121,7 @@ public:
 
     void copyFrom(Spectrum<floatType, binValueType> const& source)
     {
-        int numChannels = juce::jmin(source.getNumChannels(), spectrumBuffer.getNumSamples());
+        int numChannels = juce::jmin(source.getNumChannels(), spectrumBuffer.getNumChannels());
         int numSamples = juce::jmin(source.getNumBins(), spectrumBuffer.getNumSamples());
         for (int channel = 0; channel < numChannels; ++channel)
         {
@@ -129,12 +157,108 @@ public:
 protected:
     juce::AudioBuffer<floatType> spectrumBuffer;
     int numNonNegativeFrequencyBins = 0;
-    int const numBinDimensions = sizeof(binValueType) / sizeof(floatType);
+    static constexpr int numBinDimensions = sizeof(binValueType) / sizeof(floatType);
 };
 
 template <typename floatType> using RealSpectrum = Spectrum<floatType, floatType>;
 template <typename floatType> using ComplexSpectrum = Spectrum<floatType, std::complex<floatType>>;
 
+//
+// One spectrum as 16-bit codes per bin (see SpectrumKernels::encodeLogMagnitude16)
+//
+// Normally refers to storage owned by something else, such as the ProcessorOutputFIFO slab. Like
+// juce::AudioBuffer, copying one makes a copy of the codes; the copy reuses its own storage if it's big
+// enough and allocates if not.
+//
+class CompactSpectrum
+{
+public:
+    CompactSpectrum() = default;
+
+    CompactSpectrum(CompactSpectrum const& other)
+    {
+        *this = other;
+    }
+
+    CompactSpectrum& operator= (CompactSpectrum const& other)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+
+        auto const numCodes = (size_t)other.numChannels * (size_t)other.numBins;
+        if (numCodes > capacity)
+        {
+            ownedStorage.allocate(numCodes, false);
+            storage = ownedStorage.getData();
+            capacity = numCodes;
+        }
+
+        numChannels = other.numChannels;
+        numBins = other.numBins;
+        channelStride = other.numBins;
+        copyFrom(other);
+        return *this;
+    }
+
+    //
+    // channelStride codes per channel; the storage must hold numChannels * channelStride codes
+    //
+    void setStorage(uint16_t* storage_, int numChannels_, int channelStride_)
+    {
+        storage = storage_;
+        numChannels = numChannels_;
+        channelStride = channelStride_;
+        capacity = (size_t)numChannels * (size_t)channelStride;
+        numBins = channelStride;
+    }
+
+    void setFFTSize(int fftSize)
+    {
+        jassert(fftSize / 2 + 1 <= channelStride);
+        numBins = juce::jmin(fftSize / 2 + 1, channelStride);
+    }
+
+    void copyFrom(CompactSpectrum const& source)
+    {
+        int const numChannelsToCopy = juce::jmin(numChannels, source.numChannels);
+        int const numBinsToCopy = juce::jmin(numBins, source.numBins);
+        for (int channel = 0; channel < numChannelsToCopy; ++channel)
+        {
+            std::copy_n(source.getReadPointer(channel), numBinsToCopy, getWritePointer(channel));
+        }
+    }
+
+    int getNumChannels() const
+    {
+        return numChannels;
+    }
+
+    int getNumBins() const
+    {
+        return numBins;
+    }
+
+    uint16_t const* getReadPointer(int channel) const
+    {
+        return storage + (size_t)channel * (size_t)channelStride;
+    }
+
+    uint16_t* getWritePointer(int channel)
+    {
+        return storage + (size_t)channel * (size_t)channelStride;
+    }
+
+private:
+    uint16_t* storage = nullptr;
+    size_t capacity = 0;
+    int numChannels = 0;
+    int numBins = 0;
+    int channelStride = 0;
+    juce::HeapBlock<uint16_t> ownedStorage;
+};
+
 #if RUN_UNIT_TESTS
 
 struct SpectrumTest : public juce::UnitTest
@@ -251,6 +375,32 @@ struct SpectrumTest : public juce::UnitTest
             fillRampB();
             verifyRampA();
             verifyRampB();
+
+            //
+            // External storage sized for twice the FFT size; shrink and grow again without moving
+            //
+            int const numFloatsPerChannel = Spectrum<floatType, binValueType>::getNumFloatsPerChannel(fftSize * 2);
+            juce::HeapBlock<floatType> storage{ (size_t)(numChannels * numFloatsPerChannel), true };
+            juce::HeapBlock<floatType*> channelPointers{ (size_t)numChannels };
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                channelPointers[channel] = storage + channel * numFloatsPerChannel;
+            }
+
+            spectrum = Spectrum<floatType, binValueType>{};
+            spectrum.withStorage(channelPointers, numChannels, fftSize * 2);
+            owner.expect(spectrum.getNumBins() == fftSize + 1);
+            owner.expect((floatType const*)spectrum.getReadPointer(0) == storage.getData());
+
+            spectrum.withStorageFFTSize(fftSize);
+            owner.expect(spectrum.getNumBins() == fftSize / 2 + 1);
+            owner.expect((floatType const*)spectrum.getReadPointer(numChannels - 1) == channelPointers[numChannels - 1]);
+            fillRampA();
+            verifyRampB();
+
+            spectrum.withStorageFFTSize(fftSize * 2);
+            owner.expect(spectrum.getNumBins() == fftSize + 1);
+            owner.expect((floatType const*)spectrum.getReadPointer(0) == storage.getData());
         }
 
         SpectrumTest& owner;
@@ -0,0 +1,1043 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "SpectrumAnalyser.h"
+
+SpectrumAnalyser::SpectrumAnalyser() :
+    fftWorkBuffer(2, FFTPlans::maxSize * 2),
+    decimationBuffer(2, 1024)
+{
+    fftPlan = &fftPlans.getPlan(FFTPlans::defaultOrder);
+    currentFFTSize = fftPlan->getSize();
+}
+
+SpectrumAnalyser::~SpectrumAnalyser()
+{
+    channelWorkers.stop();
+
+    delete pendingBandMaps.exchange(nullptr);
+    delete retiredBandMaps.exchange(nullptr);
+}
+
+void SpectrumAnalyser::prepare(double sampleRate_, int numChannels, int numWorkers)
+{
+    sampleRate = sampleRate_;
+    numChannels = juce::jlimit(1, maxNumChannels, numChannels);
+
+    //
+    // Fewer broadcast items for wide layouts so the preallocated spectra stay about the same size as for stereo
+    //
+    outputFIFO.setSize(numChannels, FFTPlans::maxSize, juce::jmax(4, 64 / numChannels), transportFormat);
+    outputFIFO.reset();
+
+    if (transportFormat == TransportFormat::float32)
+    {
+        transportBuffer.setSize(0, 0);
+    }
+    else
+    {
+        transportBuffer.setSize(numChannels * ProcessorOutput::numSpectra, FFTPlans::maxSize / 2 + 1);
+    }
+
+    fftWorkBuffer.setSize(numChannels, FFTPlans::maxSize * 2);
+    decimationBuffer.setSize(numChannels, decimationBuffer.getNumSamples());
+
+    //
+    // One complex workspace per channel so the channels can be transformed in parallel
+    //
+    complexWorkBuffer.allocate((size_t)(FFTPlans::maxSize * 2 * numChannels), false);
+
+    for (auto* spectrum : getRunningState())
+    {
+        *spectrum = RealSpectrum<float>{}.withChannels(numChannels).withFFTSize(FFTPlans::maxSize);
+    }
+
+    delete pendingBandMaps.exchange(nullptr);
+    delete retiredBandMaps.exchange(nullptr);
+    bandMaps = std::make_unique<BandMaps>(bandLayout, sampleRate);
+
+    slidingDFT.setSize(numChannels, FFTPlans::maxSize);
+
+    //
+    // Size the history for the fastest any FFT setting can fill it, so the overlap can change without
+    // shortening it; setHopSize() thins out the sliding DFT's spectra to the same rate
+    //
+    auto const historyValuesPerSecond = sampleRate * getMaxHistoryValuesPerSample() * numChannels;
+    history.setSize(numChannels, (size_t)(historySeconds * historyValuesPerSecond) + (size_t)(FFTPlans::maxSize * numChannels));
+
+    decimator.setSize(numChannels);
+    decimatedFIFO.setSize(numChannels, FFTPlans::maxSize * 2);
+    decimatedFIFO.reset(0);
+
+    inputSamplesConsumed = 0;
+    decimatedStreamStart = 0;
+    decimatedSamplesConsumed = 0;
+    blockArrivals.reset();
+    inputSamplesWritten = 0;
+
+    selectAnalysis(fftOrder,
+        analysisEngine,
+        Decimator::chooseFactor(sampleRate, maximumDisplayFrequency));
+
+    channelWorkers.stop();
+    channelWorkers.start(numWorkers);
+    fftPlans.setNumSlots(channelWorkers.getNumSlots());
+}
+
+void SpectrumAnalyser::release()
+{
+    channelWorkers.stop();
+}
+
+void SpectrumAnalyser::setBandLayout(BandMap::Layout const& layout)
+{
+    bandLayout = layout;
+
+    //
+    // Replace any pending maps the analysis hasn't picked up yet
+    //
+    delete pendingBandMaps.exchange(new BandMaps{ bandLayout, sampleRate }, std::memory_order_acq_rel);
+}
+
+void SpectrumAnalyser::freeRetiredBandMaps()
+{
+    delete retiredBandMaps.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void SpectrumAnalyser::updateBandMaps()
+{
+    //
+    // Swap in new band maps if there are any, as long as the message thread has freed the last retired maps
+    //
+    if (retiredBandMaps.load(std::memory_order_acquire) != nullptr)
+    {
+        return;
+    }
+
+    if (auto next = pendingBandMaps.exchange(nullptr, std::memory_order_acq_rel))
+    {
+        retiredBandMaps.store(bandMaps.release(), std::memory_order_release);
+        bandMaps.reset(next);
+    }
+}
+
+void SpectrumAnalyser::update()
+{
+    int order = juce::jlimit(FFTPlans::minOrder, FFTPlans::maxOrder, fftOrder.load(std::memory_order_relaxed));
+    auto engine = analysisEngine.load(std::memory_order_relaxed);
+    int decimationFactor = Decimator::chooseFactor(sampleRate, maximumDisplayFrequency.load(std::memory_order_relaxed));
+
+    if (order != fftPlan->order
+        || engine != currentAnalysisEngine
+        || decimationFactor != decimator.getFactor())
+    {
+        selectAnalysis(order, engine, decimationFactor);
+    }
+
+    //
+    // A new hop size only changes how far the input advances between spectra, so keep the running state
+    //
+    int const hopSize = chooseHopSize();
+    if (hopSize != analysisHopSize)
+    {
+        setHopSize(hopSize);
+    }
+
+    updateBandMaps();
+}
+
+void SpectrumAnalyser::selectAnalysis(int order, AnalysisEngine engine, int decimationFactor)
+{
+    fftPlan = &fftPlans.getPlan(juce::jlimit(FFTPlans::minOrder, FFTPlans::maxOrder, order));
+    int const fftSize = fftPlan->getSize();
+
+    //
+    // Samples already decimated at the old factor are at the wrong sample rate, so drop them
+    //
+    if (decimationFactor != decimator.getFactor())
+    {
+        decimator.setFactor(decimationFactor);
+        decimatedFIFO.reset(0);
+        decimatedStreamStart = inputSamplesConsumed;
+        decimatedSamplesConsumed = 0;
+    }
+
+    analysisSampleRate = sampleRate / decimator.getFactor();
+    currentFFTSize = fftSize;
+    currentAnalysisEngine = engine;
+
+    if (engine == AnalysisEngine::slidingDFT)
+    {
+        slidingDFT.setFFTSize(fftSize);
+        samplesSinceResync = 0;
+    }
+
+    history.setNumBins(fftSize / 2 + 1);
+
+    setHopSize(chooseHopSize());
+
+    //
+    // The running state was allocated for the largest FFT size in prepare()
+    //
+    for (auto* spectrum : getRunningState())
+    {
+        spectrum->withFFTSize(fftSize, true /* avoidReallocating */);
+        spectrum->clear();
+    }
+
+    int const numBins = fftSize / 2 + 1;
+    for (size_t edge = 0; edge < featureBandBins.size(); ++edge)
+    {
+        featureBandBins[edge] = juce::jlimit(0, numBins, juce::roundToInt(SpectrumFeatures::bandEdges[edge] * fftSize / analysisSampleRate));
+    }
+
+    //
+    // The first spectrum after a change has nothing to compare against, so it can't be an onset
+    //
+    featureStates.fill({});
+}
+
+int SpectrumAnalyser::getFFTHopSize(int fftSize, float overlapPercent)
+{
+    auto const overlap = juce::jlimit(0.0f, maxOverlapPercent, overlapPercent);
+    return juce::jmax(1, fftSize - juce::roundToInt(overlap * 0.01f * fftSize));
+}
+
+double SpectrumAnalyser::getMaxHistoryValuesPerSample()
+{
+    //
+    // Bins per input sample per channel at the highest overlap; the smallest FFT is the worst case, since
+    // the DC and Nyquist bins are a larger share of its spectrum
+    //
+    int constexpr fftSize = 1 << FFTPlans::minOrder;
+    return (double)(fftSize / 2 + 1) / (double)getFFTHopSize(fftSize, maxOverlapPercent);
+}
+
+int SpectrumAnalyser::chooseHopSize() const
+{
+    int const fftSize = fftPlan->getSize();
+    if (currentAnalysisEngine == AnalysisEngine::slidingDFT)
+    {
+        return juce::jlimit(1, fftSize, slidingDFTHopSize.load(std::memory_order_relaxed));
+    }
+
+    return getFFTHopSize(fftSize, overlapPercent.load(std::memory_order_relaxed));
+}
+
+void SpectrumAnalyser::setHopSize(int hopSize)
+{
+    analysisHopSize = hopSize;
+
+    //
+    // Keep one spectrum in historyStride so the history never fills faster than prepare() allowed for;
+    // only the sliding DFT with hops shorter than the FFT's at maxOverlapPercent skips any
+    //
+    auto const valuesPerSample = (double)(fftPlan->getSize() / 2 + 1) / ((double)analysisHopSize * decimator.getFactor());
+    historyStride = juce::jmax(1, (int)std::ceil(valuesPerSample / getMaxHistoryValuesPerSample() - 1.0e-9));
+    spectraSinceHistoryColumn = 0;
+
+    //
+    // The ballistics are specified in seconds, so the per-spectrum weights follow the spectrum rate
+    //
+    auto spectraPerSecond = (float)analysisSampleRate / (float)analysisHopSize;
+    ballisticWeights = SpectrumKernels::BallisticWeights{ ballisticTimes, spectraPerSecond };
+    averageFluxWeight = std::exp(-1.0f / (averageFluxSeconds * spectraPerSecond));
+    onsetHoldOffSpectra = juce::jmax(1, juce::roundToInt(onsetHoldOffSeconds * spectraPerSecond));
+}
+
+std::array<RealSpectrum<float>*, 7> SpectrumAnalyser::getRunningState()
+{
+    return { &averagingSpectrum, &fastAveragingSpectrum, &slowAveragingSpectrum, &peakHoldSpectrum, &minimumHoldSpectrum, &envelopeSpectrum, &previousSpectrum };
+}
+
+int SpectrumAnalyser::analyse(AudioFIFO& fifo, int maxNumSpectra)
+{
+    RealtimeSafetyMonitor::ScopedRealtimeSection realtimeSection{ "SpectrumAnalyser::analyse" };
+
+    if (decimator.getFactor() <= 1)
+    {
+        return runAnalysisEngine(fifo, maxNumSpectra);
+    }
+
+    //
+    // Decimate as much of the input as fits in the decimated FIFO, then analyse that
+    //
+    int numSpectra = 0;
+    while (numSpectra < maxNumSpectra)
+    {
+        decimate(fifo);
+
+        int const numNewSpectra = runAnalysisEngine(decimatedFIFO, maxNumSpectra - numSpectra);
+        numSpectra += numNewSpectra;
+
+        if (numNewSpectra == 0 && fifo.getNumSamplesStored() == 0)
+        {
+            break;
+        }
+    }
+
+    return numSpectra;
+}
+
+void SpectrumAnalyser::decimate(AudioFIFO& fifo)
+{
+    int const factor = decimator.getFactor();
+    int const maxNumOutputSamples = juce::jmin(decimatedFIFO.getNumSamplesFree(), decimationBuffer.getNumSamples()) - 1;
+    int const numInputSamples = juce::jmin(fifo.getNumSamplesStored(), maxNumOutputSamples * factor);
+    if (numInputSamples <= 0)
+    {
+        return;
+    }
+
+    int numOutputSamples = 0;
+    int const numChannels = juce::jmin(fifo.getNumChannels(), decimationBuffer.getNumChannels(), decimatedFIFO.getNumChannels());
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto view = fifo.getReadView(channel, numInputSamples);
+        auto output = decimationBuffer.getWritePointer(channel);
+        numOutputSamples = decimator.process(channel, view.firstData, view.firstCount, output);
+        numOutputSamples += decimator.process(channel, view.secondData, view.secondCount, output + numOutputSamples);
+    }
+
+    consumeInput(fifo, numInputSamples);
+    decimatedFIFO.write(decimationBuffer, 0, numOutputSamples);
+}
+
+void SpectrumAnalyser::consumeInput(AudioFIFO& fifo, int numSamples)
+{
+    fifo.advanceReadPosition(numSamples);
+
+    if (&fifo == &decimatedFIFO)
+    {
+        decimatedSamplesConsumed += numSamples;
+    }
+    else
+    {
+        inputSamplesConsumed += numSamples;
+    }
+}
+
+void SpectrumAnalyser::noteInputBlock(int numSamplesWritten, int64_t arrivalTicks)
+{
+    if (numSamplesWritten <= 0)
+    {
+        return;
+    }
+
+    inputSamplesWritten += numSamplesWritten;
+    blockArrivals.emplace(BlockArrival{ inputSamplesWritten, arrivalTicks });
+}
+
+void SpectrumAnalyser::stampOutput(ProcessorOutput& processorOutput, AudioFIFO const& fifo, int frameLength)
+{
+    //
+    // Decimated sample n came out of the decimator once it had taken input samples up to
+    // decimatedStreamStart + (n + 1) * factor - 1
+    //
+    int64_t lastSamplePosition = inputSamplesConsumed + frameLength - 1;
+    if (&fifo == &decimatedFIFO)
+    {
+        lastSamplePosition = decimatedStreamStart + (decimatedSamplesConsumed + frameLength) * decimator.getFactor() - 1;
+    }
+
+    processorOutput.lastSamplePosition = lastSamplePosition;
+
+    //
+    // Skip the blocks that ended before the last sample; the next block holds it, unless its arrival hasn't
+    // been noted yet
+    //
+    processorOutput.blockArrivalTicks = 0;
+    while (auto arrival = blockArrivals.getReadPointer())
+    {
+        if (arrival->endPosition > lastSamplePosition)
+        {
+            processorOutput.blockArrivalTicks = arrival->ticks;
+            break;
+        }
+
+        blockArrivals.advanceReadPosition();
+    }
+}
+
+int SpectrumAnalyser::runAnalysisEngine(AudioFIFO& fifo, int maxNumSpectra)
+{
+    //
+    // The FFT needs a full frame in the input FIFO; the sliding DFT keeps its own history and only needs one hop
+    //
+    int numSpectra = 0;
+    if (currentAnalysisEngine == AnalysisEngine::slidingDFT)
+    {
+        while (numSpectra < maxNumSpectra && fifo.getNumSamplesStored() >= analysisHopSize)
+        {
+            processSlidingDFT(fifo);
+            ++numSpectra;
+        }
+
+        return numSpectra;
+    }
+
+    while (numSpectra < maxNumSpectra && fifo.getNumSamplesStored() >= fftPlan->getSize())
+    {
+        processFFT(fifo);
+        ++numSpectra;
+    }
+
+    return numSpectra;
+}
+void SpectrumAnalyser::processFFT(AudioFIFO& fifo)
+{
+    int const fftSize = fftPlan->getSize();
+    auto processorOutput = outputFIFO.getWritePointer(fftSize);
+    processorOutput->hertzPerBin = analysisSampleRate / fftSize;
+
+    int const numChannels = getNumAnalysisChannels(fifo);
+    prepareOutput(*processorOutput, numChannels);
+
+    //
+    // In real pair mode, each pair of channels shares one complex FFT; any odd channel left over gets its
+    // own FFT. Each pair is a separate task for the channel workers.
+    //
+    int const channelsPerTask = realPairFFT.load(std::memory_order_relaxed) ? 2 : 1;
+    int const numTasks = (numChannels + channelsPerTask - 1) / channelsPerTask;
+    auto const windowTable = fftPlan->windowTable.getData();
+
+    auto analyseChannels = [&](int task, int slot)
+    {
+        RealtimeSafetyMonitor::ScopedRealtimeSection realtimeSection{ "processFFT" };
+
+        int const firstChannel = task * channelsPerTask;
+        int const endChannel = juce::jmin(numChannels, firstChannel + channelsPerTask);
+
+        //
+        // Apply the windowing function directly from the input ring into the FFT work buffer;
+        // no need to copy the samples out of the ring first
+        //
+        for (int channel = firstChannel; channel < endChannel; ++channel)
+        {
+            auto view = fifo.getReadView(channel, fftSize);
+            auto fftData = channelPointers[(size_t)channel].fftData;
+            juce::FloatVectorOperations::multiply(fftData, view.firstData, windowTable, view.firstCount);
+            juce::FloatVectorOperations::multiply(fftData + view.firstCount, view.secondData, windowTable + view.firstCount, view.secondCount);
+        }
+
+        //
+        // Both transforms take the magnitude of the complex FFT output, and neither allocates
+        //
+        if (endChannel - firstChannel == 2)
+        {
+            fftPlan->performRealPairMagnitudeTransform(channelPointers[(size_t)firstChannel].fftData,
+                channelPointers[(size_t)firstChannel + 1].fftData,
+                complexWorkBuffer + firstChannel * FFTPlans::maxSize * 2,
+                slot);
+        }
+        else
+        {
+            fftPlan->performMagnitudeTransform(channelPointers[(size_t)firstChannel].fftData,
+                complexWorkBuffer + firstChannel * FFTPlans::maxSize * 2,
+                slot);
+        }
+
+        for (int channel = firstChannel; channel < endChannel; ++channel)
+        {
+            publishChannel(channel);
+        }
+    };
+
+    channelWorkers.run(numTasks, analyseChannels);
+
+    stampOutput(*processorOutput, fifo, fftSize);
+
+    //
+    // Only partially advance the read count for the ring so the next FFT overlaps
+    //
+    consumeInput(fifo, analysisHopSize);
+
+    advanceHistory();
+
+    outputFIFO.advanceWritePosition();
+}
+
+void SpectrumAnalyser::processSlidingDFT(AudioFIFO& fifo)
+{
+    int const fftSize = fftPlan->getSize();
+    auto processorOutput = outputFIFO.getWritePointer(fftSize);
+    processorOutput->hertzPerBin = analysisSampleRate / fftSize;
+
+    int const numChannels = juce::jmin(getNumAnalysisChannels(fifo), slidingDFT.getNumChannels());
+    prepareOutput(*processorOutput, numChannels);
+
+    //
+    // Recompute the bins with a full FFT once per frame so rounding errors in the recursion don't build up
+    //
+    samplesSinceResync += analysisHopSize;
+    bool const resync = samplesSinceResync >= fftSize;
+    if (resync)
+    {
+        samplesSinceResync = 0;
+    }
+
+    //
+    // Push one hop of samples straight from the input ring, then write the windowed magnitudes into the
+    // FFT work buffer so the rest of the analysis is the same as for the FFT
+    //
+    auto analyseChannel = [&](int channel, int slot)
+    {
+        RealtimeSafetyMonitor::ScopedRealtimeSection realtimeSection{ "processSlidingDFT" };
+
+        auto view = fifo.getReadView(channel, analysisHopSize);
+        slidingDFT.pushSamples(channel, view.firstData, view.firstCount);
+        slidingDFT.pushSamples(channel, view.secondData, view.secondCount);
+
+        if (resync)
+        {
+            slidingDFT.resync(channel, fftPlan->getFFT(slot), complexWorkBuffer + channel * FFTPlans::maxSize * 2);
+        }
+
+        slidingDFT.getMagnitudes(channel, channelPointers[(size_t)channel].fftData);
+
+        publishChannel(channel);
+    };
+
+    channelWorkers.run(numChannels, analyseChannel);
+
+    stampOutput(*processorOutput, fifo, analysisHopSize);
+
+    consumeInput(fifo, analysisHopSize);
+
+    advanceHistory();
+
+    outputFIFO.advanceWritePosition();
+}
+
+void SpectrumAnalyser::advanceHistory()
+{
+    if (spectraSinceHistoryColumn == 0)
+    {
+        history.advanceWritePosition();
+    }
+
+    spectraSinceHistoryColumn = (spectraSinceHistoryColumn + 1) % historyStride;
+}
+
+int SpectrumAnalyser::getNumAnalysisChannels(AudioFIFO const& fifo) const
+{
+    return juce::jmin(fifo.getNumChannels(), fftWorkBuffer.getNumChannels(), averagingSpectrum.getNumChannels());
+}
+
+void SpectrumAnalyser::prepareOutput(ProcessorOutput& processorOutput, int numChannels)
+{
+    auto const& bandMap = bandMaps->getMap(fftPlan->order, decimator.getFactor());
+    int const numBands = bandMap.getNumBands();
+    processorOutput.bands.setSize(numChannels, numBands, false, false, true /* avoidReallocating */);
+    processorOutput.averageBands.setSize(numChannels, numBands, false, false, true /* avoidReallocating */);
+
+    for (int band = 0; band < numBands; ++band)
+    {
+        processorOutput.bandCentreFrequencies[(size_t)band] = bandMap.getCentreFrequency(band);
+    }
+
+    processorOutput.numFeatureChannels = numChannels;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto& pointers = channelPointers[(size_t)channel];
+        pointers.fftData = fftWorkBuffer.getWritePointer(channel);
+        pointers.state =
+        {
+            averagingSpectrum.getWritePointer(channel),
+            fastAveragingSpectrum.getWritePointer(channel),
+            slowAveragingSpectrum.getWritePointer(channel),
+            peakHoldSpectrum.getWritePointer(channel),
+            minimumHoldSpectrum.getWritePointer(channel),
+            envelopeSpectrum.getWritePointer(channel)
+        };
+        pointers.bands = processorOutput.bands.getWritePointer(channel);
+        pointers.averageBands = processorOutput.averageBands.getWritePointer(channel);
+        pointers.previousSpectrum = previousSpectrum.getWritePointer(channel);
+        pointers.features = &processorOutput.features[(size_t)channel];
+
+        //
+        // For the compact transport formats, work out the float spectra in the transport buffer and encode
+        // them into the output once they're done
+        //
+        std::array<float*, ProcessorOutput::numSpectra> spectra;
+        if (processorOutput.transportFormat == TransportFormat::float32)
+        {
+            auto outputSpectra = processorOutput.getSpectra();
+            for (size_t index = 0; index < spectra.size(); ++index)
+            {
+                spectra[index] = outputSpectra[index]->getWritePointer(channel);
+                pointers.compactSpectra[index] = nullptr;
+            }
+        }
+        else
+        {
+            for (size_t index = 0; index < spectra.size(); ++index)
+            {
+                spectra[index] = transportBuffer.getWritePointer(channel * ProcessorOutput::numSpectra + (int)index);
+                pointers.compactSpectra[index] = processorOutput.compactSpectra[index].getWritePointer(channel);
+            }
+        }
+
+        pointers.spectrum = spectra[0];
+        pointers.output = { spectra[1], spectra[2], spectra[3], spectra[4], spectra[5], spectra[6] };
+    }
+}
+
+void SpectrumAnalyser::publishChannel(int channel)
+{
+    auto const& pointers = channelPointers[(size_t)channel];
+
+    //
+    // Normalize, average, hold, and publish in one pass
+    //
+    SpectrumKernels::normaliseAndApplyBallistics(pointers.fftData,
+        pointers.spectrum,
+        pointers.state,
+        pointers.output,
+        fftPlan->getSize() / 2 + 1,
+        fftPlan->normalizationScale,
+        ballisticWeights);
+
+    //
+    // Sum the bins into log-frequency bands
+    //
+    auto const& bandMap = bandMaps->getMap(fftPlan->order, decimator.getFactor());
+    bandMap.apply(pointers.spectrum, pointers.bands);
+    bandMap.apply(pointers.output.average, pointers.averageBands);
+
+    extractFeatures(channel);
+
+    if (spectraSinceHistoryColumn == 0)
+    {
+        history.write(channel, pointers.spectrum);
+    }
+
+    if (pointers.compactSpectra[0] != nullptr)
+    {
+        int const numBins = fftPlan->getSize() / 2 + 1;
+        std::array<float const*, ProcessorOutput::numSpectra> const spectra{ pointers.spectrum,
+            pointers.output.average, pointers.output.fast, pointers.output.slow,
+            pointers.output.peak, pointers.output.minimum, pointers.output.envelope };
+
+        for (size_t index = 0; index < spectra.size(); ++index)
+        {
+            SpectrumKernels::encodeLogMagnitude16(spectra[index], pointers.compactSpectra[index], numBins);
+        }
+    }
+}
+
+void SpectrumAnalyser::extractFeatures(int channel)
+{
+    auto const& pointers = channelPointers[(size_t)channel];
+    auto& features = *pointers.features;
+    auto& state = featureStates[(size_t)channel];
+    int const fftSize = fftPlan->getSize();
+
+    auto sums = SpectrumKernels::sumSpectrum(pointers.spectrum, pointers.previousSpectrum, fftSize / 2 + 1);
+
+    features.rms = std::sqrt(sums.energy / (2.0f * fftPlan->noiseBandwidthBins));
+    features.centroidHertz = sums.magnitude > 0.0f ? sums.weightedMagnitude / sums.magnitude * (float)(analysisSampleRate / fftSize) : 0.0f;
+
+    for (int band = 0; band < SpectrumFeatures::numBands; ++band)
+    {
+        int const firstBin = featureBandBins[(size_t)band];
+        int const numBandBins = featureBandBins[(size_t)band + 1] - firstBin;
+        features.bandLevels[(size_t)band] = std::sqrt(SpectrumKernels::sumSquares(pointers.output.average + firstBin, numBandBins));
+    }
+
+    //
+    // Onsets are flux peaks well above the recent average, at most one per hold-off time
+    //
+    features.flux = state.primed ? sums.flux : 0.0f;
+    features.onset = state.primed
+        && state.spectraSinceOnset >= onsetHoldOffSpectra
+        && features.flux > state.averageFlux * onsetThreshold + minimumOnsetFlux;
+
+    state.spectraSinceOnset = features.onset ? 0 : juce::jmin(state.spectraSinceOnset + 1, onsetHoldOffSpectra);
+    state.averageFlux = state.averageFlux * averageFluxWeight + features.flux * (1.0f - averageFluxWeight);
+    state.primed = true;
+}
+
+#if RUN_UNIT_TESTS
+
+SpectrumAnalyserTest::SpectrumAnalyserTest() : UnitTest("SpectrumAnalyserTest")
+{
+}
+
+void SpectrumAnalyserTest::runTest()
+{
+    double constexpr sampleRate = 48000.0;
+    int constexpr fftOrder = 10;
+    int constexpr fftSize = 1 << fftOrder;
+    double constexpr toneFrequency = 1500.0;
+
+    SpectrumAnalyser analyser;
+    analyser.setFFTOrder(fftOrder);
+    analyser.prepare(sampleRate, 1, 0);
+    analyser.update();
+
+    AudioFIFO fifo;
+    fifo.setSize(1, FFTPlans::maxSize * 2);
+    fifo.reset(0);
+
+    juce::AudioBuffer<float> chunk{ 1, fftSize };
+    double phase = 0.0;
+    auto feedTone = [&](int numSamples, float amplitude = 0.5f, float amplitudeStep = 0.0f)
+    {
+        int numSpectra = 0;
+        while (numSamples > 0)
+        {
+            int const numChunkSamples = juce::jmin(numSamples, chunk.getNumSamples());
+            for (int index = 0; index < numChunkSamples; ++index)
+            {
+                chunk.setSample(0, index, amplitude * (float)std::sin(phase));
+                phase += juce::MathConstants<double>::twoPi * toneFrequency / sampleRate;
+                amplitude += amplitudeStep;
+            }
+
+            fifo.write(chunk, 0, numChunkSamples);
+            numSpectra += analyser.analyse(fifo);
+            numSamples -= numChunkSamples;
+        }
+        return numSpectra;
+    };
+
+    std::vector<float> magnitudes((size_t)fftSize / 2 + 1);
+    int const toneBin = juce::roundToInt(toneFrequency * fftSize / sampleRate);
+    auto getAverageAtTone = [&]()
+    {
+        auto output = analyser.outputFIFO.getMostRecent();
+        output->readSpectrum(1, 0, magnitudes.data());
+        return magnitudes[(size_t)toneBin];
+    };
+
+    {
+        beginTest("Hop size follows the overlap");
+
+        expectEquals(analyser.getHopSize(), fftSize / 4);
+
+        analyser.setOverlapPercent(0.0f);
+        analyser.update();
+        expectEquals(analyser.getHopSize(), fftSize);
+
+        analyser.setOverlapPercent(100.0f);
+        analyser.update();
+        expectEquals(analyser.getHopSize(), fftSize / 16);
+
+        analyser.setOverlapPercent(SpectrumAnalyser::defaultOverlapPercent);
+        analyser.update();
+        expectEquals(analyser.getHopSize(), fftSize / 4);
+        expectEquals(analyser.getFFTSize(), fftSize);
+    }
+
+    {
+        beginTest("Overlap change keeps the averages");
+
+        //
+        // Let the average settle, then raise the overlap mid-stream; the next spectrum carries on from the
+        // settled average instead of starting again from zero, and the average settles at the same level
+        //
+        int const numSettleSamples = (int)sampleRate;
+        int numSpectra = feedTone(numSettleSamples);
+        expectWithinAbsoluteError(numSpectra, numSettleSamples / (fftSize / 4), 4);
+
+        auto const settledAverage = getAverageAtTone();
+        expect(settledAverage > 0.1f);
+
+        analyser.setOverlapPercent(SpectrumAnalyser::maxOverlapPercent);
+        analyser.update();
+        expectEquals(analyser.getHopSize(), fftSize / 16);
+
+        int numNewSpectra = 0;
+        while (numNewSpectra == 0)
+        {
+            numNewSpectra = feedTone(fftSize / 16);
+        }
+
+        expectEquals(numNewSpectra, 1);
+        expectWithinAbsoluteError(getAverageAtTone(), settledAverage, settledAverage * 0.01f);
+
+        numSpectra = feedTone(numSettleSamples);
+        expectWithinAbsoluteError(numSpectra, numSettleSamples / (fftSize / 16), 4);
+        expectWithinAbsoluteError(getAverageAtTone(), settledAverage, settledAverage * 0.01f);
+    }
+
+    {
+        beginTest("Features");
+
+        auto reader = analyser.outputFIFO.createReader();
+        ProcessorOutput output;
+        int numOutputs = 0, numOnsets = 0;
+
+        //
+        // Read in steps small enough that the reader doesn't miss any outputs. The amplitude follows a raised
+        // cosine from amplitude to endAmplitude, a line segment per step.
+        //
+        auto feedAndReadFeatures = [&](int numSamples, float amplitude, float endAmplitude)
+        {
+            auto getAmplitude = [&](int sample)
+            {
+                auto fade = 0.5f + 0.5f * std::cos(juce::MathConstants<float>::pi * (float)juce::jmin(sample, numSamples) / (float)numSamples);
+                return endAmplitude + (amplitude - endAmplitude) * fade;
+            };
+
+            for (int sample = 0; sample < numSamples; sample += fftSize)
+            {
+                auto startAmplitude = getAmplitude(sample);
+                feedTone(fftSize, startAmplitude, (getAmplitude(sample + fftSize) - startAmplitude) / (float)fftSize);
+
+                while (reader->read(output))
+                {
+                    expectEquals(output.numFeatureChannels, 1);
+                    numOnsets += output.features[0].onset ? 1 : 0;
+                    ++numOutputs;
+                }
+            }
+        };
+
+        //
+        // A steady tone; the RMS comes from the spectrum energy, the centroid sits on the tone, and the
+        // level is all in the low mids
+        //
+        feedAndReadFeatures(fftSize * 4, 0.5f, 0.5f);
+        expect(numOutputs > 0);
+        expectEquals(numOnsets, 0);
+
+        auto const& features = output.features[0];
+        expectWithinAbsoluteError(features.rms, 0.5f / std::sqrt(2.0f), 0.01f);
+        expectWithinAbsoluteError(features.centroidHertz, (float)toneFrequency, 10.0f);
+        expect(features.bandLevels[1] > 0.4f);
+        expect(features.bandLevels[0] < 0.01f && features.bandLevels[2] < 0.01f && features.bandLevels[3] < 0.01f);
+
+        //
+        // Fade the tone out smoothly and hold silence; the flux only counts rising bins, so the release isn't
+        // an onset. The tone coming straight back in is.
+        //
+        feedAndReadFeatures((int)sampleRate, 0.5f, 0.0f);
+        feedAndReadFeatures((int)sampleRate / 2, 0.0f, 0.0f);
+        expectEquals(numOnsets, 0);
+        expectEquals(output.features[0].rms, 0.0f);
+        expectEquals(output.features[0].centroidHertz, 0.0f);
+
+        feedAndReadFeatures((int)sampleRate / 2, 0.5f, 0.5f);
+        expectEquals(numOnsets, 1);
+    }
+
+    {
+        beginTest("History covers the set length");
+
+        //
+        // One second of history has to hold a second of spectra at the highest overlap, and with the sliding
+        // DFT hopping by a few samples
+        //
+        SpectrumAnalyser historyAnalyser;
+        historyAnalyser.setFFTOrder(fftOrder);
+        historyAnalyser.setHistoryLength(1.0);
+        historyAnalyser.setOverlapPercent(SpectrumAnalyser::maxOverlapPercent);
+        historyAnalyser.prepare(sampleRate, 1, 0);
+
+        AudioFIFO historyFIFO;
+        historyFIFO.setSize(1, FFTPlans::maxSize * 2);
+        historyFIFO.reset(0);
+
+        juce::AudioBuffer<float> silence{ 1, fftSize };
+        silence.clear();
+
+        for (auto engine : { AnalysisEngine::fft, AnalysisEngine::slidingDFT })
+        {
+            historyAnalyser.setAnalysisEngine(engine);
+            historyAnalyser.setSlidingDFTHopSize(4);
+            historyAnalyser.update();
+
+            auto const firstColumn = historyAnalyser.history.getNumColumnsWritten();
+            for (int sample = 0; sample < (int)sampleRate; sample += fftSize)
+            {
+                historyFIFO.write(silence, 0, fftSize);
+                historyAnalyser.analyse(historyFIFO);
+            }
+
+            auto const numColumnsWritten = (int)(historyAnalyser.history.getNumColumnsWritten() - firstColumn);
+            expect(numColumnsWritten > 0);
+            expect(numColumnsWritten <= historyAnalyser.history.getNumColumns(),
+                juce::String{ numColumnsWritten } + " columns in a second, room for " + juce::String{ historyAnalyser.history.getNumColumns() });
+        }
+    }
+
+    {
+        beginTest("Timestamps");
+
+        SpectrumAnalyser timedAnalyser;
+        timedAnalyser.setFFTOrder(fftOrder);
+        timedAnalyser.prepare(sampleRate, 1, 0);
+
+        auto reader = timedAnalyser.outputFIFO.createReader();
+        ProcessorOutput output;
+
+        //
+        // Feed host-sized blocks, noting when each one arrived, and check every output against the blocks
+        //
+        int constexpr blockSize = 256;
+        std::vector<int64_t> blockArrivalTicks;
+        int64_t numSamplesWritten = 0;
+        int numOutputs = 0;
+
+        auto feedBlocks = [&](int numBlocks, int expectedStep)
+        {
+            int64_t previousPosition = -1;
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                for (int index = 0; index < blockSize; ++index)
+                {
+                    chunk.setSample(0, index, 0.5f * (float)std::sin(phase));
+                    phase += juce::MathConstants<double>::twoPi * toneFrequency / sampleRate;
+                }
+
+                blockArrivalTicks.push_back(juce::Time::getHighResolutionTicks());
+                timedAnalyser.noteInputBlock(fifo.write(chunk, 0, blockSize), blockArrivalTicks.back());
+                numSamplesWritten += blockSize;
+
+                timedAnalyser.update();
+                timedAnalyser.analyse(fifo);
+
+                while (reader->read(output))
+                {
+                    ++numOutputs;
+
+                    expect(output.lastSamplePosition >= 0 && output.lastSamplePosition < numSamplesWritten);
+                    expectEquals(output.blockArrivalTicks, blockArrivalTicks[(size_t)(output.lastSamplePosition / blockSize)]);
+                    expect(output.publishTicks >= output.blockArrivalTicks);
+                    expectEquals(output.firstPaintTicks, (int64_t)0);
+
+                    if (previousPosition >= 0)
+                    {
+                        expectEquals(output.lastSamplePosition - previousPosition, (int64_t)expectedStep);
+                    }
+                    previousPosition = output.lastSamplePosition;
+                }
+            }
+        };
+
+        fifo.reset(0);
+        feedBlocks(fftSize / blockSize, fftSize / 4);
+        expectEquals(numOutputs, 1);
+        expectEquals(output.lastSamplePosition, (int64_t)fftSize - 1);
+
+        feedBlocks(16, fftSize / 4);
+
+        //
+        // Decimated by 8, each decimated hop covers 8 times as many input samples
+        //
+        timedAnalyser.setMaximumDisplayFrequency(2000.0);
+        feedBlocks(64, fftSize / 4 * 8);
+
+        timedAnalyser.setMaximumDisplayFrequency(0.0);
+        timedAnalyser.setAnalysisEngine(AnalysisEngine::slidingDFT);
+        timedAnalyser.setSlidingDFTHopSize(32);
+        feedBlocks(16, 32);
+
+        auto const& latencies = timedAnalyser.outputFIFO.latencies;
+        expectEquals(latencies.arrivalToPublish.getNumSamples(), (uint64_t)numOutputs);
+        expectEquals(latencies.publishToPaint.getNumSamples(), (uint64_t)0);
+
+        //
+        // Only the first paint of an output counts
+        //
+        auto mostRecent = timedAnalyser.outputFIFO.getMostRecent();
+        expect(mostRecent != nullptr);
+        timedAnalyser.outputFIFO.notePainted();
+        timedAnalyser.outputFIFO.notePainted();
+
+        expect(mostRecent->firstPaintTicks >= mostRecent->publishTicks);
+        expectEquals(latencies.publishToPaint.getNumSamples(), (uint64_t)1);
+        expectEquals(latencies.arrivalToPaint.getNumSamples(), (uint64_t)1);
+        expect(latencies.arrivalToPaint.getMaxSeconds() >= latencies.publishToPaint.getMaxSeconds());
+    }
+}
+
+SpectrumAnalyserBenchmark::SpectrumAnalyserBenchmark() : UnitTest("SpectrumAnalyserBenchmark")
+{
+}
+
+void SpectrumAnalyserBenchmark::runTest()
+{
+    beginTest("SpectrumAnalyserBenchmark");
+
+    //
+    // 7.1.4 at the largest FFT size, so the per-channel transforms dominate and the time should drop as
+    // workers are added
+    //
+    double constexpr sampleRate = 48000.0;
+    int constexpr numChannels = 12;
+    int constexpr blockSize = 512;
+    int constexpr numBlocks = 400;
+
+    juce::Random random;
+    juce::AudioBuffer<float> block{ numChannels, blockSize };
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        for (int index = 0; index < blockSize; ++index)
+        {
+            block.setSample(channel, index, random.nextFloat() * 2.0f - 1.0f);
+        }
+    }
+
+    logMessage(juce::String{ juce::SystemStats::getNumCpus() } + " CPUs");
+
+    double singleThreadSeconds = 0.0;
+    int singleThreadSpectra = 0;
+    for (int numWorkers : { 0, 1, 3, 7 })
+    {
+        SpectrumAnalyser analyser;
+        analyser.setFFTOrder(FFTPlans::maxOrder);
+        analyser.prepare(sampleRate, numChannels, numWorkers);
+        analyser.update();
+
+        AudioFIFO fifo;
+        fifo.setSize(numChannels, FFTPlans::maxSize * 2);
+        fifo.reset(0);
+
+        int numSpectra = 0;
+        auto startTicks = juce::Time::getHighResolutionTicks();
+        for (int blockIndex = 0; blockIndex < numBlocks; ++blockIndex)
+        {
+            fifo.write(block, 0, blockSize);
+            numSpectra += analyser.analyse(fifo);
+        }
+        auto seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        if (numWorkers == 0)
+        {
+            singleThreadSeconds = seconds;
+            singleThreadSpectra = numSpectra;
+        }
+
+        expect(numSpectra > 0);
+        expectEquals(numSpectra, singleThreadSpectra);
+        logMessage(juce::String{ numWorkers } + " workers: " + juce::String{ seconds * 1000.0, 1 } + " ms, "
+            + juce::String{ singleThreadSeconds / seconds, 2 } + "x");
+    }
+}
+
+#endif
@@ -0,0 +1,341 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioFIFO.h"
+#include "FIFO.h"
+#include "Spectrum.h"
+#include "ProcessorOutputFIFO.h"
+#include "FFTPlans.h"
+#include "SlidingDFT.h"
+#include "Decimator.h"
+#include "SpectrumKernels.h"
+#include "RealtimeSafetyMonitor.h"
+#include "WorkerPool.h"
+#include "SpectrogramHistory.h"
+
+//
+// fft windows and transforms a full frame every hop
+//
+// slidingDFT updates the bins for every new sample and publishes a spectrum every slidingDFTHopSize
+// samples; cheaper per spectrum for short hops
+//
+enum class AnalysisEngine
+{
+    fft,
+    slidingDFT
+};
+
+//
+// The analysis pipeline shared by the plugin and the offline analyser: optional decimation, the FFT or
+// sliding DFT, ballistics, and the log-frequency bands, published to outputFIFO
+//
+// prepare() allocates everything for the largest FFT size. update() and analyse() run on the thread that
+// consumes the input FIFO and never allocate; the setters can be called from any thread at any time and
+// are picked up by the next update().
+//
+// Each output is stamped with the position of its last input sample. The thread writing the input FIFO
+// reports each write with noteInputBlock(), so the output also gets the time that sample arrived.
+//
+class SpectrumAnalyser
+{
+public:
+    SpectrumAnalyser();
+    ~SpectrumAnalyser();
+
+    //
+    // The analysis follows the main bus layout, up to 7.1.4 and 16 discrete channels
+    //
+    static constexpr int maxNumChannels = 16;
+    static_assert(maxNumChannels <= ProcessorOutput::maxNumFeatureChannels);
+
+    //
+    // numWorkers extra threads share the per-channel work with the thread that calls analyse()
+    //
+    void prepare(double sampleRate, int numChannels, int numWorkers);
+    void release();
+
+    void setFFTOrder(int order)
+    {
+        fftOrder = order;
+    }
+
+    //
+    // Run the FFTs for each pair of channels as one complex FFT
+    //
+    void setRealPairFFT(bool shouldPairChannels)
+    {
+        realPairFFT = shouldPairChannels;
+    }
+
+    void setAnalysisEngine(AnalysisEngine engine)
+    {
+        analysisEngine = engine;
+    }
+
+    void setSlidingDFTHopSize(int hopSize)
+    {
+        slidingDFTHopSize = hopSize;
+    }
+
+    //
+    // Overlap between successive FFT frames, from 0 to maxOverlapPercent. Picked up at the next hop without
+    // reallocating or clearing the averages; the ballistic weights follow the new hop rate.
+    //
+    void setOverlapPercent(float percent)
+    {
+        overlapPercent = percent;
+    }
+
+    static constexpr float defaultOverlapPercent = 75.0f;
+    static constexpr float maxOverlapPercent = 93.75f;
+
+    //
+    // Highest frequency any display needs; the analysis decimates the input as far as it can while
+    // keeping this frequency. Zero analyses the full band.
+    //
+    void setMaximumDisplayFrequency(double frequency)
+    {
+        maximumDisplayFrequency = frequency;
+    }
+
+    //
+    // Message thread; the band maps for the new layout are built here and picked up by update().
+    // The replaced maps are freed by freeRetiredBandMaps().
+    //
+    void setBandLayout(BandMap::Layout const& layout);
+    void freeRetiredBandMaps();
+
+    //
+    // Format for the spectra in outputFIFO; takes effect on the next call to prepare()
+    //
+    void setTransportFormat(TransportFormat format)
+    {
+        transportFormat = format;
+    }
+
+    //
+    // Length of the spectrogram history; takes effect on the next call to prepare()
+    //
+    void setHistoryLength(double seconds)
+    {
+        historySeconds = seconds;
+    }
+
+    //
+    // Picks up any changed settings; call before analyse()
+    //
+    void update();
+
+    //
+    // Publishes a spectrum for each full hop in the FIFO, up to maxNumSpectra; returns the number of
+    // spectra published
+    //
+    int analyse(AudioFIFO& fifo, int maxNumSpectra = std::numeric_limits<int>::max());
+
+    //
+    // Thread writing the input FIFO; call after each write with the number of samples the FIFO took and
+    // juce::Time::getHighResolutionTicks() from when the host block arrived
+    //
+    void noteInputBlock(int numSamplesWritten, int64_t arrivalTicks);
+
+    int getFFTSize() const
+    {
+        return currentFFTSize.load(std::memory_order_relaxed);
+    }
+
+    int getHopSize() const
+    {
+        return analysisHopSize;
+    }
+
+    double getAnalysisSampleRate() const
+    {
+        return analysisSampleRate;
+    }
+
+    ProcessorOutputFIFO outputFIFO;
+
+    //
+    // The spectra quantised to 8-bit decibels, holding at least the history length at any overlap; the
+    // sliding DFT with short hops only keeps every few spectra. Cleared whenever the analysis settings
+    // change.
+    //
+    SpectrogramHistory<uint8_t> history;
+
+private:
+    double sampleRate = 48000.0;
+    FFTPlans fftPlans;
+    FFTPlans::Plan const* fftPlan = nullptr;
+    std::atomic<int> fftOrder = FFTPlans::defaultOrder;
+    std::atomic<int> currentFFTSize = 0;
+    int analysisHopSize = 0;
+    juce::AudioBuffer<float> fftWorkBuffer;
+    juce::HeapBlock<std::complex<float>> complexWorkBuffer;
+    std::atomic<bool> realPairFFT = true;
+    WorkerPool channelWorkers;
+    SlidingDFT slidingDFT;
+    std::atomic<AnalysisEngine> analysisEngine = AnalysisEngine::fft;
+    std::atomic<int> slidingDFTHopSize = 32;
+    AnalysisEngine currentAnalysisEngine = AnalysisEngine::fft;
+    int samplesSinceResync = 0;
+    Decimator decimator;
+    AudioFIFO decimatedFIFO;
+    juce::AudioBuffer<float> decimationBuffer;
+    std::atomic<double> maximumDisplayFrequency = 0.0;
+    double analysisSampleRate = 48000.0;
+
+    //
+    // Running state for the averaged and held spectra; allocated for the largest FFT size in prepare()
+    //
+    RealSpectrum<float> averagingSpectrum;
+    RealSpectrum<float> fastAveragingSpectrum;
+    RealSpectrum<float> slowAveragingSpectrum;
+    RealSpectrum<float> peakHoldSpectrum;
+    RealSpectrum<float> minimumHoldSpectrum;
+    RealSpectrum<float> envelopeSpectrum;
+    RealSpectrum<float> previousSpectrum;
+    SpectrumKernels::BallisticTimes const ballisticTimes;
+    SpectrumKernels::BallisticWeights ballisticWeights;
+    std::atomic<float> overlapPercent = defaultOverlapPercent;
+    double historySeconds = 10.0;
+    int historyStride = 1;
+    int spectraSinceHistoryColumn = 0;
+    TransportFormat transportFormat = TransportFormat::float32;
+
+    //
+    // With a compact transport format, the float spectra are worked out here and encoded into the output;
+    // ProcessorOutput::numSpectra channels per analysis channel
+    //
+    juce::AudioBuffer<float> transportBuffer;
+
+    //
+    // Feature stage; the flux average and onset hold-off carry over from one spectrum to the next
+    //
+    struct FeatureState
+    {
+        float averageFlux = 0.0f;
+        int spectraSinceOnset = 0;
+        bool primed = false;
+    };
+
+    std::array<FeatureState, maxNumChannels> featureStates;
+    std::array<int, SpectrumFeatures::numBands + 1> featureBandBins{};
+    float averageFluxWeight = 0.0f;
+    int onsetHoldOffSpectra = 1;
+    static constexpr float averageFluxSeconds = 0.25f;
+    static constexpr float onsetHoldOffSeconds = 0.05f;
+    static constexpr float onsetThreshold = 2.0f;
+    static constexpr float minimumOnsetFlux = 1.0e-3f;
+
+    //
+    // Input stream positions; samples consumed from the input FIFO, and for the decimated FIFO, the input
+    // position when it was last reset and the samples consumed since then
+    //
+    int64_t inputSamplesConsumed = 0;
+    int64_t decimatedStreamStart = 0;
+    int64_t decimatedSamplesConsumed = 0;
+
+    //
+    // Written by noteInputBlock(); each entry is the input position just past the end of a block and the
+    // time the block arrived. If the analysis falls far enough behind that this fills up, the outputs for
+    // the blocks that didn't fit get the next block's arrival time.
+    //
+    struct BlockArrival
+    {
+        int64_t endPosition = 0;
+        int64_t ticks = 0;
+    };
+
+    FIFO<BlockArrival, 256> blockArrivals;
+    int64_t inputSamplesWritten = 0;
+
+    BandMap::Layout bandLayout;
+    std::unique_ptr<BandMaps> bandMaps;
+    std::atomic<BandMaps*> pendingBandMaps = nullptr;
+    std::atomic<BandMaps*> retiredBandMaps = nullptr;
+
+    void updateBandMaps();
+    void selectAnalysis(int order, AnalysisEngine engine, int decimationFactor);
+    int chooseHopSize() const;
+    static int getFFTHopSize(int fftSize, float overlapPercent);
+    static double getMaxHistoryValuesPerSample();
+    void setHopSize(int hopSize);
+    void advanceHistory();
+    void decimate(AudioFIFO& fifo);
+    int runAnalysisEngine(AudioFIFO& fifo, int maxNumSpectra);
+    void processFFT(AudioFIFO& fifo);
+    void processSlidingDFT(AudioFIFO& fifo);
+    void consumeInput(AudioFIFO& fifo, int numSamples);
+    void stampOutput(ProcessorOutput& processorOutput, AudioFIFO const& fifo, int frameLength);
+
+    //
+    // Per-channel pointers for the channel workers, filled in before each spectrum;
+    // juce::AudioBuffer::getWritePointer isn't safe to call from several threads at once
+    //
+    struct ChannelPointers
+    {
+        float* fftData = nullptr;
+        float* spectrum = nullptr;
+        SpectrumKernels::BallisticBins state;
+        SpectrumKernels::BallisticBins output;
+        float* bands = nullptr;
+        float* averageBands = nullptr;
+        float* previousSpectrum = nullptr;
+        SpectrumFeatures* features = nullptr;
+        std::array<uint16_t*, ProcessorOutput::numSpectra> compactSpectra{};
+    };
+
+    std::array<ChannelPointers, maxNumChannels> channelPointers;
+
+    int getNumAnalysisChannels(AudioFIFO const& fifo) const;
+    void prepareOutput(ProcessorOutput& processorOutput, int numChannels);
+    void publishChannel(int channel);
+    void extractFeatures(int channel);
+    std::array<RealSpectrum<float>*, 7> getRunningState();
+
+    JUCE_DECLARE_NON_COPYABLE(SpectrumAnalyser)
+};
+
+#if RUN_UNIT_TESTS
+
+class SpectrumAnalyserTest : public juce::UnitTest
+{
+public:
+    SpectrumAnalyserTest();
+
+    void runTest() override;
+};
+
+class SpectrumAnalyserBenchmark : public juce::UnitTest
+{
+public:
+    SpectrumAnalyserBenchmark();
+
+    void runTest() override;
+};
+
+#endif
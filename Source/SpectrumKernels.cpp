@@ -0,0 +1,770 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "SpectrumKernels.h"
+#include "Spectrum.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+#include <emmintrin.h>
+#elif JUCE_USE_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+static float getKeepWeight(float seconds, float spectraPerSecond)
+{
+    return juce::jmax(0.0f, 1.0f - 1.0f / (spectraPerSecond * seconds));
+}
+
+SpectrumKernels::BallisticWeights::BallisticWeights(BallisticTimes const& times, float spectraPerSecond) :
+    average(getKeepWeight(times.averageSeconds, spectraPerSecond)),
+    fast(getKeepWeight(times.fastSeconds, spectraPerSecond)),
+    slow(getKeepWeight(times.slowSeconds, spectraPerSecond)),
+    attack(getKeepWeight(times.attackSeconds, spectraPerSecond)),
+    release(getKeepWeight(times.releaseSeconds, spectraPerSecond)),
+    peakDecay(juce::Decibels::decibelsToGain(-times.peakDecayDecibelsPerSecond / spectraPerSecond))
+{
+}
+
+void SpectrumKernels::normaliseAndApplyBallistics(float const* fftMagnitudes,
+    float* spectrum,
+    BallisticBins const& state,
+    BallisticBins const& output,
+    int numBins,
+    float normalizationScale,
+    BallisticWeights const& weights)
+{
+    int bin = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+    auto const scaleVector = _mm_set1_ps(normalizationScale);
+    auto const averageWeight = _mm_set1_ps(weights.average);
+    auto const fastWeight = _mm_set1_ps(weights.fast);
+    auto const slowWeight = _mm_set1_ps(weights.slow);
+    auto const attackWeight = _mm_set1_ps(weights.attack);
+    auto const releaseWeight = _mm_set1_ps(weights.release);
+    auto const peakDecay = _mm_set1_ps(weights.peakDecay);
+
+    //
+    // state * weight + magnitude * (1 - weight) == magnitude + (state - magnitude) * weight
+    //
+    auto smooth = [](__m128 previous, __m128 magnitude, __m128 weight)
+    {
+        return _mm_add_ps(magnitude, _mm_mul_ps(_mm_sub_ps(previous, magnitude), weight));
+    };
+
+    auto store = [&](float* stateBins, float* outputBins, __m128 value)
+    {
+        _mm_storeu_ps(stateBins + bin, value);
+        _mm_storeu_ps(outputBins + bin, value);
+    };
+
+    for (; bin + 4 <= numBins; bin += 4)
+    {
+        auto magnitude = _mm_mul_ps(_mm_loadu_ps(fftMagnitudes + bin), scaleVector);
+        _mm_storeu_ps(spectrum + bin, magnitude);
+
+        store(state.average, output.average, smooth(_mm_loadu_ps(state.average + bin), magnitude, averageWeight));
+        store(state.fast, output.fast, smooth(_mm_loadu_ps(state.fast + bin), magnitude, fastWeight));
+        store(state.slow, output.slow, smooth(_mm_loadu_ps(state.slow + bin), magnitude, slowWeight));
+        store(state.peak, output.peak, _mm_max_ps(magnitude, _mm_mul_ps(_mm_loadu_ps(state.peak + bin), peakDecay)));
+        store(state.minimum, output.minimum, _mm_min_ps(magnitude, smooth(_mm_loadu_ps(state.minimum + bin), magnitude, slowWeight)));
+
+        auto envelope = _mm_loadu_ps(state.envelope + bin);
+        auto rising = _mm_cmpgt_ps(magnitude, envelope);
+        auto envelopeWeight = _mm_or_ps(_mm_and_ps(rising, attackWeight), _mm_andnot_ps(rising, releaseWeight));
+        store(state.envelope, output.envelope, smooth(envelope, magnitude, envelopeWeight));
+    }
+#elif JUCE_USE_ARM_NEON
+    auto const scaleVector = vdupq_n_f32(normalizationScale);
+    auto const averageWeight = vdupq_n_f32(weights.average);
+    auto const fastWeight = vdupq_n_f32(weights.fast);
+    auto const slowWeight = vdupq_n_f32(weights.slow);
+    auto const attackWeight = vdupq_n_f32(weights.attack);
+    auto const releaseWeight = vdupq_n_f32(weights.release);
+    auto const peakDecay = vdupq_n_f32(weights.peakDecay);
+
+    auto smooth = [](float32x4_t previous, float32x4_t magnitude, float32x4_t weight)
+    {
+        return vmlaq_f32(magnitude, vsubq_f32(previous, magnitude), weight);
+    };
+
+    auto store = [&](float* stateBins, float* outputBins, float32x4_t value)
+    {
+        vst1q_f32(stateBins + bin, value);
+        vst1q_f32(outputBins + bin, value);
+    };
+
+    for (; bin + 4 <= numBins; bin += 4)
+    {
+        auto magnitude = vmulq_f32(vld1q_f32(fftMagnitudes + bin), scaleVector);
+        vst1q_f32(spectrum + bin, magnitude);
+
+        store(state.average, output.average, smooth(vld1q_f32(state.average + bin), magnitude, averageWeight));
+        store(state.fast, output.fast, smooth(vld1q_f32(state.fast + bin), magnitude, fastWeight));
+        store(state.slow, output.slow, smooth(vld1q_f32(state.slow + bin), magnitude, slowWeight));
+        store(state.peak, output.peak, vmaxq_f32(magnitude, vmulq_f32(vld1q_f32(state.peak + bin), peakDecay)));
+        store(state.minimum, output.minimum, vminq_f32(magnitude, smooth(vld1q_f32(state.minimum + bin), magnitude, slowWeight)));
+
+        auto envelope = vld1q_f32(state.envelope + bin);
+        auto envelopeWeight = vbslq_f32(vcgtq_f32(magnitude, envelope), attackWeight, releaseWeight);
+        store(state.envelope, output.envelope, smooth(envelope, magnitude, envelopeWeight));
+    }
+#endif
+
+    //
+    // Leftover bins; with no SIMD support, this does all of them
+    //
+    if (bin < numBins)
+    {
+        auto offset = [bin](float* bins)
+        {
+            return bins + bin;
+        };
+
+        normaliseAndApplyBallisticsScalar(fftMagnitudes + bin,
+            spectrum + bin,
+            { offset(state.average), offset(state.fast), offset(state.slow), offset(state.peak), offset(state.minimum), offset(state.envelope) },
+            { offset(output.average), offset(output.fast), offset(output.slow), offset(output.peak), offset(output.minimum), offset(output.envelope) },
+            numBins - bin,
+            normalizationScale,
+            weights);
+    }
+}
+
+void SpectrumKernels::normaliseAndApplyBallisticsScalar(float const* fftMagnitudes,
+    float* spectrum,
+    BallisticBins const& state,
+    BallisticBins const& output,
+    int numBins,
+    float normalizationScale,
+    BallisticWeights const& weights)
+{
+    auto smooth = [](float previous, float magnitude, float weight)
+    {
+        return magnitude + (previous - magnitude) * weight;
+    };
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        auto magnitude = fftMagnitudes[bin] * normalizationScale;
+        spectrum[bin] = magnitude;
+
+        output.average[bin] = state.average[bin] = smooth(state.average[bin], magnitude, weights.average);
+        output.fast[bin] = state.fast[bin] = smooth(state.fast[bin], magnitude, weights.fast);
+        output.slow[bin] = state.slow[bin] = smooth(state.slow[bin], magnitude, weights.slow);
+        output.peak[bin] = state.peak[bin] = juce::jmax(magnitude, state.peak[bin] * weights.peakDecay);
+        output.minimum[bin] = state.minimum[bin] = juce::jmin(magnitude, smooth(state.minimum[bin], magnitude, weights.slow));
+
+        auto envelopeWeight = magnitude > state.envelope[bin] ? weights.attack : weights.release;
+        output.envelope[bin] = state.envelope[bin] = smooth(state.envelope[bin], magnitude, envelopeWeight);
+    }
+}
+
+#if JUCE_USE_SSE_INTRINSICS
+static float addAcross(__m128 vector)
+{
+    auto pair = _mm_add_ps(vector, _mm_movehl_ps(vector, vector));
+    return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+}
+#elif JUCE_USE_ARM_NEON
+static float addAcross(float32x4_t vector)
+{
+    auto pair = vadd_f32(vget_low_f32(vector), vget_high_f32(vector));
+    return vget_lane_f32(vpadd_f32(pair, pair), 0);
+}
+#endif
+
+SpectrumKernels::SpectrumSums SpectrumKernels::sumSpectrum(float const* spectrum, float* previousSpectrum, int numBins)
+{
+    SpectrumSums sums;
+    int bin = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+    auto energy = _mm_setzero_ps(), magnitude = _mm_setzero_ps(), weightedMagnitude = _mm_setzero_ps(), flux = _mm_setzero_ps();
+    auto binIndex = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    auto const binStep = _mm_set1_ps(4.0f);
+    auto const zero = _mm_setzero_ps();
+
+    for (; bin + 4 <= numBins; bin += 4)
+    {
+        auto value = _mm_loadu_ps(spectrum + bin);
+        energy = _mm_add_ps(energy, _mm_mul_ps(value, value));
+        magnitude = _mm_add_ps(magnitude, value);
+        weightedMagnitude = _mm_add_ps(weightedMagnitude, _mm_mul_ps(value, binIndex));
+        flux = _mm_add_ps(flux, _mm_max_ps(_mm_sub_ps(value, _mm_loadu_ps(previousSpectrum + bin)), zero));
+        _mm_storeu_ps(previousSpectrum + bin, value);
+        binIndex = _mm_add_ps(binIndex, binStep);
+    }
+
+    sums = { addAcross(energy), addAcross(magnitude), addAcross(weightedMagnitude), addAcross(flux) };
+#elif JUCE_USE_ARM_NEON
+    auto energy = vdupq_n_f32(0.0f), magnitude = vdupq_n_f32(0.0f), weightedMagnitude = vdupq_n_f32(0.0f), flux = vdupq_n_f32(0.0f);
+    float const firstBinIndices[] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    auto binIndex = vld1q_f32(firstBinIndices);
+    auto const binStep = vdupq_n_f32(4.0f);
+    auto const zero = vdupq_n_f32(0.0f);
+
+    for (; bin + 4 <= numBins; bin += 4)
+    {
+        auto value = vld1q_f32(spectrum + bin);
+        energy = vmlaq_f32(energy, value, value);
+        magnitude = vaddq_f32(magnitude, value);
+        weightedMagnitude = vmlaq_f32(weightedMagnitude, value, binIndex);
+        flux = vaddq_f32(flux, vmaxq_f32(vsubq_f32(value, vld1q_f32(previousSpectrum + bin)), zero));
+        vst1q_f32(previousSpectrum + bin, value);
+        binIndex = vaddq_f32(binIndex, binStep);
+    }
+
+    sums = { addAcross(energy), addAcross(magnitude), addAcross(weightedMagnitude), addAcross(flux) };
+#endif
+
+    //
+    // Leftover bins; with no SIMD support, this does all of them
+    //
+    for (; bin < numBins; ++bin)
+    {
+        auto value = spectrum[bin];
+        sums.energy += value * value;
+        sums.magnitude += value;
+        sums.weightedMagnitude += value * (float)bin;
+        sums.flux += juce::jmax(value - previousSpectrum[bin], 0.0f);
+        previousSpectrum[bin] = value;
+    }
+
+    return sums;
+}
+
+SpectrumKernels::SpectrumSums SpectrumKernels::sumSpectrumScalar(float const* spectrum, float* previousSpectrum, int numBins)
+{
+    SpectrumSums sums;
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        auto value = spectrum[bin];
+        sums.energy += value * value;
+        sums.magnitude += value;
+        sums.weightedMagnitude += value * (float)bin;
+        sums.flux += juce::jmax(value - previousSpectrum[bin], 0.0f);
+        previousSpectrum[bin] = value;
+    }
+
+    return sums;
+}
+
+float SpectrumKernels::sumSquares(float const* magnitudes, int numBins)
+{
+    float sum = 0.0f;
+    int bin = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+    auto sumVector = _mm_setzero_ps();
+    for (; bin + 4 <= numBins; bin += 4)
+    {
+        auto value = _mm_loadu_ps(magnitudes + bin);
+        sumVector = _mm_add_ps(sumVector, _mm_mul_ps(value, value));
+    }
+
+    sum = addAcross(sumVector);
+#elif JUCE_USE_ARM_NEON
+    auto sumVector = vdupq_n_f32(0.0f);
+    for (; bin + 4 <= numBins; bin += 4)
+    {
+        auto value = vld1q_f32(magnitudes + bin);
+        sumVector = vmlaq_f32(sumVector, value, value);
+    }
+
+    sum = addAcross(sumVector);
+#endif
+
+    for (; bin < numBins; ++bin)
+    {
+        sum += magnitudes[bin] * magnitudes[bin];
+    }
+
+    return sum;
+}
+
+//
+// The code is the float bits of the magnitude less the bits of 2^-50, rounded to the top 16 bits of what's
+// left: 6 bits of exponent and 10 bits of mantissa
+//
+static constexpr uint32_t logMagnitudeBaseBits = (127u - 50u) << 23;
+static constexpr int logMagnitudeShift = 13;
+static constexpr uint32_t logMagnitudeRounding = 1u << (logMagnitudeShift - 1);
+static constexpr uint32_t logMagnitudeMaxBits = logMagnitudeBaseBits + (0xffffu << logMagnitudeShift);
+
+static float getFloatFromBits(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint32_t getBitsFromFloat(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+void SpectrumKernels::encodeLogMagnitude16(float const* magnitudes, uint16_t* codes, int numBins)
+{
+    int bin = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+    //
+    // max and min with the limits second so NaN clamps to the bottom of the range. SSE2 can only pack
+    // 32-bit integers with signed saturation, so pack code - 0x8000 and flip the top bit back afterwards.
+    //
+    auto const minVector = _mm_set1_ps(getFloatFromBits(logMagnitudeBaseBits));
+    auto const maxVector = _mm_set1_ps(getFloatFromBits(logMagnitudeMaxBits));
+    auto const offsetVector = _mm_set1_epi32((int)(logMagnitudeBaseBits - logMagnitudeRounding + (0x8000u << logMagnitudeShift)));
+    auto const signVector = _mm_set1_epi16((short)0x8000);
+
+    auto encode = [&](float const* source)
+    {
+        auto clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source), minVector), maxVector);
+        return _mm_srai_epi32(_mm_sub_epi32(_mm_castps_si128(clamped), offsetVector), logMagnitudeShift);
+    };
+
+    for (; bin + 8 <= numBins; bin += 8)
+    {
+        auto packed = _mm_packs_epi32(encode(magnitudes + bin), encode(magnitudes + bin + 4));
+        _mm_storeu_si128((__m128i*)(codes + bin), _mm_xor_si128(packed, signVector));
+    }
+#elif JUCE_USE_ARM_NEON
+    auto const minVector = vdupq_n_f32(getFloatFromBits(logMagnitudeBaseBits));
+    auto const maxVector = vdupq_n_f32(getFloatFromBits(logMagnitudeMaxBits));
+    auto const offsetVector = vdupq_n_u32(logMagnitudeBaseBits - logMagnitudeRounding);
+
+    auto encode = [&](float const* source)
+    {
+        auto clamped = vminq_f32(vmaxq_f32(vld1q_f32(source), minVector), maxVector);
+        return vmovn_u32(vshrq_n_u32(vsubq_u32(vreinterpretq_u32_f32(clamped), offsetVector), logMagnitudeShift));
+    };
+
+    for (; bin + 8 <= numBins; bin += 8)
+    {
+        vst1q_u16(codes + bin, vcombine_u16(encode(magnitudes + bin), encode(magnitudes + bin + 4)));
+    }
+#endif
+
+    encodeLogMagnitude16Scalar(magnitudes + bin, codes + bin, numBins - bin);
+}
+
+void SpectrumKernels::decodeLogMagnitude16(uint16_t const* codes, float* magnitudes, int numBins)
+{
+    int bin = 0;
+
+#if JUCE_USE_SSE_INTRINSICS
+    auto const zero = _mm_setzero_si128();
+    auto const baseVector = _mm_set1_epi32((int)logMagnitudeBaseBits);
+
+    for (; bin + 8 <= numBins; bin += 8)
+    {
+        auto packed = _mm_loadu_si128((__m128i const*)(codes + bin));
+        auto low = _mm_add_epi32(_mm_slli_epi32(_mm_unpacklo_epi16(packed, zero), logMagnitudeShift), baseVector);
+        auto high = _mm_add_epi32(_mm_slli_epi32(_mm_unpackhi_epi16(packed, zero), logMagnitudeShift), baseVector);
+        _mm_storeu_ps(magnitudes + bin, _mm_castsi128_ps(low));
+        _mm_storeu_ps(magnitudes + bin + 4, _mm_castsi128_ps(high));
+    }
+#elif JUCE_USE_ARM_NEON
+    auto const baseVector = vdupq_n_u32(logMagnitudeBaseBits);
+
+    for (; bin + 8 <= numBins; bin += 8)
+    {
+        auto packed = vld1q_u16(codes + bin);
+        auto low = vaddq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(packed)), logMagnitudeShift), baseVector);
+        auto high = vaddq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(packed)), logMagnitudeShift), baseVector);
+        vst1q_f32(magnitudes + bin, vreinterpretq_f32_u32(low));
+        vst1q_f32(magnitudes + bin + 4, vreinterpretq_f32_u32(high));
+    }
+#endif
+
+    decodeLogMagnitude16Scalar(codes + bin, magnitudes + bin, numBins - bin);
+}
+
+void SpectrumKernels::encodeLogMagnitude16Scalar(float const* magnitudes, uint16_t* codes, int numBins)
+{
+    float const minMagnitude = getFloatFromBits(logMagnitudeBaseBits);
+    float const maxMagnitude = getFloatFromBits(logMagnitudeMaxBits);
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        auto clamped = std::min(std::max(minMagnitude, magnitudes[bin]), maxMagnitude);
+        codes[bin] = (uint16_t)((getBitsFromFloat(clamped) - logMagnitudeBaseBits + logMagnitudeRounding) >> logMagnitudeShift);
+    }
+}
+
+void SpectrumKernels::decodeLogMagnitude16Scalar(uint16_t const* codes, float* magnitudes, int numBins)
+{
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        magnitudes[bin] = getFloatFromBits(((uint32_t)codes[bin] << logMagnitudeShift) + logMagnitudeBaseBits);
+    }
+}
+
+#if RUN_UNIT_TESTS
+
+//
+// Stereo FFT output at size 1024 for the tests and the benchmark; the unscaled magnitudes run up to fftSize
+//
+static int constexpr testNumChannels = 2;
+static int constexpr testFFTSize = 1024;
+
+static juce::AudioBuffer<float> makeTestFFTData(juce::Random& random)
+{
+    juce::AudioBuffer<float> fftWorkBuffer{ testNumChannels, testFFTSize * 2 };
+    for (int channel = 0; channel < testNumChannels; ++channel)
+    {
+        for (int index = 0; index < fftWorkBuffer.getNumSamples(); ++index)
+        {
+            fftWorkBuffer.setSample(channel, index, random.nextFloat() * (float)testFFTSize);
+        }
+    }
+
+    return fftWorkBuffer;
+}
+
+static RealSpectrum<float> makeTestSpectrum()
+{
+    auto spectrum = RealSpectrum<float>{}.withChannels(testNumChannels).withFFTSize(testFFTSize);
+    spectrum.clear();
+    return spectrum;
+}
+
+SpectrumKernelsTest::SpectrumKernelsTest() : UnitTest("SpectrumKernelsTest")
+{
+}
+
+void SpectrumKernelsTest::runTest()
+{
+    int constexpr numChannels = testNumChannels;
+    int constexpr fftSize = testFFTSize;
+    int constexpr numBins = fftSize / 2 + 1;
+    float const normalizationScale = 2.0f / (float)fftSize;
+
+    juce::Random random;
+    auto const fftWorkBuffer = makeTestFFTData(random);
+
+    {
+        beginTest("Ballistics kernel matches scalar");
+
+        int constexpr offset = 3;
+        int constexpr numTestBins = numBins - offset;
+        SpectrumKernels::BallisticWeights const weights{ SpectrumKernels::BallisticTimes{}, 50.0f };
+
+        struct Spectra
+        {
+            RealSpectrum<float> spectrum, average, fast, slow, peak, minimum, envelope;
+
+            SpectrumKernels::BallisticBins getBins(int channel)
+            {
+                return { average.getWritePointer(channel) + offset,
+                    fast.getWritePointer(channel) + offset,
+                    slow.getWritePointer(channel) + offset,
+                    peak.getWritePointer(channel) + offset,
+                    minimum.getWritePointer(channel) + offset,
+                    envelope.getWritePointer(channel) + offset };
+            }
+        };
+
+        auto makeSpectra = [&]()
+        {
+            return Spectra{ makeTestSpectrum(), makeTestSpectrum(), makeTestSpectrum(), makeTestSpectrum(), makeTestSpectrum(), makeTestSpectrum(), makeTestSpectrum() };
+        };
+
+        auto stateA = makeSpectra(), outputA = makeSpectra();
+        auto stateB = makeSpectra(), outputB = makeSpectra();
+
+        for (int pass = 0; pass < 8; ++pass)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto fftData = fftWorkBuffer.getReadPointer(channel, offset + pass);
+
+                SpectrumKernels::normaliseAndApplyBallistics(fftData, outputA.spectrum.getWritePointer(channel) + offset,
+                    stateA.getBins(channel), outputA.getBins(channel), numTestBins, normalizationScale, weights);
+                SpectrumKernels::normaliseAndApplyBallisticsScalar(fftData, outputB.spectrum.getWritePointer(channel) + offset,
+                    stateB.getBins(channel), outputB.getBins(channel), numTestBins, normalizationScale, weights);
+            }
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto binsA = outputA.getBins(channel);
+            auto binsB = outputB.getBins(channel);
+            auto statesA = stateA.getBins(channel);
+
+            for (int bin = 0; bin < numTestBins; ++bin)
+            {
+                for (auto [a, b] : { std::pair{ binsA.average, binsB.average }, { binsA.fast, binsB.fast }, { binsA.slow, binsB.slow },
+                    { binsA.peak, binsB.peak }, { binsA.minimum, binsB.minimum }, { binsA.envelope, binsB.envelope } })
+                {
+                    expect(std::abs(a[bin] - b[bin]) <= 1.0e-4f * juce::jmax(1.0f, std::abs(b[bin])));
+                }
+
+                expect(binsA.peak[bin] == statesA.peak[bin]);
+                expect(binsA.minimum[bin] <= outputA.spectrum.getWritePointer(channel)[offset + bin]);
+                expect(binsA.peak[bin] >= outputA.spectrum.getWritePointer(channel)[offset + bin]);
+            }
+        }
+    }
+
+    {
+        beginTest("Ballistics");
+
+        float constexpr spectraPerSecond = 100.0f;
+        SpectrumKernels::BallisticTimes const times;
+        SpectrumKernels::BallisticWeights const weights{ times, spectraPerSecond };
+
+        float spectrum = 0.0f;
+        std::array<float, 6> state{}, output{};
+        SpectrumKernels::BallisticBins stateBins{ &state[0], &state[1], &state[2], &state[3], &state[4], &state[5] };
+        SpectrumKernels::BallisticBins outputBins{ &output[0], &output[1], &output[2], &output[3], &output[4], &output[5] };
+
+        auto run = [&](float magnitude, int numSpectra)
+        {
+            for (int index = 0; index < numSpectra; ++index)
+            {
+                SpectrumKernels::normaliseAndApplyBallistics(&magnitude, &spectrum, stateBins, outputBins, 1, 1.0f, weights);
+            }
+        };
+
+        //
+        // Step up for a quarter of a second; the envelope attacks faster than the fast average,
+        // which rises faster than the slow one
+        //
+        run(1.0f, 25);
+        expect(*outputBins.peak == 1.0f);
+        expect(*outputBins.envelope > *outputBins.fast);
+        expect(*outputBins.fast > *outputBins.slow);
+        expect(*outputBins.minimum <= *outputBins.slow + 1.0e-6f);
+
+        //
+        // Step down; the peak decays at the set rate, the minimum drops at once, and the envelope releases
+        // more slowly than it attacked
+        //
+        run(0.0f, 10);
+        expectWithinAbsoluteError(juce::Decibels::gainToDecibels(*outputBins.peak), -times.peakDecayDecibelsPerSecond * 0.1f, 0.01f);
+        expect(*outputBins.minimum == 0.0f);
+        expect(*outputBins.envelope > 0.5f);
+    }
+
+    {
+        beginTest("Log-magnitude transport accuracy");
+
+        //
+        // Sweep 70 octaves in small steps, plus silence and values off both ends of the range; odd count and
+        // offset so the SIMD loops see unaligned data and leave a tail
+        //
+        int constexpr offset = 1;
+        std::vector<float> magnitudes{ 0.0f, std::numeric_limits<float>::min(), 1.0e30f };
+        for (float exponent = -55.0f; exponent < 15.0f; exponent += 0.01f)
+        {
+            magnitudes.push_back(std::exp2(exponent));
+        }
+
+        int const numValues = (int)magnitudes.size() - offset;
+        std::vector<uint16_t> codes(magnitudes.size()), scalarCodes(magnitudes.size());
+        std::vector<float> decoded(magnitudes.size()), scalarDecoded(magnitudes.size());
+        SpectrumKernels::encodeLogMagnitude16(magnitudes.data() + offset, codes.data() + offset, numValues);
+        SpectrumKernels::encodeLogMagnitude16Scalar(magnitudes.data() + offset, scalarCodes.data() + offset, numValues);
+        SpectrumKernels::decodeLogMagnitude16(codes.data() + offset, decoded.data() + offset, numValues);
+        SpectrumKernels::decodeLogMagnitude16Scalar(codes.data() + offset, scalarDecoded.data() + offset, numValues);
+
+        expect(codes == scalarCodes, "SIMD and scalar encoding differ");
+        expect(decoded == scalarDecoded, "SIMD and scalar decoding differ");
+        expect(codes[1] == 0);
+        expect(codes[2] == 0xffff);
+
+        float maxErrorDecibels = 0.0f;
+        bool monotonic = true;
+        for (size_t index = 3; index < magnitudes.size(); ++index)
+        {
+            monotonic &= index == 3 || codes[index] >= codes[index - 1];
+
+            if (magnitudes[index] >= std::exp2(-50.0f) && magnitudes[index] < std::exp2(14.0f) * 0.999f)
+            {
+                maxErrorDecibels = juce::jmax(maxErrorDecibels, std::abs(20.0f * std::log10(decoded[index] / magnitudes[index])));
+            }
+        }
+
+        expect(monotonic, "Codes out of order");
+        expect(maxErrorDecibels <= 0.0043f, "Maximum error " + juce::String{ maxErrorDecibels, 5 } + " dB");
+        logMessage("Log-magnitude transport maximum error: " + juce::String{ maxErrorDecibels, 5 } + " dB");
+    }
+
+    {
+        beginTest("Feature sums match scalar");
+
+        int constexpr offset = 3;
+        int constexpr numTestBins = numBins - offset;
+        std::vector<float> previousA((size_t)numBins), previousB((size_t)numBins);
+
+        for (int pass = 0; pass < 3; ++pass)
+        {
+            std::vector<float> spectrum((size_t)numBins);
+            for (auto& value : spectrum)
+            {
+                value = random.nextFloat();
+            }
+
+            auto simd = SpectrumKernels::sumSpectrum(spectrum.data() + offset, previousA.data() + offset, numTestBins);
+            auto scalar = SpectrumKernels::sumSpectrumScalar(spectrum.data() + offset, previousB.data() + offset, numTestBins);
+
+            expectWithinAbsoluteError(simd.energy, scalar.energy, scalar.energy * 1.0e-5f);
+            expectWithinAbsoluteError(simd.magnitude, scalar.magnitude, scalar.magnitude * 1.0e-5f);
+            expectWithinAbsoluteError(simd.weightedMagnitude, scalar.weightedMagnitude, scalar.weightedMagnitude * 1.0e-5f);
+            expectWithinAbsoluteError(simd.flux, scalar.flux, scalar.flux * 1.0e-5f);
+            expect(previousA == previousB);
+
+            expectWithinAbsoluteError(SpectrumKernels::sumSquares(spectrum.data() + offset, numTestBins), scalar.energy, scalar.energy * 1.0e-5f);
+        }
+    }
+}
+
+SpectrumKernelsBenchmark::SpectrumKernelsBenchmark() : UnitTest("SpectrumKernelsBenchmark")
+{
+}
+
+void SpectrumKernelsBenchmark::runTest()
+{
+    int constexpr numChannels = testNumChannels;
+    int constexpr fftSize = testFFTSize;
+    int constexpr numBins = fftSize / 2 + 1;
+    int constexpr numIterations = 20000;
+    float const normalizationScale = 2.0f / (float)fftSize;
+    float const energyWeight = 0.9f;
+
+    juce::Random random;
+    auto const fftWorkBuffer = makeTestFFTData(random);
+
+    {
+        beginTest("Log-magnitude transport benchmark");
+
+        //
+        // Everything a ProcessorOutput carries for stereo at FFT size 1024; the float path writes the spectra and
+        // the reader copies them, the compact path encodes, copies half the bytes, and decodes
+        //
+        int constexpr numSpectra = 7;
+        int constexpr numValues = numSpectra * numChannels * numBins;
+        std::vector<float> source((size_t)numValues), floatCopy((size_t)numValues), decoded((size_t)numValues);
+        std::vector<uint16_t> codes((size_t)numValues), codesCopy((size_t)numValues);
+        for (auto& value : source)
+        {
+            value = juce::Decibels::decibelsToGain(random.nextFloat() * -120.0f);
+        }
+
+        auto startTicks = juce::Time::getHighResolutionTicks();
+        for (int iteration = 0; iteration < numIterations; ++iteration)
+        {
+            std::copy_n(source.data(), numValues, floatCopy.data());
+            source[(size_t)(iteration % numValues)] = floatCopy[(size_t)((iteration * 7) % numValues)];
+        }
+        auto floatSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        startTicks = juce::Time::getHighResolutionTicks();
+        for (int iteration = 0; iteration < numIterations; ++iteration)
+        {
+            SpectrumKernels::encodeLogMagnitude16(source.data(), codes.data(), numValues);
+            std::copy_n(codes.data(), numValues, codesCopy.data());
+            SpectrumKernels::decodeLogMagnitude16(codesCopy.data(), decoded.data(), numValues);
+            source[(size_t)(iteration % numValues)] = decoded[(size_t)((iteration * 7) % numValues)];
+        }
+        auto compactSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        logMessage("Float transport: " + juce::String{ numValues * (int)sizeof(float) } + " bytes per output, "
+            + juce::String{ floatSeconds * 1.0e6 / numIterations, 2 } + " us per output");
+        logMessage("Log-magnitude transport: " + juce::String{ numValues * (int)sizeof(uint16_t) } + " bytes per output, "
+            + juce::String{ compactSeconds * 1.0e6 / numIterations, 2 } + " us per output including encode and decode");
+    }
+
+    {
+        beginTest("SpectrumKernelsBenchmark");
+
+        auto spectrum = makeTestSpectrum(), averagingSpectrum = makeTestSpectrum(), averageSpectrum = makeTestSpectrum();
+
+        //
+        // The way processFFT used to do it: copy and scale, then average bin by bin, then copy again
+        //
+        auto startTicks = juce::Time::getHighResolutionTicks();
+        for (int iteration = 0; iteration < numIterations; ++iteration)
+        {
+            spectrum.copyFrom(fftWorkBuffer, numBins, normalizationScale);
+
+            float newScale = 1.0f - energyWeight;
+            for (int channel = 0; channel < averagingSpectrum.getNumChannels(); ++channel)
+            {
+                for (int bin = 0; bin < averagingSpectrum.getNumBins(); ++bin)
+                {
+                    auto accumulator = averagingSpectrum.getBinMagnitude(channel, bin);
+                    accumulator = accumulator * energyWeight + spectrum.getBinMagnitude(channel, bin) * newScale;
+                    averagingSpectrum.setBinValue(channel, bin, accumulator);
+                }
+            }
+
+            averageSpectrum.copyFrom(averagingSpectrum);
+        }
+        auto separateSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        //
+        // The fused kernel processFFT uses now, which also updates the fast and slow averages, the holds,
+        // and the envelope in the same pass
+        //
+        std::array<RealSpectrum<float>, 12> ballistics;
+        for (auto& ballisticSpectrum : ballistics)
+        {
+            ballisticSpectrum = makeTestSpectrum();
+        }
+
+        auto getBins = [&](int first, int channel) -> SpectrumKernels::BallisticBins
+        {
+            return { ballistics[(size_t)first].getWritePointer(channel),
+                ballistics[(size_t)first + 1].getWritePointer(channel),
+                ballistics[(size_t)first + 2].getWritePointer(channel),
+                ballistics[(size_t)first + 3].getWritePointer(channel),
+                ballistics[(size_t)first + 4].getWritePointer(channel),
+                ballistics[(size_t)first + 5].getWritePointer(channel) };
+        };
+
+        SpectrumKernels::BallisticWeights const weights{ SpectrumKernels::BallisticTimes{}, 50.0f };
+        startTicks = juce::Time::getHighResolutionTicks();
+        for (int iteration = 0; iteration < numIterations; ++iteration)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                SpectrumKernels::normaliseAndApplyBallistics(fftWorkBuffer.getReadPointer(channel),
+                    spectrum.getWritePointer(channel), getBins(0, channel), getBins(6, channel),
+                    numBins, normalizationScale, weights);
+            }
+        }
+        auto fusedSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        logMessage("Separate passes, average only: " + juce::String{ separateSeconds * 1000.0, 1 } + " ms");
+        logMessage("Fused ballistics kernel, all six: " + juce::String{ fusedSeconds * 1000.0, 1 } + " ms");
+    }
+}
+
+#endif
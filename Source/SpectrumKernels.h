@@ -0,0 +1,178 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Per-channel kernels for the post-FFT stage of the analysis
+//
+class SpectrumKernels
+{
+public:
+    //
+    // Time constants for the spectra produced by normaliseAndApplyBallistics
+    //
+    struct BallisticTimes
+    {
+        float averageSeconds = 0.1f;
+        float fastSeconds = 0.125f;
+        float slowSeconds = 1.0f;
+        float attackSeconds = 0.01f;
+        float releaseSeconds = 0.5f;
+        float peakDecayDecibelsPerSecond = 20.0f;
+    };
+
+    //
+    // BallisticTimes converted to per-spectrum weights for a given number of spectra per second; each
+    // weight is how much of the previous value to keep
+    //
+    struct BallisticWeights
+    {
+        BallisticWeights() = default;
+        BallisticWeights(BallisticTimes const& times, float spectraPerSecond);
+
+        float average = 0.0f;
+        float fast = 0.0f;
+        float slow = 0.0f;
+        float attack = 0.0f;
+        float release = 0.0f;
+        float peakDecay = 0.0f;
+    };
+
+    //
+    // One bin array per channel for each of the spectra that carry state from one FFT to the next
+    //
+    struct BallisticBins
+    {
+        float* average = nullptr;
+        float* fast = nullptr;
+        float* slow = nullptr;
+        float* peak = nullptr;
+        float* minimum = nullptr;
+        float* envelope = nullptr;
+    };
+
+    //
+    // One pass over a channel of FFT magnitudes:
+    //
+    //      spectrum = fftMagnitudes * normalizationScale
+    //      average, fast, slow = state * weight + spectrum * (1 - weight)
+    //      peak = max(spectrum, peak * peakDecay)
+    //      minimum = min(spectrum, minimum * slow + spectrum * (1 - slow))
+    //      envelope = envelope * w + spectrum * (1 - w), where w is attack if the spectrum is rising and release if not
+    //
+    // The new values are written to both state and output. Uses SSE or NEON where available; the pointers
+    // don't need to be aligned.
+    //
+    static void normaliseAndApplyBallistics(float const* fftMagnitudes,
+        float* spectrum,
+        BallisticBins const& state,
+        BallisticBins const& output,
+        int numBins,
+        float normalizationScale,
+        BallisticWeights const& weights);
+
+    //
+    // Plain scalar version of normaliseAndApplyBallistics for reference and for testing
+    //
+    static void normaliseAndApplyBallisticsScalar(float const* fftMagnitudes,
+        float* spectrum,
+        BallisticBins const& state,
+        BallisticBins const& output,
+        int numBins,
+        float normalizationScale,
+        BallisticWeights const& weights);
+
+    //
+    // Sums over one channel of magnitudes for the feature stage, in one pass:
+    //
+    //      energy = sum(spectrum^2)
+    //      magnitude = sum(spectrum)
+    //      weightedMagnitude = sum(bin * spectrum)
+    //      flux = sum(max(spectrum - previousSpectrum, 0))
+    //      previousSpectrum = spectrum
+    //
+    // Uses SSE or NEON where available; the pointers don't need to be aligned
+    //
+    struct SpectrumSums
+    {
+        float energy = 0.0f;
+        float magnitude = 0.0f;
+        float weightedMagnitude = 0.0f;
+        float flux = 0.0f;
+    };
+
+    static SpectrumSums sumSpectrum(float const* spectrum, float* previousSpectrum, int numBins);
+
+    //
+    // Plain scalar version of sumSpectrum for reference and for testing
+    //
+    static SpectrumSums sumSpectrumScalar(float const* spectrum, float* previousSpectrum, int numBins);
+
+    //
+    // sum(magnitudes^2); uses SSE or NEON where available
+    //
+    static float sumSquares(float const* magnitudes, int numBins);
+
+    //
+    // Compact transport encoding for spectra: a 16-bit piecewise-linear log2 of the magnitude. The top 6 bits
+    // count octaves up from 2^-50 (-301 dB) and the low 10 bits are the position within the octave, so the
+    // codes sort the same way as the magnitudes and decode to within 0.0043 dB anywhere in the range.
+    // Magnitudes at or below 2^-50, including zero, encode as 0 and decode to 2^-50; the largest code
+    // decodes to just under 2^14 (+84 dB).
+    //
+    // Both directions are a handful of integer operations on the float bits. Uses SSE or NEON where
+    // available; the pointers don't need to be aligned.
+    //
+    static void encodeLogMagnitude16(float const* magnitudes, uint16_t* codes, int numBins);
+    static void decodeLogMagnitude16(uint16_t const* codes, float* magnitudes, int numBins);
+
+    //
+    // Plain scalar versions of the above for reference and for testing
+    //
+    static void encodeLogMagnitude16Scalar(float const* magnitudes, uint16_t* codes, int numBins);
+    static void decodeLogMagnitude16Scalar(uint16_t const* codes, float* magnitudes, int numBins);
+};
+
+#if RUN_UNIT_TESTS
+
+class SpectrumKernelsTest : public juce::UnitTest
+{
+public:
+    SpectrumKernelsTest();
+
+    void runTest() override;
+};
+
+class SpectrumKernelsBenchmark : public juce::UnitTest
+{
+public:
+    SpectrumKernelsBenchmark();
+
+    void runTest() override;
+};
+
+#endif
@@ -36,42 +36,36 @@ void SpectrumRingDisplay::paint(juce::Graphics& g, juce::Rectangle<float> bounds
         return;
     }
 
-    auto const& averageSpectrum = processorOutput->averageSpectrum;
+    auto const& averageBands = processorOutput->averageBands;
+    auto const& bandCentreFrequencies = processorOutput->bandCentreFrequencies;
 
     //
-    // Limit the bin range; skip DC bin
+    // One ring per log-frequency band up to 2 kHz
     //
-    int numBins = juce::roundToInt((float)averageSpectrum.getNumBins() * 2000.0f / (float)audioProcessor.getSampleRate()) - 1;
+    int numBands = 0;
+    while (numBands < processorOutput->getNumBands() && bandCentreFrequencies[(size_t)numBands] <= maxFrequency)
+    {
+        ++numBands;
+    }
+
+    if (numBands < 2)
+    {
+        return;
+    }
 
     //
-    // Calculate bass energy
+    // Bass energy from the analysis features
     //
-    int numEnergyBins = 0;
-    int firstEnergyBin = 0;
     float peakBassEnergy = 0.0f;
-    for (int channel = 0; channel < averageSpectrum.getNumChannels(); ++channel)
+    for (int channel = 0; channel < processorOutput->numFeatureChannels; ++channel)
     {
-        float frequency = 50.0f;
-        int bin = (int)std::floor(frequency / audioProcessor.fftHertzPerBin);
-        firstEnergyBin = bin;
-        numEnergyBins = 0;
-        while (frequency <= 200.0f)
-        {
-            auto energy = averageSpectrum.getBinMagnitude(channel, bin);
-            if (energy > peakBassEnergy)
-            {
-                peakBassEnergy = energy;
-            }
-            frequency += (float)audioProcessor.fftHertzPerBin;
-            bin++;
-            numEnergyBins++;
-        }
+        peakBassEnergy = juce::jmax(peakBassEnergy, processorOutput->features[(size_t)channel].bandLevels[0]);
     }
 
     //
     // Make ring segments if necessary
     //
-    int numRings = numBins;
+    int numRings = numBands;
     makeSegmentPaths(numRings, bounds);
 
     if (ringBounds.isEmpty())
@@ -106,18 +100,18 @@ void SpectrumRingDisplay::paint(juce::Graphics& g, juce::Rectangle<float> bounds
     gradient = juce::ColourGradient{ juce::Colour{ 0xff6eecfc }, bounds.getCentre(), juce::Colours::hotpink, bounds.getTopLeft(), true };
     auto const translateAndScale = juce::AffineTransform::scale(xScale, yScale).translated(bounds.getCentre());
     juce::NormalisableRange<float> gainRange{ 0.0f, 12.0f };
-    for (int channel = 0; channel < averageSpectrum.getNumChannels(); ++channel)
+    for (int channel = 0; channel < averageBands.getNumChannels(); ++channel)
     {
         for (int ring = 0; ring < numRings; ++ring)
         {
-	        float magnitude = averageSpectrum.getBinMagnitude(channel, ring + 1); // ring + 1 to skip DC bin
+	        float magnitude = averageBands.getSample(channel, ring);
 	        magnitude = juce::jmin(1.0f, magnitude);
 	
 	        g.setColour(gradient.getColourAtPosition(magnitude));
 	
             float gainDecibels = gainRange.convertFrom0to1((float)ring / (float)numRings);
             float gain = juce::Decibels::decibelsToGain(gainDecibels);
-	        paintSegments(g, channel, ring, magnitude * gain, translateAndScale);
+	        paintSegments(g, channel, averageBands.getNumChannels(), ring, magnitude * gain, translateAndScale);
         }
     }
 }
@@ -164,12 +158,18 @@ void SpectrumRingDisplay::makeSegmentPaths(int numRings, juce::Rectangle<float>
     }
 }
 
-void SpectrumRingDisplay::paintSegments(juce::Graphics& g, int channel, int ring, float magnitude, auto const& translateAndScale)
+void SpectrumRingDisplay::paintSegments(juce::Graphics& g, int channel, int numChannels, int ring, float magnitude, auto const& translateAndScale)
 {
-    int numSegments = (int)std::floor(juce::MathConstants<float>::halfPi * segmentAngleSpacingInverse * magnitude);
-    numSegments = juce::jmin(numSegments, segmentsPerQuarterCircle);
+    //
+    // Each channel gets an equal slice of the circle, starting from the top; the segments grow out from
+    // the middle of the slice towards its edges
+    //
+    float const halfSliceRadians = juce::MathConstants<float>::pi / (float)juce::jmax(1, numChannels);
+    int const maxNumSegments = (int)std::floor(halfSliceRadians * segmentAngleSpacingInverse);
+    int numSegments = (int)std::floor(halfSliceRadians * segmentAngleSpacingInverse * magnitude);
+    numSegments = juce::jmin(numSegments, maxNumSegments);
 
-    float upperAngle = -juce::MathConstants<float>::halfPi + juce::MathConstants<float>::pi * channel;
+    float upperAngle = -juce::MathConstants<float>::halfPi + 2.0f * halfSliceRadians * channel;
     float lowerAngle = upperAngle - segmentAngleSpacingRadians;
 
     auto const segmentPath = segmentPaths[ring];
@@ -33,6 +33,11 @@ public:
     SpectrumRingDisplay(Direct2DDemoProcessor& processor_);
     ~SpectrumRingDisplay() = default;
 
+    //
+    // Only the bands up to here get a ring
+    //
+    static constexpr float maxFrequency = 2000.0f;
+
     void paint(juce::Graphics& g, juce::Rectangle<float> bounds, ProcessorOutput const * const processorOutput);
 
 protected:
@@ -48,5 +53,5 @@ protected:
     float const segmentAngleSpacingInverse = 1.0f / segmentAngleSpacingRadians;
 
     void makeSegmentPaths(int numRings, juce::Rectangle<float> bounds);
-    void paintSegments(juce::Graphics& g, int channel, int ring, float magnitude, auto const& translateAndScale);
+    void paintSegments(juce::Graphics& g, int channel, int numChannels, int ring, float magnitude, auto const& translateAndScale);
 };
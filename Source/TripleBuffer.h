@@ -0,0 +1,181 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Lock-free triple buffer for publishing the most recent value from one producer thread to one consumer thread
+//
+// The producer fills the buffer from getWriteBuffer() and calls publish(). The consumer calls read() to get
+// the most recently published buffer; that buffer belongs to the consumer until its next call to read(),
+// so it can't be overwritten while the consumer is still using it. Neither side ever blocks or copies.
+template <typename Type> class TripleBuffer
+{
+public:
+    TripleBuffer()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        writeIndex = 0;
+        middleIndex.store(1, std::memory_order_release);
+        readIndex = 2;
+    }
+
+    auto& getBuffers()
+    {
+        return buffers;
+    }
+
+    //
+    // Producer thread
+    //
+    Type& getWriteBuffer()
+    {
+        return buffers[writeIndex];
+    }
+
+    void publish()
+    {
+        auto previousMiddle = middleIndex.exchange(writeIndex | freshFlag, std::memory_order_acq_rel);
+        writeIndex = previousMiddle & indexMask;
+    }
+
+    //
+    // Consumer thread
+    //
+    Type const& read()
+    {
+        if (middleIndex.load(std::memory_order_relaxed) & freshFlag)
+        {
+            auto previousMiddle = middleIndex.exchange(readIndex, std::memory_order_acq_rel);
+            readIndex = previousMiddle & indexMask;
+        }
+
+        return buffers[readIndex];
+    }
+
+    //
+    // The buffer returned by the last call to read(), for the consumer to annotate
+    //
+    Type& getReadBuffer()
+    {
+        return buffers[readIndex];
+    }
+
+private:
+    static constexpr int freshFlag = 4;
+    static constexpr int indexMask = 3;
+
+    std::array<Type, 3> buffers;
+    alignas(64) int writeIndex = 0;
+    alignas(64) std::atomic<int> middleIndex = 1;
+    alignas(64) int readIndex = 2;
+};
+
+#if RUN_UNIT_TESTS
+
+struct TripleBufferTest : public juce::UnitTest
+{
+    TripleBufferTest() :
+        UnitTest("TripleBufferTest")
+    {
+    }
+
+    using Frame = std::array<uint64_t, 1024>;
+
+    void runTest() override
+    {
+        beginTest("TripleBufferTest");
+
+        TripleBuffer<Frame> tripleBuffer;
+        uint64_t constexpr numFrames = 200000;
+        std::atomic<bool> producerDone = false;
+
+        for (auto& frame : tripleBuffer.getBuffers())
+        {
+            frame.fill(0);
+        }
+
+        std::thread producer{ [&]()
+            {
+                for (uint64_t frameNumber = 1; frameNumber <= numFrames; ++frameNumber)
+                {
+                    tripleBuffer.getWriteBuffer().fill(frameNumber);
+                    tripleBuffer.publish();
+                }
+
+                producerDone = true;
+            } };
+
+        int numTornFrames = 0;
+        int numOutOfOrderFrames = 0;
+        int numNewFrames = 0;
+        uint64_t lastSequenceNumber = 0;
+        while (true)
+        {
+            bool done = producerDone.load();
+            auto const& frame = tripleBuffer.read();
+            auto sequenceNumber = frame[0];
+
+            if (sequenceNumber != lastSequenceNumber)
+            {
+                if (sequenceNumber < lastSequenceNumber)
+                {
+                    ++numOutOfOrderFrames;
+                }
+
+                ++numNewFrames;
+                lastSequenceNumber = sequenceNumber;
+            }
+
+            for (auto value : frame)
+            {
+                if (value != sequenceNumber)
+                {
+                    ++numTornFrames;
+                    break;
+                }
+            }
+
+            if (done)
+            {
+                break;
+            }
+        }
+
+        producer.join();
+
+        expect(numTornFrames == 0, juce::String{ numTornFrames } + " torn frames");
+        expect(numOutOfOrderFrames == 0);
+        expect(lastSequenceNumber == numFrames, "Last frame not received");
+        logMessage(juce::String{ numNewFrames } + " of " + juce::String{ (int)numFrames } + " frames seen by the consumer");
+    }
+};
+
+#endif
@@ -28,13 +28,49 @@ SOFTWARE.
 
 #if RUN_UNIT_TESTS
 
+#include "FIFOController.h"
 #include "AudioFIFO.h"
+#include "ResizableAudioFIFO.h"
 #include "Spectrum.h"
+#include "TripleBuffer.h"
+#include "BroadcastFIFO.h"
+#include "ProcessorOutputFIFO.h"
+#include "FIFO.h"
+#include "SpectrumKernels.h"
+#include "FFTPlans.h"
+#include "BandMap.h"
+#include "SlidingDFT.h"
+#include "Decimator.h"
+#include "WorkerPool.h"
+#include "SpectrogramHistory.h"
+#include "SpectrumAnalyser.h"
+#include "RealtimeSafetyMonitor.h"
+#include "LatencyHistogram.h"
 
 struct UnitTests
 {
+    std::unique_ptr<FIFOControllerStressTest> fifoControllerStressTest = std::make_unique<FIFOControllerStressTest>();
     std::unique_ptr<AudioRingBufferTest> ringBufferTest = std::make_unique<AudioRingBufferTest>();
+    std::unique_ptr<AudioFIFOBackendBenchmark> audioFIFOBackendBenchmark = std::make_unique<AudioFIFOBackendBenchmark>();
+    std::unique_ptr<AudioFIFOPrecisionBenchmark> audioFIFOPrecisionBenchmark = std::make_unique<AudioFIFOPrecisionBenchmark>();
+    std::unique_ptr<ResizableAudioFIFOTest> resizableAudioFIFOTest = std::make_unique<ResizableAudioFIFOTest>();
     std::unique_ptr<SpectrumTest> realFloatSpectrumTest = std::make_unique<SpectrumTest>();
+    std::unique_ptr<TripleBufferTest> tripleBufferTest = std::make_unique<TripleBufferTest>();
+    std::unique_ptr<BroadcastFIFOTest> broadcastFIFOTest = std::make_unique<BroadcastFIFOTest>();
+    std::unique_ptr<ProcessorOutputFIFOTest> processorOutputFIFOTest = std::make_unique<ProcessorOutputFIFOTest>();
+    std::unique_ptr<FIFOTest> fifoTest = std::make_unique<FIFOTest>();
+    std::unique_ptr<SpectrumKernelsTest> spectrumKernelsTest = std::make_unique<SpectrumKernelsTest>();
+    std::unique_ptr<SpectrumKernelsBenchmark> spectrumKernelsBenchmark = std::make_unique<SpectrumKernelsBenchmark>();
+    std::unique_ptr<FFTPlansTest> fftPlansTest = std::make_unique<FFTPlansTest>();
+    std::unique_ptr<BandMapTest> bandMapTest = std::make_unique<BandMapTest>();
+    std::unique_ptr<SlidingDFTTest> slidingDFTTest = std::make_unique<SlidingDFTTest>();
+    std::unique_ptr<DecimatorTest> decimatorTest = std::make_unique<DecimatorTest>();
+    std::unique_ptr<WorkerPoolTest> workerPoolTest = std::make_unique<WorkerPoolTest>();
+    std::unique_ptr<SpectrogramHistoryTest> spectrogramHistoryTest = std::make_unique<SpectrogramHistoryTest>();
+    std::unique_ptr<SpectrumAnalyserTest> spectrumAnalyserTest = std::make_unique<SpectrumAnalyserTest>();
+    std::unique_ptr<SpectrumAnalyserBenchmark> spectrumAnalyserBenchmark = std::make_unique<SpectrumAnalyserBenchmark>();
+    std::unique_ptr<RealtimeSafetyMonitorTest> realtimeSafetyMonitorTest = std::make_unique<RealtimeSafetyMonitorTest>();
+    std::unique_ptr<LatencyHistogramTest> latencyHistogramTest = std::make_unique<LatencyHistogramTest>();
 };
 
 #endif
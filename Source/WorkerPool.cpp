@@ -0,0 +1,256 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "WorkerPool.h"
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::start(int numWorkers)
+{
+    stop();
+
+    for (int index = 0; index < numWorkers; ++index)
+    {
+        auto worker = std::make_unique<Worker>(*this, index + 1);
+        worker->startThread(juce::Thread::Priority::high);
+        workers.add(std::move(worker));
+    }
+}
+
+void WorkerPool::stop()
+{
+    for (auto worker : workers)
+    {
+        worker->signalThreadShouldExit();
+    }
+
+    //
+    // Wake the workers with an empty job so they see the exit flag
+    //
+    taskCounter.store(packCounter(++generation, 0, 0), std::memory_order_release);
+    taskCounter.notify_all();
+
+    for (auto worker : workers)
+    {
+        worker->stopThread(1000);
+    }
+
+    workers.clear();
+}
+
+void WorkerPool::dispatch(int numTasks, void* context, TaskFunction function)
+{
+    jassert(numTasks <= maxNumTasks);
+
+    if (workers.isEmpty() || numTasks <= 1)
+    {
+        for (int index = 0; index < numTasks; ++index)
+        {
+            function(context, index, 0);
+        }
+
+        return;
+    }
+
+    taskContext = context;
+    taskFunction = function;
+    numTasksRemaining.store(numTasks, std::memory_order_relaxed);
+
+    auto counter = packCounter(++generation, numTasks, 0);
+    taskCounter.store(counter, std::memory_order_release);
+    taskCounter.notify_all();
+
+    //
+    // Pitch in, then wait for any tasks the workers are still running
+    //
+    while (runNextTask(counter, 0))
+    {
+    }
+
+    for (auto remaining = numTasksRemaining.load(std::memory_order_acquire); remaining != 0; remaining = numTasksRemaining.load(std::memory_order_acquire))
+    {
+        numTasksRemaining.wait(remaining, std::memory_order_acquire);
+    }
+}
+
+bool WorkerPool::runNextTask(uint64_t& counter, int slot)
+{
+    while (true)
+    {
+        int const numTasks = (int)((counter >> 16) & 0xffff);
+        int const nextTask = (int)(counter & 0xffff);
+        if (nextTask >= numTasks)
+        {
+            return false;
+        }
+
+        //
+        // The job can't finish until this task does, so the task function and context are safe to read
+        // once the claim succeeds
+        //
+        if (taskCounter.compare_exchange_weak(counter, counter + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            ++counter;
+            taskFunction(taskContext, nextTask, slot);
+
+            if (numTasksRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                numTasksRemaining.notify_all();
+            }
+
+            return true;
+        }
+    }
+}
+
+WorkerPool::Worker::Worker(WorkerPool& owner_, int slot_) :
+    Thread("Spectrum analysis worker"),
+    owner(owner_),
+    slot(slot_)
+{
+}
+
+void WorkerPool::Worker::run()
+{
+    auto counter = owner.taskCounter.load(std::memory_order_acquire);
+
+    while (!threadShouldExit())
+    {
+        owner.taskCounter.wait(counter, std::memory_order_acquire);
+        counter = owner.taskCounter.load(std::memory_order_acquire);
+
+        while (owner.runNextTask(counter, slot))
+        {
+        }
+    }
+}
+
+#if RUN_UNIT_TESTS
+
+WorkerPoolTest::WorkerPoolTest() : UnitTest("WorkerPoolTest")
+{
+}
+
+void WorkerPoolTest::runTest()
+{
+    int constexpr maxNumTestTasks = 16;
+    std::array<std::atomic<int>, maxNumTestTasks> runCounts;
+    std::array<std::atomic<int>, maxNumTestTasks> slotsInUse;
+    std::atomic<int> numSlotClashes = 0, numBadSlots = 0;
+    for (auto& inUse : slotsInUse)
+    {
+        inUse = 0;
+    }
+
+    auto runJobs = [&](WorkerPool& pool, int numJobs)
+    {
+        juce::Random random;
+
+        for (int job = 0; job < numJobs; ++job)
+        {
+            for (auto& count : runCounts)
+            {
+                count = 0;
+            }
+
+            //
+            // Every other job uses the slot; no slot should ever have two tasks in it at once
+            //
+            int numTasks = 1 + random.nextInt(maxNumTestTasks);
+            if (job % 2)
+            {
+                auto task = [&](int index)
+                {
+                    runCounts[(size_t)index].fetch_add(1, std::memory_order_relaxed);
+                };
+                pool.run(numTasks, task);
+            }
+            else
+            {
+                auto task = [&](int index, int slot)
+                {
+                    if (slot < 0 || slot >= pool.getNumSlots())
+                    {
+                        ++numBadSlots;
+                        return;
+                    }
+
+                    numSlotClashes += slotsInUse[(size_t)slot].fetch_add(1, std::memory_order_acquire) != 0 ? 1 : 0;
+                    runCounts[(size_t)index].fetch_add(1, std::memory_order_relaxed);
+                    slotsInUse[(size_t)slot].fetch_sub(1, std::memory_order_release);
+                };
+                pool.run(numTasks, task);
+            }
+
+            //
+            // Every task ran exactly once, and run() didn't return until they had
+            //
+            for (int index = 0; index < maxNumTestTasks; ++index)
+            {
+                if (runCounts[(size_t)index].load() != (index < numTasks ? 1 : 0))
+                {
+                    expect(false, "Job " + juce::String{ job } + " task " + juce::String{ index });
+                    return;
+                }
+            }
+        }
+    };
+
+    WorkerPool pool;
+
+    {
+        beginTest("No workers");
+
+        expect(pool.getNumWorkers() == 0);
+        runJobs(pool, 100);
+    }
+
+    {
+        beginTest("Workers");
+
+        pool.start(3);
+        expect(pool.getNumWorkers() == 3);
+        runJobs(pool, 20000);
+    }
+
+    {
+        beginTest("Restart");
+
+        pool.stop();
+        expect(pool.getNumWorkers() == 0);
+        runJobs(pool, 100);
+
+        pool.start(1);
+        runJobs(pool, 1000);
+        pool.stop();
+
+        expectEquals(numSlotClashes.load(), 0);
+        expectEquals(numBadSlots.load(), 0);
+    }
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*
+
+Copyright(c) 2023 Matthew Gonzalez
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//
+// Fork-join pool for splitting the per-channel analysis across cores
+//
+// run() hands out task indices to the workers and the calling thread, and returns once every task has
+// finished. Tasks are claimed with a compare-and-swap on one 64-bit word holding the job generation, the
+// number of tasks, and the next task index, so a worker that wakes up late can't pick up a task from a
+// job that's already finished. Nothing is allocated or locked in run(). With no workers running, run()
+// just does all the tasks on the calling thread.
+//
+// Tasks can also take the slot of the thread running them, from 0 for the calling thread to
+// getNumWorkers(); no two tasks run on the same slot at once, so each slot can have its own scratch
+// objects.
+//
+class WorkerPool
+{
+public:
+    static constexpr int maxNumTasks = 0xffff;
+
+    WorkerPool() = default;
+    ~WorkerPool();
+
+    //
+    // Allocates; call from prepareToPlay
+    //
+    void start(int numWorkers);
+    void stop();
+
+    int getNumWorkers() const
+    {
+        return workers.size();
+    }
+
+    int getNumSlots() const
+    {
+        return getNumWorkers() + 1;
+    }
+
+    //
+    // task(index) or task(index, slot) is called once for each index from 0 to numTasks - 1; only one thread
+    // may call run() at a time
+    //
+    template <typename Task> void run(int numTasks, Task& task)
+    {
+        dispatch(numTasks, &task, [](void* context, int index, int slot)
+            {
+                if constexpr (std::is_invocable_v<Task&, int, int>)
+                {
+                    (*static_cast<Task*>(context))(index, slot);
+                }
+                else
+                {
+                    juce::ignoreUnused(slot);
+                    (*static_cast<Task*>(context))(index);
+                }
+            });
+    }
+
+private:
+    using TaskFunction = void (*)(void* context, int index, int slot);
+
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(WorkerPool& owner_, int slot_);
+
+        void run() override;
+
+    private:
+        WorkerPool& owner;
+        int const slot;
+    };
+
+    juce::OwnedArray<Worker> workers;
+    alignas(64) std::atomic<uint64_t> taskCounter = 0;
+    alignas(64) std::atomic<int> numTasksRemaining = 0;
+    void* taskContext = nullptr;
+    TaskFunction taskFunction = nullptr;
+    uint32_t generation = 0;
+
+    void dispatch(int numTasks, void* context, TaskFunction function);
+    bool runNextTask(uint64_t& counter, int slot);
+
+    static uint64_t packCounter(uint32_t generation, int numTasks, int nextTask)
+    {
+        return ((uint64_t)generation << 32) | ((uint64_t)numTasks << 16) | (uint64_t)nextTask;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(WorkerPool)
+};
+
+#if RUN_UNIT_TESTS
+
+class WorkerPoolTest : public juce::UnitTest
+{
+public:
+    WorkerPoolTest();
+
+    void runTest() override;
+};
+
+#endif